@@ -0,0 +1,91 @@
+//Keyspace table benchmark: Dict against the tbb::concurrent_hash_map it replaced
+//GET/SET mixes over a prefilled key set, run with 1, 8 and 32 threads
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dict.hpp"
+#include "keyhash.hpp"
+
+constexpr int KEYS = 1 << 20;
+constexpr int OPS_PER_THREAD = 2'000'000;
+
+struct DictOps {
+    Dict<std::string> map;
+    bool get(const std::string& key)
+    {
+        Dict<std::string>::const_accessor acc;
+        return map.find(acc, key) && !acc->second.empty();
+    }
+    void set(const std::string& key, const std::string& value)
+    {
+        Dict<std::string>::accessor acc;
+        map.insert(acc, key);
+        acc->second = value;
+    }
+};
+
+struct TBBOps {
+    KeyMap<std::string> map;
+    bool get(const std::string& key)
+    {
+        KeyMap<std::string>::const_accessor acc;
+        return map.find(acc, key) && !acc->second.empty();
+    }
+    void set(const std::string& key, const std::string& value)
+    {
+        KeyMap<std::string>::accessor acc;
+        map.insert(acc, key);
+        acc->second = value;
+    }
+};
+
+template<class Ops> double run(const std::vector<std::string>& keys, const int threads, const int setPercent) //Million ops per second
+{
+    Ops ops;
+    const std::string value(16, 'v');
+    for (const auto& key : keys) ops.set(key, value);
+
+    std::vector<std::thread> workers;
+    const auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]
+        {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<int> pick(0, KEYS - 1);
+            size_t hits = 0;
+            for (int i = 0; i < OPS_PER_THREAD; ++i)
+            {
+                const std::string& key = keys[pick(rng)];
+                if (static_cast<int>(rng() % 100) < setPercent) ops.set(key, value);
+                else hits += ops.get(key);
+            }
+            if (hits == 0 && setPercent < 100) std::cerr << "no hits?" << std::endl;
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    const std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(threads) * OPS_PER_THREAD / took.count() / 1e6;
+}
+
+int main()
+{
+    std::vector<std::string> keys;
+    keys.reserve(KEYS);
+    for (int i = 0; i < KEYS; ++i) keys.push_back("key:" + std::to_string(i));
+
+    std::cout << "threads\tset%\tdict Mops/s\ttbb Mops/s" << std::endl;
+    for (const int threads : {1, 8, 32})
+    {
+        for (const int setPercent : {10, 50})
+        {
+            const double dict = run<DictOps>(keys, threads, setPercent);
+            const double tbb = run<TBBOps>(keys, threads, setPercent);
+            std::cout << threads << '\t' << setPercent << '\t' << dict << "\t\t" << tbb << std::endl;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+//Per key memory of the keyspace: N small string keys (key:i -> val:i) in the old TBB map, and in Dict<Object> (LRU state lives in the Object header, no side table),
+//or N three field hashes stored as unordered_maps or as listpacks, or N sets of 20 numeric ids as unordered_sets or intsets,
+//or N lists of 1000 short items as deques or quicklists (values only, no keys)
+//Usage: entry_bench <tbb|dict|hashmap|listpack|hashset|intset|deque|quicklist> [keys], one layout per run so the heaps don't mix
+#include <unistd.h>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "dict.hpp"
+#include "keyhash.hpp"
+#include "object.hpp"
+#include "respvalue.hpp"
+
+static size_t heapInUse() //Resident bytes, TBB allocates through its own allocator so malloc stats would miss it
+{
+    size_t pages = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+int main(int argc, char** argv)
+{
+    const std::string mode = argc > 1 ? argv[1] : "dict";
+    const size_t keys = argc > 2 ? std::stoull(argv[2]) : 10'000'000;
+
+    const size_t before = heapInUse();
+    size_t after = 0;
+    if (mode == "tbb")
+    {
+        auto* map = new KeyMap<RESPValue>();
+        for (size_t i = 0; i < keys; ++i) map->insert({"key:" + std::to_string(i), RESPValue::makeStr("val:" + std::to_string(i))});
+        after = heapInUse();
+    }
+    else if (mode == "dict")
+    {
+        auto* dict = new Dict<Object>();
+        for (size_t i = 0; i < keys; ++i) dict->insert("key:" + std::to_string(i), Object::str("val:" + std::to_string(i)));
+        after = heapInUse();
+        std::cout << "dict memoryUsage(): " << static_cast<double>(dict->memoryUsage()) / keys << " bytes/key" << std::endl;
+    }
+    else if (mode == "hashmap" || mode == "listpack")
+    {
+        auto* dict = new Dict<Object>();
+        for (size_t i = 0; i < keys; ++i)
+        {
+            Object hash(RESPValue{storeType::HASH, std::unordered_map<std::string, std::string>{
+                {"name", "user:" + std::to_string(i)}, {"age", std::to_string(i % 100)}, {"city", "Budapest"}}});
+            if (mode == "hashmap") hash.unpack();
+            dict->insert("key:" + std::to_string(i), std::move(hash));
+        }
+        after = heapInUse();
+    }
+    else if (mode == "hashset" || mode == "intset")
+    {
+        auto* dict = new Dict<Object>();
+        for (size_t i = 0; i < keys; ++i)
+        {
+            std::unordered_set<std::string> ids;
+            for (size_t j = 0; j < 20; ++j) ids.insert(std::to_string(i * 20 + j));
+            Object set(RESPValue{storeType::SET, std::move(ids)});
+            if (mode == "hashset") set.unpack();
+            dict->insert("key:" + std::to_string(i), std::move(set));
+        }
+        after = heapInUse();
+    }
+    else if (mode == "deque" || mode == "quicklist")
+    {
+        auto* deques = new std::vector<RESPValue>();
+        auto* quicklists = new std::vector<Object>();
+        for (size_t i = 0; i < keys; ++i)
+        {
+            std::deque<std::string> items;
+            for (size_t j = 0; j < 1000; ++j) items.emplace_back("item:" + std::to_string(j));
+            if (mode == "deque") deques->push_back(RESPValue{storeType::LIST, std::move(items)});
+            else quicklists->emplace_back(RESPValue{storeType::LIST, std::move(items)});
+        }
+        after = heapInUse();
+    }
+    else
+    {
+        std::cerr << "mode is tbb, dict, hashmap, listpack, hashset, intset, deque or quicklist" << std::endl;
+        return 1;
+    }
+    std::cout << mode << ": " << keys << " keys, " << static_cast<double>(after - before) / keys << " bytes/key" << std::endl;
+}
@@ -1,63 +1,77 @@
 #pragma once
 
-#include <list>
-#include <unordered_map>
-#include <iostream>
-#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <random>
 #include <string>
-#include <tbb/concurrent_hash_map.h>
+#include <string_view>
+#include <vector>
 
-class LRU {
-public:
-    LRU() = default;
-    ~LRU() = default;
+#include "clock.hpp"
+#include "config.h"
 
-    void touch(const std::string& k) //Refresh in order queue
-    {
-        tbb::concurrent_hash_map<std::string, std::list<std::string>::iterator>::accessor accessor;
-        if (!keyToOrder.find(accessor, k))
-        {
-            order.push_front(k);
-            keyToOrder.insert(accessor,k);
-            accessor->second = order.begin();
-        }
-        else
-        {
-            order.splice(order.begin(), order, accessor->second);
-        }
-    }
+//Approximate LRU like Redis: every Object keeps the clock of its last access in 24 header bits, a read only stores that
+//Eviction samples a few random keys and keeps the most idle (or least used under LFU) ones seen in a small pool, the best of which goes first
+constexpr uint32_t LRU_CLOCK_MAX = (1u << 24) - 1; //Wraps after about 194 days at 1 second ticks
 
-    std::string evict() //Removes oldest key in order queue
-    {
-        if (order.empty()) //not sure if needed
-        {
-            std::cerr << "trying to evict when empty" << std::endl;
-            return "";
-        }
-        std::string ret = order.back();
-        order.pop_back();
+inline uint32_t lruClock() //Now in LRU_CLOCK_RESOLUTION_MS ticks, cut to the bits an Object keeps
+{
+    return static_cast<uint32_t>(CoarseClock::nowMs() / LRU_CLOCK_RESOLUTION_MS) & LRU_CLOCK_MAX;
+}
+inline uint32_t idleTicks(const uint32_t stamp, const uint32_t now) { return (now - stamp) & LRU_CLOCK_MAX; } //Across a wrap too
 
-        keyToOrder.erase(ret);
-        return ret;
+//LFU reuses the same 24 bits like Redis: the minute of the last access in the top 16, a logarithmic access counter in the low 8
+//The counter climbs ever more slowly (about a million hits reach 255 at factor 10) and loses one per LFU_DECAY_MINUTES unused
+inline uint32_t lfuMinutes()
+{
+    return static_cast<uint32_t>(CoarseClock::nowMs() / 60000) & 0xFFFF;
+}
+inline uint8_t lfuCounter(const uint32_t stamp, const uint32_t minutes) //Decayed to now
+{
+    const uint32_t elapsed = (minutes - (stamp >> 8)) & 0xFFFF;
+    const uint32_t periods = LFU_DECAY_MINUTES ? elapsed / LFU_DECAY_MINUTES : 0;
+    const uint32_t counter = stamp & 0xFF;
+    return static_cast<uint8_t>(periods >= counter ? 0 : counter - periods);
+}
+inline uint32_t lfuStamp(const uint8_t counter) { return lfuMinutes() << 8 | counter; }
+inline uint32_t lfuTouched(const uint32_t stamp) //After one more access: decayed, then incremented with probability 1 / ((counter - LFU_INIT_VAL) * LFU_LOG_FACTOR + 1)
+{
+    thread_local std::minstd_rand rng{std::random_device{}()};
+    const uint32_t minutes = lfuMinutes();
+    uint32_t counter = lfuCounter(stamp, minutes);
+    if (counter < 255)
+    {
+        const double base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+        if (std::uniform_real_distribution<double>(0, 1)(rng) < 1.0 / (base * LFU_LOG_FACTOR + 1)) ++counter;
     }
+    return minutes << 8 | counter;
+}
 
-    void erase(const std::string& k)
+class EvictionPool { //Best candidates found by sampling so far, not thread safe, the store serializes evictions
+public:
+    void offer(const std::string_view key, const uint32_t score) //Higher scores are evicted first, kept if there is room or it beats the worst one
     {
-        tbb::concurrent_hash_map<std::string, std::list<std::string>::iterator>::accessor accessor;
-        if (keyToOrder.find(accessor, k))
-        {
-            order.erase(accessor->second);
-            keyToOrder.erase(accessor);
-        }
+        if (const auto same = std::ranges::find(candidates, key, &Candidate::key); same != candidates.end()) candidates.erase(same); //Sampled again, rescored
+        if (candidates.size() == EVICTION_POOL_SIZE && score <= candidates.front().score) return;
+        const auto at = std::ranges::upper_bound(candidates, score, {}, &Candidate::score);
+        candidates.insert(at, {score, std::string(key)});
+        if (candidates.size() > EVICTION_POOL_SIZE) candidates.erase(candidates.begin());
     }
-
-    void clear()
+    std::optional<std::string> takeBest() //The key may be gone by now, the caller checks
     {
-        order.clear();
-        keyToOrder.clear();
+        if (candidates.empty()) return std::nullopt;
+        std::string key = std::move(candidates.back().key);
+        candidates.pop_back();
+        return key;
     }
+    bool empty() const { return candidates.empty(); }
+    void clear() { candidates.clear(); }
 
 private:
-    std::list<std::string> order; //Order queue
-    tbb::concurrent_hash_map<std::string, std::list<std::string>::iterator> keyToOrder; //Key->iterator in order queue
-};
\ No newline at end of file
+    struct Candidate {
+        uint32_t score;
+        std::string key;
+    };
+    std::vector<Candidate> candidates; //Ascending score
+};
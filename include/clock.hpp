@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stop_token>
+#include <thread>
+
+#include "config.h"
+
+//Cached steady clock like Redis' mstime cache: a ticker thread stores the time every CLOCK_TICK_MS, so the ttl check on every
+//key access and the access clock stamp are one relaxed load instead of a clock call, at the cost of being up to a tick behind
+class CoarseClock {
+public:
+    static int64_t nowMs() { return instance().ms.load(std::memory_order_relaxed); }
+    static int64_t preciseMs() //What the ticker stores
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static int64_t unixMs() //Wall clock, for EXPIREAT style times
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    static bool reached(const int64_t deadline) //The cached time settles it unless the deadline is within a few ticks, where a lagging ticker could keep a key alive past it
+    {
+        const int64_t now = nowMs();
+        return deadline <= now || (deadline - now <= SETTLE_MS && deadline <= preciseMs());
+    }
+
+private:
+    static constexpr int64_t SETTLE_MS = 10 * CLOCK_TICK_MS;
+
+    CoarseClock() : ms(preciseMs()), ticker([this](const std::stop_token stop)
+    {
+        while (!stop.stop_requested())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(CLOCK_TICK_MS));
+            ms.store(preciseMs(), std::memory_order_relaxed);
+        }
+    }) {}
+    static CoarseClock& instance() //Started by the first reader, tests need no server
+    {
+        static CoarseClock clock;
+        return clock;
+    }
+
+    std::atomic<int64_t> ms;
+    std::jthread ticker; //Last, so it starts after ms is set and is joined first
+};
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include "kvstore.hpp"
+#include "outputbuffer.hpp"
 #include "pubsub.hpp"
 #include "session.hpp"
 
@@ -10,82 +13,118 @@ enum class Commands
     PING, ECHO,
     DEL, EXISTS, FLUSHALL,
     SET, GET, INCR, DCR, INCRBY, DCRBY, MGET, APPEND,
-    EXPIRE, TTL, PERSIST,
+    EXPIRE, PEXPIRE, EXPIREAT, PEXPIREAT, TTL, PTTL, PERSIST,
     LPUSH, RPUSH, LPOP, RPOP, LRANGE, LLEN, LINDEX, LSET, LREM,
     SADD, SREM, SISMEMBER, SMEMBERS, SCARD, SPOP,
     HSET, HGET, HDEL, HEXISTS, HLEN, HKEYS, HVALS, HMGET, HGETALL,
     PUBLISH, SUBSCRIBE, UNSUBSCRIBE,
     MULTI, EXEC, DISCARD,
-    CONFIG, TYPE, SAVE,
+    CONFIG, TYPE, OBJECT, SAVE, INFO,
     UNKNOWN
-    //TODO INFO, BRPOP for task queues, LMOVE, KEYS, RENAME...
+    //TODO BRPOP for task queues, LMOVE, KEYS, RENAME...
 };
 
-auto strToCmd(const std::string& cmd) -> Commands;
+enum CommandFlags : unsigned
+{
+    CMD_WRITE = 1 << 0, //May change the keyspace
+    CMD_READONLY = 1 << 1,
+    CMD_SLOW = 1 << 2, //O(N) in the size of a value or touches the disk
+    CMD_PUBSUB = 1 << 3,
+    CMD_NOQUEUE = 1 << 4, //Runs right away inside MULTI instead of being queued
+    CMD_DENYOOM = 1 << 5 //May grow memory, refused once over maxmemory if nothing can be evicted
+};
+
+struct CommandContext { //What a handler may touch, session is null when run on a key's owner shard
+    KVStore& store;
+    PubSub& pubsub;
+    Session* session;
+};
+using CommandHandler = OutputBuffer (*)(CommandContext& ctx, const std::vector<std::string_view>& args); //Args exclude the name
+
+struct CommandInfo { //One registry entry, the table is built at compile time in commands.cpp
+    std::string_view name; //Upper case
+    Commands cmd;
+    int arity; //Counts the name like Redis, negative means at least -arity
+    unsigned flags;
+    int firstKey, lastKey, keyStep; //Positions counting the name, firstKey 0 for keyless cmds and lastKey -1 for up to the end
+    CommandHandler handler; //Null for cmds the server runs itself (EXEC)
+
+    bool arityOk(const size_t argc) const { return arity >= 0 ? argc == static_cast<size_t>(arity) : argc >= static_cast<size_t>(-arity); }
+};
+
+const CommandInfo* lookupCommand(std::string_view name); //Case insensitive perfect hash, null if unknown, never allocates
+auto strToCmd(std::string_view cmd) -> Commands;
 
 //Basic commands
-std::string handlePING(const std::vector<std::string>& args);
-std::string handleECHO(const std::vector<std::string>& args);
-std::string handleDEL(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleEXISTS(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleFLUSHALL(KVStore& kvstore, const std::vector<std::string>& args);
+std::string handlePING(const std::vector<std::string_view>& args);
+std::string handleECHO(const std::vector<std::string_view>& args);
+std::string handleDEL(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleEXISTS(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleFLUSHALL(KVStore& kvstore, const std::vector<std::string_view>& args);
 
 //String commands
-std::string handleSET(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleGET(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleINCR(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleDCR(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleINCRBY(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleDCRBY(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleMGET(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleAPPEND(KVStore& kvstore, const std::vector<std::string>& args);
+std::string handleSET(KVStore& kvstore, const std::vector<std::string_view>& args); //[NX|XX] [GET] [EX s|PX ms|KEEPTTL]
+std::string handleGET(KVStore& kvstore, const std::vector<std::string_view>& args);
+OutputBuffer handleGETPinned(KVStore& kvstore, const std::vector<std::string_view>& args); //Same reply, large values are sent straight from the store
+std::string handleINCR(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleDCR(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleINCRBY(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleDCRBY(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleMGET(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleAPPEND(KVStore& kvstore, const std::vector<std::string_view>& args);
 
 //TTL commands
-std::string handleEXPIRE(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleTTL(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handlePERSIST(KVStore& kvstore, const std::vector<std::string>& args);
+std::string handleEXPIRE(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handlePEXPIRE(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleEXPIREAT(KVStore& kvstore, const std::vector<std::string_view>& args); //Unix seconds
+std::string handlePEXPIREAT(KVStore& kvstore, const std::vector<std::string_view>& args); //Unix ms
+std::string handleTTL(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handlePTTL(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handlePERSIST(KVStore& kvstore, const std::vector<std::string_view>& args);
 
 //List commands
-std::string handleLPUSH(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleRPUSH(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleLPOP(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleRPOP(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleLRANGE(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleLLEN(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleLINDEX(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleLSET(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleLREM(KVStore& kvstore, const std::vector<std::string>& args);
+std::string handleLPUSH(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleRPUSH(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleLPOP(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleRPOP(KVStore& kvstore, const std::vector<std::string_view>& args);
+OutputBuffer handleLRANGE(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleLLEN(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleLINDEX(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleLSET(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleLREM(KVStore& kvstore, const std::vector<std::string_view>& args);
 
 //Set commands
-std::string handleSADD(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleSREM(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleSISMEMBER(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleSMEMBERS(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleSCARD(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleSPOP(KVStore& kvstore, const std::vector<std::string>& args);
+std::string handleSADD(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleSREM(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleSISMEMBER(KVStore& kvstore, const std::vector<std::string_view>& args);
+OutputBuffer handleSMEMBERS(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleSCARD(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleSPOP(KVStore& kvstore, const std::vector<std::string_view>& args);
 
 //Hash commands
-std::string handleHSET(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleHGET(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleHDEL(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleHEXISTS(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleHLEN(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleHKEYS(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleHVALS(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleHMGET(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleHGETALL(KVStore& kvstore, const std::vector<std::string>& args);
+std::string handleHSET(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleHGET(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleHDEL(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleHEXISTS(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleHLEN(KVStore& kvstore, const std::vector<std::string_view>& args);
+OutputBuffer handleHKEYS(KVStore& kvstore, const std::vector<std::string_view>& args);
+OutputBuffer handleHVALS(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleHMGET(KVStore& kvstore, const std::vector<std::string_view>& args);
+OutputBuffer handleHGETALL(KVStore& kvstore, const std::vector<std::string_view>& args);
 
 //Pub/Sub commands
-std::string handlePUBLISH(PubSub& ps, const std::vector<std::string>& args);
-std::string handleSUBSCRIBE(PubSub& ps, const std::vector<std::string>& args, int sock);
-std::string handleUNSUBSCRIBE(PubSub& ps, const std::vector<std::string>& args, int sock);
+std::string handlePUBLISH(PubSub& ps, const std::vector<std::string_view>& args);
+std::string handleSUBSCRIBE(PubSub& ps, const std::vector<std::string_view>& args, Session* session);
+std::string handleUNSUBSCRIBE(PubSub& ps, const std::vector<std::string_view>& args, Session* session);
 
 //Transaction commands
-std::string handleMULTI(Session* session, const std::vector<std::string>& args);
-std::string handleEXEC(Session* session, const std::vector<std::string>& args);
-std::string handleDISCARD(Session* session, const std::vector<std::string>& args);
+std::string handleMULTI(Session* session, const std::vector<std::string_view>& args);
+std::string handleEXEC(Session* session, const std::vector<std::string_view>& args);
+std::string handleDISCARD(Session* session, const std::vector<std::string_view>& args);
 
 // Misc commands
-std::string handleCONFIG(const std::vector<std::string>& args);
-std::string handleTYPE(KVStore& kvstore, const std::vector<std::string>& args);
-std::string handleSAVE(KVStore& kvstore, const std::vector<std::string>& args);
+std::string handleCONFIG(KVStore& kvstore, const std::vector<std::string_view>& args); //GET name or *, SET maxmemory, maxmemory-policy or maxmemory-samples
+std::string handleTYPE(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleOBJECT(KVStore& kvstore, const std::vector<std::string_view>& args); //FREQ or IDLETIME of a key, without counting as an access
+std::string handleSAVE(KVStore& kvstore, const std::vector<std::string_view>& args);
+std::string handleINFO(KVStore& kvstore, const std::vector<std::string_view>& args); //Memory and keyspace sections, the client's own shard in shared-nothing mode
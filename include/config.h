@@ -4,10 +4,45 @@
 //Maybe change to non const and let configuring through CLI (CONFIG)
 
 constexpr auto SAVEFILE_PATH = "dump.rdb"; //Can be anything really
-constexpr int POOL_SIZE = 8; //Thread count
+constexpr int POOL_SIZE = 8; //Event loop thread count
+constexpr int EPOLL_BATCH = 256; //Max events handled per epoll_wait
+constexpr int READ_CHUNK = 16384; //Min free bytes offered to each recv call
+constexpr unsigned RECV_KEEP = 1 << 20; //Drained receive buffers bigger than this are released
+constexpr int LISTEN_BACKLOG = 511; //Pending connection queue length
+constexpr long long PROTO_MAX_BULK = 512LL << 20; //Largest bulk string accepted from a client
+constexpr long long PROTO_MAX_ARGS = 1 << 20; //Largest multibulk count
+constexpr unsigned PROTO_MAX_LINE = 65536; //Longest length line before the client is dropped
+constexpr int IOV_BATCH = 64; //Reply segments handed to one sendmsg
+constexpr unsigned OUTPUT_CHUNK = 16384; //Small replies coalesce into chunks of about this size
+constexpr unsigned ZERO_COPY_MIN = 16384; //Values and replies this big are queued by reference instead of copied
+constexpr unsigned URING_ENTRIES = 4096; //Submission queue depth per io_uring loop
+constexpr unsigned URING_BUF_COUNT = 1024; //Provided recv buffers (READ_CHUNK bytes each) per loop, power of 2
+constexpr unsigned SHARD_QUEUE_SIZE = 4096; //Slots per (from shard, to shard) task queue, overflow waits in a backlog
 constexpr int PORT_NUM = 6379; //Default redis port
 constexpr auto HOST_IP = "0.0.0.0";
-constexpr int KEY_LIMIT = 1000; //Max key count
+constexpr unsigned DICT_STRIPES = 256; //Independently locked shards of the keyspace table, power of 2
+constexpr unsigned REHASH_STEP_GROUPS = 1; //16 slot groups of a rehash each write moves to the new table
+constexpr unsigned REHASH_IDLE_GROUPS = 64; //Groups moved per lock hold by the background step
+constexpr int REHASH_CRON_MS = 100; //Background rehash tick
+constexpr int REHASH_CRON_US = 1000; //Time a tick may spend rehashing
+constexpr int ACTIVE_EXPIRE_CYCLE_US = 2500; //Time a tick may spend deleting expired keys, per store
+constexpr unsigned ACTIVE_EXPIRE_BATCH = 64; //Due keys a cycle takes off the timer wheel per lock hold
+constexpr unsigned SLAB_PAGE = 1 << 16; //Bytes per slab page carved into dict entry chunks
+constexpr unsigned SLAB_MAX_CHUNK = 256; //Bigger entries (long keys) are allocated on their own
+constexpr unsigned LISTPACK_MAX_ENTRIES = 128; //Lists, sets and hashes (counting fields) up to this size stay in one listpack buffer
+constexpr unsigned LISTPACK_MAX_VALUE = 64; //...as long as no element is longer than this
+constexpr unsigned QUICKLIST_NODE_BYTES = 8192; //Bigger lists are linked listpack nodes of about this size
+constexpr unsigned QUICKLIST_COMPRESS_DEPTH = 0; //Nodes this far from both ends stay raw, deeper ones are LZF compressed, 0 turns compression off
+constexpr unsigned INTSET_MAX_ENTRIES = 512; //Sets of only integers up to this size are kept as a sorted intset
+constexpr unsigned long long MAXMEMORY = 0; //Bytes of keys and values (INFO used_memory) before writes evict or are refused, 0 is no limit, CONFIG SET maxmemory changes it
+constexpr auto MAXMEMORY_POLICY = "allkeys-lru"; //Any name in EVICTION_POLICIES (kvstore.hpp), CONFIG SET maxmemory-policy changes it
+constexpr unsigned MAXMEMORY_SAMPLES = 5; //Random keys looked at per eviction, more is closer to true LRU and slower, CONFIG SET maxmemory-samples changes it
+constexpr unsigned EVICTION_POOL_SIZE = 16; //Most idle sampled keys kept between evictions
+constexpr unsigned CLOCK_TICK_MS = 1; //How often the cached clock that ttls and the access clock read is refreshed
+constexpr unsigned LRU_CLOCK_RESOLUTION_MS = 1000; //Tick of the per key access clock
+constexpr unsigned LFU_LOG_FACTOR = 10; //Higher makes the allkeys-lfu access counter climb more slowly
+constexpr unsigned LFU_DECAY_MINUTES = 1; //The counter loses one per this many minutes unused, 0 never decays
+constexpr unsigned LFU_INIT_VAL = 5; //Counter of a new key, so it is not evicted before it had a chance to be read
 constexpr int SNAP_TIMER = 60; //Save every x seconds
 
 
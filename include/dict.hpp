@@ -0,0 +1,573 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "config.h"
+#include "slab.hpp"
+
+//Keyspace table: DICT_STRIPES independently locked shards, each an open addressing SwissTable
+//One control byte per slot (7 hash bits, empty or deleted) is scanned 16 at a time, a slot is a pointer to its entry
+//Entries are slab chunks holding the value with the key bytes right behind it, so a key costs no allocation of its own
+//Growing is incremental like Redis: the old table stays readable and each write moves a group of it into the new one
+//An entry may carry an int64 deadline between itself and its key bytes, flagged in what would be padding, so keys without one pay nothing
+template<class V>
+class Dict {
+public:
+    struct Entry { //Lives in a slab chunk, only moves when its deadline is added or dropped
+        V second;
+        uint32_t keyLen;
+        uint32_t flags = 0;
+
+        static constexpr uint32_t HAS_DEADLINE = 1;
+
+        std::string_view key() const { return {tail() + (hasDeadline() ? sizeof(int64_t) : 0), keyLen}; }
+        bool hasDeadline() const { return flags & HAS_DEADLINE; }
+        int64_t deadline() const //Only when hasDeadline()
+        {
+            int64_t at;
+            std::memcpy(&at, tail(), sizeof(at));
+            return at;
+        }
+
+    private:
+        friend class Dict;
+        const char* tail() const { return reinterpret_cast<const char*>(this + 1); }
+        char* tail() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+private:
+    static constexpr size_t GROUP = 16;
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+    static constexpr size_t NONE = ~size_t{0};
+    static_assert(std::has_single_bit(DICT_STRIPES), "stripes are picked by the top hash bits");
+    static_assert(alignof(Entry) <= Slab::ALIGN);
+
+    static size_t hashOf(const std::string_view key) { return std::hash<std::string_view>{}(key); }
+    static int8_t h2(const size_t hash) { return static_cast<int8_t>(hash & 0x7F); } //Full slots keep the sign bit clear
+    static size_t chunkSize(const size_t keyLen, const bool deadline = false) { return sizeof(Entry) + (deadline ? sizeof(int64_t) : 0) + keyLen; }
+
+    static uint32_t matchByte(const int8_t* group, const int8_t byte)
+    {
+#if defined(__SSE2__)
+        const __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP; ++i) mask |= static_cast<uint32_t>(group[i] == byte) << i;
+        return mask;
+#endif
+    }
+    static uint32_t matchFree(const int8_t* group) //Empty or deleted, both have the sign bit set
+    {
+#if defined(__SSE2__)
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP; ++i) mask |= static_cast<uint32_t>(group[i] < 0) << i;
+        return mask;
+#endif
+    }
+
+    class Table { //One stripe's slots, only touched under that stripe's lock, entries are owned by the stripe
+    public:
+        size_t find(const std::string_view key, const size_t hash) const
+        {
+            if (capacity == 0) return NONE;
+            const int8_t tag = h2(hash);
+            const size_t groupMask = capacity / GROUP - 1;
+            size_t g = (hash >> 7) & groupMask;
+            for (size_t step = 1;; ++step) //Triangular probing over groups reaches every group
+            {
+                const int8_t* group = ctrl.get() + g * GROUP;
+                for (uint32_t m = matchByte(group, tag); m; m &= m - 1)
+                {
+                    const size_t i = g * GROUP + std::countr_zero(m);
+                    if (slots[i]->key() == key) return i;
+                }
+                if (matchByte(group, EMPTY)) return NONE; //Key would have been placed here
+                g = (g + step) & groupMask;
+            }
+        }
+
+        size_t insertNew(const size_t hash, Entry* entry) //Caller checked the key is absent and made room
+        {
+            const size_t i = freeSlot(hash);
+            if (ctrl[i] == DELETED) --tombstones;
+            ctrl[i] = h2(hash);
+            slots[i] = entry;
+            ++used;
+            return i;
+        }
+
+        void eraseAt(const size_t i) //Forgets the slot, the entry itself is the caller's
+        {
+            --used;
+            //A group that still has an empty slot never sent a probe further, so the slot can go back to empty
+            if (matchByte(ctrl.get() + (i & ~(GROUP - 1)), EMPTY)) ctrl[i] = EMPTY;
+            else
+            {
+                ctrl[i] = DELETED;
+                ++tombstones;
+            }
+        }
+
+        void reset(const size_t newCapacity) //Forgets every slot, newCapacity 0 frees the arrays
+        {
+            ctrl.reset();
+            slots.reset();
+            capacity = used = tombstones = 0;
+            if (newCapacity == 0) return;
+            capacity = newCapacity;
+            ctrl = std::make_unique_for_overwrite<int8_t[]>(capacity);
+            std::memset(ctrl.get(), EMPTY, capacity);
+            slots = std::make_unique_for_overwrite<Entry*[]>(capacity);
+        }
+        void swap(Table& other) noexcept
+        {
+            std::swap(ctrl, other.ctrl);
+            std::swap(slots, other.slots);
+            std::swap(capacity, other.capacity);
+            std::swap(used, other.used);
+            std::swap(tombstones, other.tombstones);
+        }
+
+        bool needsRoom() const { return (used + tombstones + 1) * 8 > capacity * 7; } //One more insert would pass 7/8 load
+        size_t nextCapacity() const //Doubles when live entries pass half the slots, otherwise the rehash only sweeps tombstones
+        {
+            return capacity == 0 ? GROUP : (used + 1) * 2 > capacity ? capacity * 2 : capacity;
+        }
+
+        template<class Fn> void forEach(Fn& fn) const
+        {
+            for (size_t i = 0; i < capacity; ++i)
+            {
+                if (ctrl[i] >= 0) fn(std::as_const(*slots[i]));
+            }
+        }
+
+        size_t size() const { return used; }
+        size_t slotCount() const { return capacity; }
+        size_t bytes() const { return capacity * (sizeof(Entry*) + 1); }
+        bool full(const size_t i) const { return ctrl[i] >= 0; }
+        Entry* at(const size_t i) const { return slots[i]; }
+        void replace(const size_t i, Entry* entry) { slots[i] = entry; } //Same key, moved to another chunk
+
+    private:
+        size_t freeSlot(const size_t hash) const
+        {
+            const size_t groupMask = capacity / GROUP - 1;
+            size_t g = (hash >> 7) & groupMask;
+            for (size_t step = 1;; ++step)
+            {
+                if (const uint32_t m = matchFree(ctrl.get() + g * GROUP)) return g * GROUP + std::countr_zero(m);
+                g = (g + step) & groupMask;
+            }
+        }
+
+        std::unique_ptr<int8_t[]> ctrl;
+        std::unique_ptr<Entry*[]> slots;
+        size_t capacity = 0; //Power of two multiple of GROUP, 0 until the first insert
+        size_t used = 0;
+        size_t tombstones = 0;
+    };
+
+    struct alignas(64) Stripe { //Own cache line so neighbouring locks don't false share
+        mutable std::shared_mutex lock;
+        Table table; //Inserts always land here
+        Table old; //Previous table while a rehash drains it, no slots otherwise
+        size_t cursor = 0; //First old slot not moved yet
+        Slab slab; //Entry chunks of this stripe's keys
+
+        Stripe() = default;
+        Stripe(const Stripe&) = delete;
+        Stripe& operator=(const Stripe&) = delete;
+        ~Stripe() { clear(); }
+
+        template<class... Args> Entry* make(const std::string_view key, Args&&... value)
+        {
+            void* chunk = slab.allocate(chunkSize(key.size()));
+            Entry* entry = new (chunk) Entry{V(std::forward<Args>(value)...), static_cast<uint32_t>(key.size())};
+            std::memcpy(entry->tail(), key.data(), key.size());
+            return entry;
+        }
+        void remove(Table& from, const size_t i)
+        {
+            Entry* entry = from.at(i);
+            from.eraseAt(i);
+            drop(entry);
+        }
+        void drop(Entry* entry)
+        {
+            const size_t bytes = chunkSize(entry->keyLen, entry->hasDeadline());
+            std::destroy_at(entry);
+            slab.deallocate(entry, bytes);
+        }
+        Entry* relocate(Table& in, const size_t i, const bool deadline) //Into a chunk with or without room for a deadline, the value is moved
+        {
+            Entry* old = in.at(i);
+            void* chunk = slab.allocate(chunkSize(old->keyLen, deadline));
+            Entry* moved = new (chunk) Entry{std::move(old->second), old->keyLen, deadline ? Entry::HAS_DEADLINE : 0};
+            const std::string_view key = old->key();
+            std::memcpy(moved->tail() + (deadline ? sizeof(int64_t) : 0), key.data(), key.size());
+            in.replace(i, moved);
+            drop(old);
+            return moved;
+        }
+        size_t clear() //Returns the entries dropped
+        {
+            const size_t dropped = table.size() + old.size();
+            for (Table* from : {&table, &old})
+            {
+                for (size_t i = 0; i < from->slotCount(); ++i)
+                {
+                    if (from->full(i)) remove(*from, i);
+                }
+                from->reset(0);
+            }
+            cursor = 0;
+            slab.clear();
+            return dropped;
+        }
+
+        bool rehashing() const { return old.slotCount() != 0; }
+        size_t migrate(const size_t groups) //Moves the next groups of old slots over, returns the entries moved
+        {
+            size_t moved = 0;
+            const size_t end = std::min(old.slotCount(), cursor + groups * GROUP);
+            for (; cursor < end; ++cursor)
+            {
+                if (!old.full(cursor)) continue;
+                Entry* entry = old.at(cursor);
+                table.insertNew(hashOf(entry->key()), entry); //Only the pointer moves
+                old.eraseAt(cursor);
+                ++moved;
+            }
+            if (cursor == old.slotCount())
+            {
+                old.reset(0);
+                cursor = 0;
+            }
+            return moved;
+        }
+        size_t makeRoom() //Before an insert, starts a rehash once the table passes its load limit
+        {
+            if (!table.needsRoom()) return 0;
+            size_t moved = 0;
+            if (rehashing()) moved = migrate(old.slotCount() / GROUP); //Filled up mid rehash (never with the default step), finish it first
+            old.swap(table);
+            table.reset(old.nextCapacity());
+            return moved;
+        }
+
+        std::pair<Table*, size_t> locate(const std::string_view key, const size_t hash) //Table is null if the key is in neither
+        {
+            if (const size_t i = table.find(key, hash); i != NONE) return {&table, i};
+            if (rehashing())
+            {
+                if (const size_t i = old.find(key, hash); i != NONE) return {&old, i};
+            }
+            return {nullptr, NONE};
+        }
+    };
+
+    Stripe& stripeOf(const size_t hash) const
+    {
+        if constexpr (DICT_STRIPES == 1) return stripes[0]; //A shift by 64 would be UB
+        else return stripes[hash >> (64 - std::countr_zero(DICT_STRIPES))];
+    }
+    void step(Stripe& stripe) //Every write under the exclusive lock pays a little of a running rehash
+    {
+        if (stripe.rehashing()) rehashMoved.fetch_add(stripe.migrate(REHASH_STEP_GROUPS), std::memory_order_relaxed);
+    }
+    void makeRoom(Stripe& stripe)
+    {
+        const bool started = stripe.table.needsRoom();
+        rehashMoved.fetch_add(stripe.makeRoom(), std::memory_order_relaxed);
+        if (started && stripe.rehashing()) rehashes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+public:
+    class const_accessor { //Holds its stripe's lock (shared) while it points at an entry, like tbb's accessors
+    public:
+        const_accessor() = default;
+        const_accessor(const const_accessor&) = delete;
+        const_accessor& operator=(const const_accessor&) = delete;
+        ~const_accessor() { release(); }
+
+        void release()
+        {
+            if (!stripe) return;
+            if (exclusive) stripe->lock.unlock();
+            else stripe->lock.unlock_shared();
+            stripe = nullptr;
+            entry = nullptr;
+        }
+        bool empty() const { return entry == nullptr; }
+        const Entry* operator->() const { return entry; }
+        const Entry& operator*() const { return *entry; }
+
+    protected:
+        friend class Dict;
+        void hold(Stripe* held, Entry* found, const bool write)
+        {
+            stripe = held;
+            entry = found;
+            exclusive = write;
+        }
+
+        Stripe* stripe = nullptr;
+        Entry* entry = nullptr;
+        bool exclusive = false;
+    };
+
+    class accessor : public const_accessor { //Exclusive, the entry may be changed or erased through it
+    public:
+        Entry* operator->() const { return this->entry; }
+        Entry& operator*() const { return *this->entry; }
+    };
+
+    Dict() : stripes(std::make_unique<Stripe[]>(DICT_STRIPES)) {}
+    static size_t entryBytes(const size_t keyLen, const bool deadline = false) //What one key costs: its slab chunk (rounded like the slab does) and a slot
+    {
+        return (chunkSize(keyLen, deadline) + Slab::ALIGN - 1) / Slab::ALIGN * Slab::ALIGN + sizeof(Entry*) + 1;
+    }
+    static const Entry& entryOf(const V& value) //The entry a value lives in, for intrusive structures linking values
+    {
+        static_assert(std::is_standard_layout_v<Entry>, "second is at offset 0");
+        return *reinterpret_cast<const Entry*>(&value);
+    }
+    Dict(const Dict&) = delete;
+    Dict& operator=(const Dict&) = delete;
+
+    bool find(const_accessor& acc, const std::string_view key) const
+    {
+        acc.release();
+        const size_t hash = hashOf(key);
+        Stripe& stripe = stripeOf(hash);
+        stripe.lock.lock_shared();
+        const auto [table, i] = stripe.locate(key, hash);
+        if (!table)
+        {
+            stripe.lock.unlock_shared();
+            return false;
+        }
+        acc.hold(&stripe, table->at(i), false);
+        return true;
+    }
+    bool find(accessor& acc, const std::string_view key)
+    {
+        acc.release();
+        const size_t hash = hashOf(key);
+        Stripe& stripe = stripeOf(hash);
+        stripe.lock.lock();
+        step(stripe);
+        const auto [table, i] = stripe.locate(key, hash);
+        if (!table)
+        {
+            stripe.lock.unlock();
+            return false;
+        }
+        acc.hold(&stripe, table->at(i), true);
+        return true;
+    }
+
+    bool insert(accessor& acc, const std::string_view key) //Points acc at the key's entry, true if it had to be created (value default constructed)
+    {
+        acc.release();
+        const size_t hash = hashOf(key);
+        Stripe& stripe = stripeOf(hash);
+        stripe.lock.lock();
+        step(stripe);
+        auto [table, i] = stripe.locate(key, hash);
+        const bool created = !table;
+        if (created)
+        {
+            makeRoom(stripe);
+            table = &stripe.table;
+            i = table->insertNew(hash, stripe.make(key));
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+        acc.hold(&stripe, table->at(i), true);
+        return created;
+    }
+    bool insert(const std::string_view key, V value) //False and nothing changes if the key exists
+    {
+        const size_t hash = hashOf(key);
+        Stripe& stripe = stripeOf(hash);
+        std::unique_lock lock(stripe.lock);
+        step(stripe);
+        if (stripe.locate(key, hash).first) return false;
+        makeRoom(stripe);
+        stripe.table.insertNew(hash, stripe.make(key, std::move(value)));
+        count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void erase(accessor& acc)
+    {
+        if (acc.empty()) return;
+        Stripe& stripe = *acc.stripe;
+        const std::string_view key = acc.entry->key();
+        const auto [table, i] = stripe.locate(key, hashOf(key));
+        stripe.remove(*table, i);
+        count.fetch_sub(1, std::memory_order_relaxed);
+        acc.release();
+    }
+    void setDeadline(accessor& acc, const int64_t deadline) //The first one moves the entry to a bigger chunk, acc follows it
+    {
+        Entry* entry = acc.entry;
+        if (!entry->hasDeadline())
+        {
+            const std::string_view key = entry->key();
+            const auto [table, i] = acc.stripe->locate(key, hashOf(key));
+            entry = acc.stripe->relocate(*table, i, true);
+            acc.entry = entry;
+        }
+        std::memcpy(entry->tail(), &deadline, sizeof(deadline));
+    }
+    void clearDeadline(accessor& acc) //Moves the entry back to a chunk without one
+    {
+        if (!acc.entry->hasDeadline()) return;
+        const std::string_view key = acc.entry->key();
+        const auto [table, i] = acc.stripe->locate(key, hashOf(key));
+        acc.entry = acc.stripe->relocate(*table, i, false);
+    }
+
+    bool erase(const std::string_view key)
+    {
+        const size_t hash = hashOf(key);
+        Stripe& stripe = stripeOf(hash);
+        std::unique_lock lock(stripe.lock);
+        step(stripe);
+        const auto [table, i] = stripe.locate(key, hash);
+        if (!table) return false;
+        stripe.remove(*table, i);
+        count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void clear()
+    {
+        for (size_t s = 0; s < DICT_STRIPES; ++s)
+        {
+            std::unique_lock lock(stripes[s].lock);
+            count.fetch_sub(stripes[s].clear(), std::memory_order_relaxed);
+        }
+    }
+
+    template<class Fn> void forEach(Fn&& fn) const //fn(const Entry&), one stripe locked at a time
+    {
+        for (size_t s = 0; s < DICT_STRIPES; ++s)
+        {
+            std::shared_lock lock(stripes[s].lock);
+            stripes[s].table.forEach(fn);
+            stripes[s].old.forEach(fn);
+        }
+    }
+
+    template<class Fn> size_t sample(const size_t n, const uint64_t seed, Fn&& fn) const //fn(const Entry&) on up to n entries from a random slot of a random stripe on, like Redis' dictGetSomeKeys, returns how many
+    {
+        size_t seen = 0;
+        const size_t first = seed % DICT_STRIPES;
+        for (size_t s = 0; s < DICT_STRIPES && seen < n; ++s) //Walks on into the next stripes when this one has too few
+        {
+            const Stripe& stripe = stripes[(first + s) % DICT_STRIPES];
+            std::shared_lock lock(stripe.lock);
+            for (const Table* from : {&stripe.table, &stripe.old})
+            {
+                const size_t slots = from->slotCount();
+                const size_t start = slots ? (seed >> 32) & (slots - 1) : 0;
+                for (size_t i = 0; i < slots && seen < n; ++i)
+                {
+                    const size_t at = (start + i) & (slots - 1);
+                    if (!from->full(at)) continue;
+                    fn(std::as_const(*from->at(at)));
+                    ++seen;
+                }
+            }
+        }
+        return seen;
+    }
+
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+    size_t memoryUsage() const //Bytes held by slot arrays and entry slabs, not what values point to
+    {
+        size_t bytes = sizeof(Stripe) * DICT_STRIPES;
+        for (size_t s = 0; s < DICT_STRIPES; ++s)
+        {
+            std::shared_lock lock(stripes[s].lock);
+            bytes += stripes[s].table.bytes() + stripes[s].old.bytes() + stripes[s].slab.bytesReserved();
+        }
+        return bytes;
+    }
+
+    bool rehashFor(const std::chrono::microseconds budget) //Idle time step, skips stripes a request holds, true while rehashes remain
+    {
+        const auto deadline = std::chrono::steady_clock::now() + budget;
+        bool pending = false;
+        for (size_t s = 0; s < DICT_STRIPES; ++s)
+        {
+            Stripe& stripe = stripes[s];
+            std::unique_lock lock(stripe.lock, std::try_to_lock);
+            if (!lock.owns_lock())
+            {
+                pending = true; //Can't tell, the next tick looks again
+                continue;
+            }
+            while (stripe.rehashing() && std::chrono::steady_clock::now() < deadline)
+            {
+                rehashMoved.fetch_add(stripe.migrate(REHASH_IDLE_GROUPS), std::memory_order_relaxed);
+            }
+            pending |= stripe.rehashing();
+        }
+        return pending;
+    }
+
+    struct RehashStats {
+        size_t rehashing = 0; //Stripes with two tables right now
+        size_t slotsLeft = 0; //Old slots those rehashes still have to visit
+        size_t slotsTotal = 0;
+        size_t moved = 0; //Entries migrated since start
+        size_t started = 0; //Rehashes since start
+    };
+    RehashStats rehashStats() const
+    {
+        RehashStats stats;
+        for (size_t s = 0; s < DICT_STRIPES; ++s)
+        {
+            std::shared_lock lock(stripes[s].lock);
+            if (!stripes[s].rehashing()) continue;
+            ++stats.rehashing;
+            stats.slotsLeft += stripes[s].old.slotCount() - stripes[s].cursor;
+            stats.slotsTotal += stripes[s].old.slotCount();
+        }
+        stats.moved = rehashMoved.load(std::memory_order_relaxed);
+        stats.started = rehashes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    std::unique_ptr<Stripe[]> stripes;
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> rehashMoved{0};
+    std::atomic<size_t> rehashes{0};
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+#include "eventloop.hpp"
+#include "session.hpp"
+
+class Server;
+
+class EpollLoop final : public EventLoop {
+public:
+    EpollLoop(Server& server, int listenSock, int id);
+    ~EpollLoop() override;
+
+    void run() override; //Blocks in epoll_wait handling accepts and sessions until stop()
+    void stop() override; //Thread safe, wakes the loop through its eventfd
+    void wake() override;
+    void flush(Session* session) override;
+
+private:
+    void acceptAll(); //Drains the listen backlog, new sessions are owned by this loop
+    void handleReadable(Session* session); //Reads until EAGAIN (edge triggered) and handles complete cmds
+    bool writeOut(Session* session); //Writes until EAGAIN, false if the peer is gone
+    void closeSession(Session* session);
+
+    Server& server;
+    int listenSock;
+    int epollFd;
+    int wakeFd; //eventfd used to break out of epoll_wait on stop() or wake()
+    std::atomic<bool> running{true};
+
+    std::unordered_map<int, std::unique_ptr<Session>> sessions; //Sock->session, only accessed by the loop thread
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class Server;
+struct Session;
+
+enum class IOBackend {EPOLL, URING};
+
+auto strToIOBackend(std::string_view name) -> std::optional<IOBackend>; //"epoll" or "uring"
+
+class EventLoop { //Pluggable IO layer, every loop moves bytes between its sockets and Session buffers
+public:
+    explicit EventLoop(const int id) : loopId(id) {}
+    virtual ~EventLoop() = default;
+
+    virtual void run() = 0; //Blocks handling accepts and sessions until stop()
+    virtual void stop() = 0; //Thread safe, wakes the loop so it can exit
+    virtual void wake() = 0; //Thread safe, runs the wake handler on the loop thread
+    virtual void flush(Session* session) = 0; //Loop thread only, sends the write buffer filled outside of a read (may close the session)
+
+    void post(Session* session, std::shared_ptr<const std::string> bytes); //Thread safe, queues bytes for one of this loop's sessions, written out through its write buffer on the loop thread
+    void dropPosted(Session* session); //Loop thread only, the session is closing
+
+    void setWakeHandler(std::function<void()> handler) { wakeHandler = std::move(handler); }
+    int id() const { return loopId; } //Shard index in shared-nothing mode
+
+    static std::unique_ptr<EventLoop> create(IOBackend backend, Server& server, int listenSock, int id = 0); //Falls back to epoll if io_uring is unavailable
+
+protected:
+    void deliverPosted(); //On every wake, before the wake handler
+
+    std::function<void()> wakeHandler; //Set before run(), e.g. to drain cross-shard queues
+
+private:
+    const int loopId;
+    std::mutex postLock; //Guards posted, the only state other threads touch
+    std::vector<std::pair<Session*, std::shared_ptr<const std::string>>> posted;
+};
@@ -1,21 +1,39 @@
 #pragma once
 
-#include <string>
-#include <unordered_map>
-#include <chrono>
 #include <mutex>
-#include <tbb/concurrent_hash_map.h>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <vector>
 
+#include "clock.hpp"
+#include "dict.hpp"
+#include "timerwheel.hpp"
 
-class Expiration{
+
+class Expiration{ //Index of the keys that have a ttl, the deadline a read checks lives in the key's own dict entry, this copy is for finding them
 public:
-    void setExpiry(const std::string& key, int seconds);
-    int getTTL(const std::string& key);
-    void removeAllExp(); //Clear all expired keys
-    std::optional<std::string> removeKeyExp(const std::string& key); //Specific key check (faster than checking all)
-    void erase(const std::string& key);
+    using Deadline = int64_t; //CoarseClock ms
+
+    void set(std::string_view key, Deadline deadline); //Arms or moves the key's timer
+    void erase(std::string_view key);
     void clear();
+    std::vector<std::string> expiredKeys(Deadline now) const; //Keys past their deadline, the caller deletes them from the keyspace
+    std::vector<std::string> popDue(Deadline now, size_t limit); //Up to limit keys the wheel reached by now, taken off it (still indexed until the keyspace deletes them)
+    int64_t wheelLag(Deadline now) const; //Ms of due timers not popped yet, left over when a cycle ran out of time
+    bool contains(std::string_view key) const
+    {
+        Dict<TimerNode>::const_accessor accessor;
+        return expTable.find(accessor, key);
+    }
+    size_t size() const { return expTable.size(); }
+    template<class Fn> size_t sample(size_t n, uint64_t seed, Fn&& fn) const //fn(key, deadline) on up to n random keys with a ttl, for volatile eviction
+    {
+        return expTable.sample(n, seed, [&fn](const Dict<TimerNode>::Entry& entry) { fn(entry.key(), entry.second.deadline); });
+    }
 
 private:
-    tbb::concurrent_hash_map<std::string, std::chrono::steady_clock::time_point> expTable; //Key->Time of expiration
+    Dict<TimerNode> expTable; //Key->its timer, entries never move so the wheel links them in place, a Dict so volatile eviction can sample it
+    mutable std::mutex wheelLock; //Taken after a key's expTable stripe, never the other way
+    TimerWheel wheel{CoarseClock::nowMs()};
 };
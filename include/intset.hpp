@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+class Intset { //Set of integers as one sorted malloc'd array, every entry 2, 4 or 8 bytes wide, the width only grows when a value needs it
+public:
+    Intset() = default;
+    Intset(Intset&& other) noexcept : data(other.data), count(other.count), width(other.width)
+    {
+        other.data = nullptr;
+        other.count = 0;
+        other.width = 2;
+    }
+    Intset& operator=(Intset&& other) noexcept
+    {
+        if (this != &other)
+        {
+            std::free(data);
+            data = other.data;
+            count = other.count;
+            width = other.width;
+            other.data = nullptr;
+            other.count = 0;
+            other.width = 2;
+        }
+        return *this;
+    }
+    Intset(const Intset&) = delete;
+    Intset& operator=(const Intset&) = delete;
+    ~Intset() { std::free(data); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t bytes() const { return static_cast<size_t>(count) * width; }
+    unsigned entryWidth() const { return width; }
+    long long at(const size_t i) const { return get(i, width); } //Ascending order
+
+    bool contains(const long long v) const
+    {
+        if (widthFor(v) > width) return false; //Wider than anything stored
+#if defined(__SSE2__)
+        if (width < 8 && bytes() <= SCAN_BYTES) return scan(v);
+#endif
+        return search(v).first;
+    }
+    bool insert(const long long v) //False if it was already there
+    {
+        if (widthFor(v) > width)
+        {
+            upgradeAndAdd(v);
+            return true;
+        }
+        const auto [found, pos] = search(v);
+        if (found) return false;
+
+        resize(count + 1);
+        std::memmove(data + (pos + 1) * width, data + pos * width, (count - pos) * width);
+        set(pos, v);
+        ++count;
+        return true;
+    }
+    bool erase(const long long v)
+    {
+        if (widthFor(v) > width) return false;
+        const auto [found, pos] = search(v);
+        if (!found) return false;
+
+        std::memmove(data + pos * width, data + (pos + 1) * width, (count - pos - 1) * width);
+        resize(--count);
+        return true;
+    }
+
+private:
+    static constexpr size_t SCAN_BYTES = 128; //Up to this size a SIMD compare of every entry beats the branches of a binary search
+
+    static unsigned widthFor(const long long v)
+    {
+        if (v >= std::numeric_limits<int16_t>::min() && v <= std::numeric_limits<int16_t>::max()) return 2;
+        if (v >= std::numeric_limits<int32_t>::min() && v <= std::numeric_limits<int32_t>::max()) return 4;
+        return 8;
+    }
+    long long get(const size_t i, const unsigned w) const //Entry i read at width w
+    {
+        if (w == 2)
+        {
+            int16_t v;
+            std::memcpy(&v, data + i * 2, 2);
+            return v;
+        }
+        if (w == 4)
+        {
+            int32_t v;
+            std::memcpy(&v, data + i * 4, 4);
+            return v;
+        }
+        int64_t v;
+        std::memcpy(&v, data + i * 8, 8);
+        return v;
+    }
+    void set(const size_t i, const long long v)
+    {
+        if (width == 2)
+        {
+            const auto n = static_cast<int16_t>(v);
+            std::memcpy(data + i * 2, &n, 2);
+        }
+        else if (width == 4)
+        {
+            const auto n = static_cast<int32_t>(v);
+            std::memcpy(data + i * 4, &n, 4);
+        }
+        else
+        {
+            const auto n = static_cast<int64_t>(v);
+            std::memcpy(data + i * 8, &n, 8);
+        }
+    }
+    std::pair<bool, size_t> search(const long long v) const //Found, else where v would go
+    {
+        size_t low = 0, high = count;
+        while (low < high)
+        {
+            const size_t mid = low + (high - low) / 2;
+            const long long here = get(mid, width);
+            if (here == v) return {true, mid};
+            if (here < v) low = mid + 1;
+            else high = mid;
+        }
+        return {false, low};
+    }
+#if defined(__SSE2__)
+    bool scan(const long long v) const //Compares 8 (2 byte) or 4 (4 byte) entries at once
+    {
+        const size_t lanes = 16 / width;
+        const __m128i needle = width == 2 ? _mm_set1_epi16(static_cast<int16_t>(v)) : _mm_set1_epi32(static_cast<int32_t>(v));
+        size_t i = 0;
+        for (; i + lanes <= count; i += lanes)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * width));
+            const __m128i equal = width == 2 ? _mm_cmpeq_epi16(block, needle) : _mm_cmpeq_epi32(block, needle);
+            if (_mm_movemask_epi8(equal)) return true;
+        }
+        for (; i < count; ++i)
+        {
+            if (get(i, width) == v) return true;
+        }
+        return false;
+    }
+#endif
+    void upgradeAndAdd(const long long v) //v is wider than the set so it goes at one end, every entry is rewritten at the new width
+    {
+        const unsigned old = width;
+        const size_t front = v < 0 ? 1 : 0;
+        width = widthFor(v);
+        resize(count + 1);
+        for (size_t i = count; i-- > 0;) set(i + front, get(i, old)); //Back to front, wider entries never overwrite unread ones
+        set(front ? 0 : count, v);
+        ++count;
+    }
+    void resize(const size_t entries) //Exact fit at the current width
+    {
+        if (entries == 0)
+        {
+            std::free(data);
+            data = nullptr;
+            return;
+        }
+        void* grown = std::realloc(data, entries * width);
+        if (!grown) throw std::bad_alloc();
+        data = static_cast<char*>(grown);
+    }
+
+    char* data = nullptr;
+    uint32_t count = 0;
+    uint32_t width = 2; //Bytes per entry
+};
+static_assert(sizeof(Intset) == 16);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tbb/concurrent_hash_map.h>
+
+struct KeyHashCompare { //Transparent, lookups by string_view never build a std::string key
+    using is_transparent = void;
+    static size_t hash(const std::string_view k) { return std::hash<std::string_view>{}(k); }
+    static bool equal(const std::string_view a, const std::string_view b) { return a == b; }
+};
+
+template<class V> using KeyMap = tbb::concurrent_hash_map<std::string, V, KeyHashCompare>; //Keys are only copied when inserted
@@ -1,91 +1,233 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
 #include <optional>
+#include <string_view>
+#include <type_traits>
 #include <vector>
-#include <tbb/concurrent_hash_map.h>
 
+#include "clock.hpp"
 #include "config.h"
+#include "dict.hpp"
+#include "object.hpp"
+#include "replywriter.hpp"
 #include "respvalue.hpp"
 #include "snapshot.hpp"
 #include "expire.hpp"
 #include "LRU.hpp"
 
+//What makeRoom() does once usedMemory() is over maxmemory, a policy is which keys may go and in what order, like Redis' maxmemory-policy
+enum class EvictionPolicy : uint8_t {NOEVICTION, ALLKEYS_LRU, ALLKEYS_LFU, ALLKEYS_RANDOM, VOLATILE_LRU, VOLATILE_LFU, VOLATILE_RANDOM, VOLATILE_TTL};
+enum class EvictionOrder : uint8_t {NONE, LRU, LFU, RANDOM, TTL}; //NONE refuses writes, RANDOM skips the pool, TTL is soonest to expire first
+
+struct EvictionPolicyInfo { //One row per policy, adding one is a row here (plus its EvictionPolicy value)
+    std::string_view name; //maxmemory-policy value
+    EvictionPolicy policy;
+    bool volatileOnly; //Only keys with a ttl are candidates
+    EvictionOrder order;
+};
+inline constexpr EvictionPolicyInfo EVICTION_POLICIES[] = { //Indexed by EvictionPolicy
+    {"noeviction", EvictionPolicy::NOEVICTION, false, EvictionOrder::NONE},
+    {"allkeys-lru", EvictionPolicy::ALLKEYS_LRU, false, EvictionOrder::LRU},
+    {"allkeys-lfu", EvictionPolicy::ALLKEYS_LFU, false, EvictionOrder::LFU},
+    {"allkeys-random", EvictionPolicy::ALLKEYS_RANDOM, false, EvictionOrder::RANDOM},
+    {"volatile-lru", EvictionPolicy::VOLATILE_LRU, true, EvictionOrder::LRU},
+    {"volatile-lfu", EvictionPolicy::VOLATILE_LFU, true, EvictionOrder::LFU},
+    {"volatile-random", EvictionPolicy::VOLATILE_RANDOM, true, EvictionOrder::RANDOM},
+    {"volatile-ttl", EvictionPolicy::VOLATILE_TTL, true, EvictionOrder::TTL},
+};
+inline constexpr size_t EVICTION_POLICY_COUNT = std::size(EVICTION_POLICIES);
+static_assert(std::ranges::all_of(EVICTION_POLICIES, [](const EvictionPolicyInfo& row) { return &EVICTION_POLICIES[static_cast<size_t>(row.policy)] == &row; }), "rows in EvictionPolicy order");
+inline constexpr const EvictionPolicyInfo& policyInfo(const EvictionPolicy policy) { return EVICTION_POLICIES[static_cast<size_t>(policy)]; }
+inline constexpr bool tracksLFU(const EvictionPolicy policy) { return policyInfo(policy).order == EvictionOrder::LFU; } //Object clock bits hold an LFU counter instead of an LRU clock
+std::optional<EvictionPolicy> policyFromName(std::string_view name); //maxmemory-policy values
+std::string_view policyName(EvictionPolicy policy);
+
 class KVStore {
 public:
-    explicit KVStore(bool persist, const std::string& fileName = SAVEFILE_PATH, int maxKeys = KEY_LIMIT);
+    explicit KVStore(bool persist, const std::string& fileName = SAVEFILE_PATH, unsigned shares = 1); //Shares: stores splitting maxmemory (shards), each may use its part
     ~KVStore();
 
+    struct WrongType {}; //Returned by a command whose key holds another type
+    template<class T> struct Typed { //A command's result, or wrongType, checked under the same hold of the key as the command so nothing was changed then
+        Typed(WrongType) : wrongType(true) {}
+        template<class U = T> requires std::constructible_from<T, U> Typed(U&& result = T{}) : value(std::forward<U>(result)) {}
+        T value{};
+        bool wrongType = false;
+    };
+
     //Helpers
-    std::optional<storeType> getType(const std::string& k); //Gets storeType of value used in TYPE command too
-    std::optional<std::string> checkTypeError(const std::string& k, storeType expected); //Err if not expected
-    void checkExpKey(const std::string& k); //Checks if
-    bool spaceLeft() const;
-    void evictTill();
+    std::optional<storeType> getType(std::string_view k); //Gets storeType of value used in TYPE command too
+    void checkExpKey(std::string_view k); //Deletes k if it is past its deadline, reads do this themselves
+    std::optional<int> frequency(std::string_view k); //OBJECT FREQ: decayed LFU counter, only kept under allkeys-lfu, doesn't count as an access
+    std::optional<long long> idleSeconds(std::string_view k); //OBJECT IDLETIME, only kept under LRU policies
+
+    //Memory budget
+    size_t usedMemory() const { return usedBytes.load(std::memory_order_relaxed); } //Keys and values, kept up to date by every write
+    size_t maxMemory() const { return maxBytes.load(std::memory_order_relaxed); } //0 is no limit, the whole server's, this store gets its share
+    void setMaxMemory(size_t bytes) { maxBytes.store(bytes, std::memory_order_relaxed); }
+    EvictionPolicy evictionPolicy() const { return policy.load(std::memory_order_relaxed); }
+    void setEvictionPolicy(EvictionPolicy p) { policy.store(p, std::memory_order_relaxed); }
+    unsigned maxMemorySamples() const { return samples.load(std::memory_order_relaxed); }
+    void setMaxMemorySamples(unsigned n) { samples.store(std::max(1u, n), std::memory_order_relaxed); }
+    bool makeRoom(); //Evicts by policy until usedMemory() fits, false if it cannot and the write should be refused
+    size_t evictedKeys(EvictionPolicy p) const { return evictions[static_cast<size_t>(p)].load(std::memory_order_relaxed); } //Since start, by the policy in effect then
 
     //Persistence
     void loadFromDisk();
     void saveToDisk();
 
+    //Keyspace table upkeep
+    bool rehashStep(); //Idle time slice of running dict rehashes, true while some remain
+    size_t keyCount() const { return dict.size(); }
+    size_t dictMemory() const { return dict.memoryUsage(); }
+    Dict<Object>::RehashStats rehashStats() const { return dict.rehashStats(); }
+    size_t activeExpireCycle(); //Deletes the keys the timer wheel says are due, within ACTIVE_EXPIRE_CYCLE_US, returns how many, one caller at a time
+    struct ExpireStats {
+        size_t expired = 0; //Keys deleted for their ttl since start, on access or by a cycle
+        size_t cycles = 0;
+        size_t cycleMicros = 0; //Time spent in cycles since start
+        size_t lastCycleMicros = 0;
+        size_t timeCapReached = 0; //Cycles stopped by the budget while keys were still expiring
+        int64_t lagMs = 0; //Wheel time the last cycle left for the next, 0 when it caught up
+    };
+    ExpireStats expireStats() const;
+
     //Basics
-    int del(const std::vector<std::string>& args);
-    int exists(const std::vector<std::string>& args);
+    int del(const std::vector<std::string_view>& args);
+    int exists(const std::vector<std::string_view>& args);
     void flushall();
 
     //Strings
-    bool set(const std::string& k, const std::string& v);
-    std::optional<std::string> get(const std::string& k);
-    std::optional<int> incr(const std::string& k);
-    std::optional<int> dcr(const std::string& k);
-    std::optional<int> incrby(const std::string& k, const int& count);
-    std::optional<int> dcrby(const std::string& k, const int& count);
-    std::vector<std::optional<std::string>> mget(const std::vector<std::string>& args);
-    int append(const std::string& k, const std::string& v);
+    struct SetOptions { //SET flags
+        enum class Condition : uint8_t {ALWAYS, NX, XX};
+        Condition condition = Condition::ALWAYS;
+        bool get = false; //Reply with the old value
+        bool keepTtl = false;
+        std::optional<int64_t> deadline; //EX/PX, CoarseClock ms
+    };
+    struct SetResult {
+        bool written = false; //False when NX/XX said no or the key holds another type
+        bool wrongType = false;
+        std::optional<std::string> old; //With get
+    };
+    bool set(std::string_view k, std::string_view v);
+    SetResult set(std::string_view k, std::string_view v, const SetOptions& options); //Condition, write, ttl and old value under one hold of the key
+    Typed<std::optional<std::string>> get(std::string_view k);
+    std::shared_ptr<const std::string> getInto(std::string_view k, ReplyWriter& out); //GET's reply in one lookup: written whole into out, except a large shared value which only gets its bulk header and is returned to be queued by reference
+    Typed<std::optional<long long>> incr(std::string_view k); //nullopt when the value is no integer or would overflow
+    Typed<std::optional<long long>> dcr(std::string_view k);
+    Typed<std::optional<long long>> incrby(std::string_view k, long long count);
+    Typed<std::optional<long long>> dcrby(std::string_view k, long long count);
+    std::vector<std::optional<std::string>> mget(const std::vector<std::string_view>& args); //Keys of other types read as nil
+    Typed<int> append(std::string_view k, std::string_view v);
 
     //TTL
-    bool expire(const std::string& k, int s);
-    int ttl(const std::string& k);
-    bool persist(const std::string& k);
+    bool expire(std::string_view k, int s);
+    bool expireAt(std::string_view k, int64_t deadline); //CoarseClock ms, one already passed leaves the key to expire on its next touch
+    int ttl(std::string_view k);
+    long long pttl(std::string_view k); //-2 no key, -1 no ttl
+    bool persist(std::string_view k);
 
     //Lists
-    int lpush(const std::vector<std::string>& args);
-    int rpush(const std::vector<std::string>& args);
-    std::optional<std::string> lpop(const std::string& k);
-    std::optional<std::string> rpop(const std::string& k);
-    std::vector<std::optional<std::string>> lrange(const std::string& k, const int& start, const int& stop);
-    int llen(const std::string& k);
-    std::optional<std::string> lindex(const std::string& k, const int& index);
-    bool lset(const std::string& k, const int& index, const std::string& v);
-    int lrem(const std::string& k, const int& count, const std::string& v);
+    Typed<int> lpush(const std::vector<std::string_view>& args);
+    Typed<int> rpush(const std::vector<std::string_view>& args);
+    Typed<std::optional<std::string>> lpop(std::string_view k);
+    Typed<std::optional<std::string>> rpop(std::string_view k);
+    Typed<std::vector<std::optional<std::string>>> lrange(std::string_view k, const int& start, const int& stop);
+    Typed<int> llen(std::string_view k);
+    Typed<std::optional<std::string>> lindex(std::string_view k, const int& index);
+    Typed<bool> lset(std::string_view k, const int& index, std::string_view v);
+    Typed<int> lrem(std::string_view k, const int& count, std::string_view v);
 
     //Sets
-    int sadd(const std::vector<std::string>& args);
-    int srem(const std::vector<std::string>& args);
-    bool sismember(const std::string& k, const std::string& v);
-    std::vector<std::optional<std::string>> smembers(const std::string& k);
-    int scard(const std::string& k);
-    std::vector<std::optional<std::string>> spop(const std::string& k, const int& count);
+    Typed<int> sadd(const std::vector<std::string_view>& args);
+    Typed<int> srem(const std::vector<std::string_view>& args);
+    Typed<bool> sismember(std::string_view k, std::string_view v);
+    Typed<std::vector<std::optional<std::string>>> smembers(std::string_view k);
+    Typed<int> scard(std::string_view k);
+    Typed<std::vector<std::optional<std::string>>> spop(std::string_view k, const int& count);
 
     //Hashes
-    int hset(const std::vector<std::string>& args);
-    std::optional<std::string> hget(const std::string& k, const std::string& f);
-    int hdel(const std::vector<std::string>& args);
-    bool hexists(const std::string& k, const std::string& f);
-    int hlen(const std::string& k);
-    std::vector<std::optional<std::string>> hkeys(const std::string& k);
-    std::vector<std::optional<std::string>> hvals(const std::string& k);
-    std::vector<std::optional<std::string>> hmget(const std::vector<std::string>& args);
-    std::vector<std::optional<std::string>> hgetall(const std::string& k);
+    Typed<int> hset(const std::vector<std::string_view>& args);
+    Typed<std::optional<std::string>> hget(std::string_view k, std::string_view f);
+    Typed<int> hdel(const std::vector<std::string_view>& args);
+    Typed<bool> hexists(std::string_view k, std::string_view f);
+    Typed<int> hlen(std::string_view k);
+    Typed<std::vector<std::optional<std::string>>> hkeys(std::string_view k);
+    Typed<std::vector<std::optional<std::string>>> hvals(std::string_view k);
+    Typed<std::vector<std::optional<std::string>>> hmget(const std::vector<std::string_view>& args);
+    Typed<std::vector<std::optional<std::string>>> hgetall(std::string_view k);
+
+    //Streaming, elements are serialized from the container into out while the bucket is locked, no intermediate vector, a key of another type writes the error. An out with a sink passes the reply on in OUTPUT_CHUNK pieces as it goes
+    void lrangeInto(std::string_view k, int start, int stop, ReplyWriter& out);
+    void smembersInto(std::string_view k, ReplyWriter& out);
+    void hkeysInto(std::string_view k, ReplyWriter& out);
+    void hvalsInto(std::string_view k, ReplyWriter& out);
+    void hgetallInto(std::string_view k, ReplyWriter& out);
 
 private:
     bool persistenceToggle; //Originally for testing
-    tbb::concurrent_hash_map<std::string,RESPValue> dict; //Main store
+    Dict<Object> dict; //Main store, lock striped open addressing (dict.hpp) over compact slab allocated entries
     Expiration expirationManager; //For key ttl handling
     Snapshot snapshotManager; //Persistence
-    LRU lruManager; //Eviction on max limit reach
+    EvictionPool evictionPool; //Sampled candidates for makeRoom(), LRU.hpp
+    std::mutex evictLock; //One eviction at a time, guards evictionPool and rng
+    std::mt19937_64 rng{std::random_device{}()}; //Where sampling starts
+    EvictionPolicy poolPolicy = EvictionPolicy::NOEVICTION; //That scored the pool's candidates
+
+    const unsigned shares;
+    std::atomic<size_t> maxBytes{MAXMEMORY}; //config.h
+    std::atomic<EvictionPolicy> policy;
+    std::atomic<unsigned> samples{MAXMEMORY_SAMPLES};
+    std::atomic<size_t> usedBytes{0};
+    std::array<std::atomic<size_t>, EVICTION_POLICY_COUNT> evictions{};
+    std::atomic<size_t> expiredKeys{0};
+    std::atomic<size_t> expireCycles{0};
+    std::atomic<size_t> expireCycleMicros{0};
+    std::atomic<size_t> lastExpireCycleMicros{0};
+    std::atomic<size_t> expireTimeCapReached{0};
+    std::atomic<int64_t> expireLag{0};
 
-    //Both sizes are just key count
-    size_t maxSize = KEY_LIMIT; //config.h
-    std::atomic<size_t> currSize{1};
+    Typed<std::optional<long long>> addInt(std::string_view k, long long delta); //INCR family, nullopt on a non integer or overflow
+    Object& addKey(Dict<Object>::accessor& accessor, std::string_view k, Object value); //Inserts k (not there yet) and charges it to usedMemory
+    void removeKey(Dict<Object>::accessor& accessor, std::string_view k); //Drops k with its ttl, credits usedMemory
+    void putString(Dict<Object>::accessor& accessor, bool found, std::string_view k, std::string_view v); //SET's write, found is what lookup() said
+    void armDeadline(Dict<Object>::accessor& accessor, std::string_view k, int64_t deadline); //Inline in the entry and on the wheel, charges the first one
+    void dropDeadline(Dict<Object>::accessor& accessor, std::string_view k); //PERSIST, or an overwrite that clears the ttl
+    bool fillPool(const EvictionPolicyInfo& info); //Samples candidates into evictionPool, false if there were none (no keys, or none with a ttl)
+    std::optional<std::string> randomKey(bool volatileOnly); //For the RANDOM order
+    static bool expired(const Dict<Object>::Entry& entry) { return entry.hasDeadline() && CoarseClock::reached(entry.deadline()); }
+    template<class Accessor> bool findLive(Accessor& accessor, std::string_view k) //dict.find() that treats a key past its inline deadline as gone and deletes it, Redis' lazy expiry
+    {
+        if (!dict.find(accessor, k)) return false;
+        if (!expired(*accessor)) return true;
+        if constexpr (std::is_same_v<Accessor, Dict<Object>::accessor>)
+        {
+            removeKey(accessor, k);
+            expiredKeys.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            accessor.release(); //Deleting needs the stripe exclusively
+            checkExpKey(k);
+        }
+        return false;
+    }
+    template<class Accessor> bool lookup(Accessor& accessor, std::string_view k) //findLive() for a command on k, stamps its access clock
+    {
+        if (!findLive(accessor, k)) return false;
+        accessor->second.touch(accessStamp(accessor->second.lruClock()));
+        return true;
+    }
+    uint32_t accessStamp(const uint32_t stamp) const { return tracksLFU(evictionPolicy()) ? lfuTouched(stamp) : lruClock(); } //Clock bits after one more access
+    void charge(const size_t before, const size_t after) { usedBytes.fetch_add(after - before, std::memory_order_relaxed); } //A value went from before to after bytes, wraps for shrinking
 
 };
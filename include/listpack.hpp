@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <string_view>
+
+class Listpack { //Small list, set or hash in one malloc'd buffer: each entry is its length as a varint then its bytes, hashes alternate field and value
+public:
+    class const_iterator { //Forward only, entries are found by walking from the front
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        const_iterator() = default;
+        explicit const_iterator(const char* pos) : pos(pos) {}
+
+        std::string_view operator*() const
+        {
+            size_t len;
+            const char* body = decode(pos, len);
+            return {body, len};
+        }
+        const_iterator& operator++()
+        {
+            size_t len;
+            pos = decode(pos, len) + len;
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const const_iterator&) const = default;
+
+    private:
+        friend class Listpack;
+        const char* pos = nullptr;
+    };
+
+    Listpack() = default;
+    Listpack(Listpack&& other) noexcept : data(other.data), used(other.used), count(other.count)
+    {
+        other.data = nullptr;
+        other.used = other.count = 0;
+    }
+    Listpack& operator=(Listpack&& other) noexcept
+    {
+        if (this != &other)
+        {
+            std::free(data);
+            data = other.data;
+            used = other.used;
+            count = other.count;
+            other.data = nullptr;
+            other.used = other.count = 0;
+        }
+        return *this;
+    }
+    Listpack(const Listpack&) = delete;
+    Listpack& operator=(const Listpack&) = delete;
+    ~Listpack() { std::free(data); }
+
+    const_iterator begin() const { return const_iterator(data); }
+    const_iterator end() const { return const_iterator(data + used); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t bytes() const { return used; } //Buffer size, allocated exactly
+    const char* raw() const { return data; }
+    static Listpack adopt(char* buffer, const size_t bytes, const size_t entries) //Takes a malloc'd buffer holding bytes of encoded entries, e.g. a decompressed one
+    {
+        Listpack lp;
+        lp.data = buffer;
+        lp.used = static_cast<uint32_t>(bytes);
+        lp.count = static_cast<uint32_t>(entries);
+        return lp;
+    }
+    static size_t entrySize(const size_t len) //Varint plus bytes
+    {
+        size_t header = 1;
+        for (size_t rest = len >> 7; rest; rest >>= 7) ++header;
+        return header + len;
+    }
+
+    std::string_view at(const size_t i) const { return *std::next(begin(), static_cast<std::ptrdiff_t>(i)); }
+    std::optional<size_t> find(const std::string_view v, const size_t step = 1) const //Index of the first entry equal to v among entries 0, step, 2*step..., step 2 looks only at hash fields
+    {
+        size_t i = 0;
+        for (auto it = begin(); it != end(); ++it, ++i)
+        {
+            if (i % step == 0 && *it == v) return i;
+        }
+        return std::nullopt;
+    }
+
+    void insert(const size_t i, const std::string_view v) { splice(offsetOf(i), 0, &v); ++count; }
+    void pushBack(const std::string_view v) { splice(used, 0, &v); ++count; }
+    void pushFront(const std::string_view v) { splice(0, 0, &v); ++count; }
+    void replace(const size_t i, const std::string_view v)
+    {
+        const size_t off = offsetOf(i);
+        splice(off, entryAt(off), &v);
+    }
+    void erase(const size_t i, const size_t n = 1) //Entries i to i + n - 1
+    {
+        const size_t off = offsetOf(i);
+        size_t cut = 0;
+        for (size_t j = 0; j < n; ++j) cut += entryAt(off + cut);
+        splice(off, cut, nullptr);
+        count -= static_cast<uint32_t>(n);
+    }
+
+private:
+    static const char* decode(const char* p, size_t& len) //Reads the varint length, returns where the bytes start
+    {
+        len = 0;
+        for (unsigned shift = 0;; shift += 7)
+        {
+            const auto byte = static_cast<unsigned char>(*p++);
+            len |= static_cast<size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return p;
+        }
+    }
+    size_t entryAt(const size_t off) const //Size of the entry starting at off
+    {
+        size_t len;
+        return static_cast<size_t>(decode(data + off, len) - (data + off)) + len;
+    }
+    size_t offsetOf(const size_t i) const
+    {
+        return static_cast<size_t>(std::next(begin(), static_cast<std::ptrdiff_t>(i)).pos - data);
+    }
+    void splice(const size_t off, const size_t cut, const std::string_view* v) //Replaces cut bytes at off with the entry for *v, or just drops them
+    {
+        const size_t add = v ? entrySize(v->size()) : 0;
+        const size_t newUsed = used - cut + add;
+        if (add > cut) resize(newUsed);
+        if (used - off - cut) std::memmove(data + off + add, data + off + cut, used - off - cut);
+        if (v)
+        {
+            char* p = data + off;
+            size_t len = v->size();
+            for (; len >= 0x80; len >>= 7) *p++ = static_cast<char>((len & 0x7F) | 0x80);
+            *p++ = static_cast<char>(len);
+            if (!v->empty()) std::memcpy(p, v->data(), v->size());
+        }
+        if (add < cut) resize(newUsed);
+        used = static_cast<uint32_t>(newUsed);
+    }
+    void resize(const size_t bytes) //Exact fit, no spare capacity to keep small collections small
+    {
+        if (bytes == 0)
+        {
+            std::free(data);
+            data = nullptr;
+            return;
+        }
+        void* grown = std::realloc(data, bytes);
+        if (!grown) throw std::bad_alloc();
+        data = static_cast<char*>(grown);
+    }
+
+    char* data = nullptr;
+    uint32_t used = 0; //Bytes
+    uint32_t count = 0; //Entries
+};
+static_assert(sizeof(Listpack) == 16);
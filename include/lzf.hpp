@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//LZF, the byte oriented LZ77 Redis uses for quicklist nodes, fast enough to run on every push that moves the compression boundary
+//A control byte below 32 starts a run of ctrl + 1 literals, otherwise its top 3 bits are the match length - 2 (7 means one more length byte)
+//and its low 5 bits with the next byte are the distance back - 1
+namespace lzf {
+    inline constexpr unsigned HASH_LOG = 12;
+    inline constexpr size_t MAX_LITERALS = 32;
+    inline constexpr size_t MAX_DISTANCE = 1 << 13;
+    inline constexpr size_t MAX_MATCH = 7 + 255 + 2;
+
+    inline size_t compress(const char* input, const size_t inLen, char* output, const size_t outLen) //Bytes written, 0 if it did not fit in outLen
+    {
+        const auto* in = reinterpret_cast<const unsigned char*>(input);
+        auto* op = reinterpret_cast<unsigned char*>(output);
+        const unsigned char* const end = in + inLen;
+        const unsigned char* const outEnd = op + outLen;
+        std::array<uint32_t, 1 << HASH_LOG> seen{}; //Last position + 1 of each 3 byte prefix hash
+
+        unsigned char* control = nullptr;
+        size_t literals = 0;
+        const auto literal = [&](const unsigned char byte)
+        {
+            if (literals == 0)
+            {
+                if (op >= outEnd) return false;
+                control = op++;
+            }
+            if (op >= outEnd) return false;
+            *op++ = byte;
+            if (++literals == MAX_LITERALS)
+            {
+                *control = static_cast<unsigned char>(literals - 1);
+                literals = 0;
+            }
+            return true;
+        };
+
+        const unsigned char* ip = in;
+        while (ip + 2 < end)
+        {
+            const uint32_t prefix = static_cast<uint32_t>(ip[0]) << 16 | static_cast<uint32_t>(ip[1]) << 8 | ip[2];
+            uint32_t& slot = seen[(prefix * 2654435761u) >> (32 - HASH_LOG)];
+            const unsigned char* ref = slot ? in + slot - 1 : nullptr;
+            slot = static_cast<uint32_t>(ip - in + 1);
+
+            const size_t distance = ref ? static_cast<size_t>(ip - ref) : 0;
+            if (!ref || distance > MAX_DISTANCE || std::memcmp(ref, ip, 3) != 0)
+            {
+                if (!literal(*ip++)) return 0;
+                continue;
+            }
+
+            size_t len = 3;
+            const size_t longest = std::min(static_cast<size_t>(end - ip), MAX_MATCH);
+            while (len < longest && ref[len] == ip[len]) ++len;
+
+            if (literals) *control = static_cast<unsigned char>(literals - 1);
+            literals = 0;
+            if (op + 3 > outEnd) return 0;
+            const size_t code = len - 2;
+            const size_t back = distance - 1;
+            if (code < 7) *op++ = static_cast<unsigned char>(code << 5 | back >> 8);
+            else
+            {
+                *op++ = static_cast<unsigned char>(7 << 5 | back >> 8);
+                *op++ = static_cast<unsigned char>(code - 7);
+            }
+            *op++ = static_cast<unsigned char>(back & 0xFF);
+            ip += len;
+        }
+        while (ip < end)
+        {
+            if (!literal(*ip++)) return 0;
+        }
+        if (literals) *control = static_cast<unsigned char>(literals - 1);
+        return static_cast<size_t>(op - reinterpret_cast<unsigned char*>(output));
+    }
+
+    inline size_t decompress(const char* input, const size_t inLen, char* output, const size_t outLen) //Bytes written, 0 on corrupt input or a short buffer
+    {
+        const auto* ip = reinterpret_cast<const unsigned char*>(input);
+        const unsigned char* const inEnd = ip + inLen;
+        auto* const out = reinterpret_cast<unsigned char*>(output);
+        unsigned char* op = out;
+        unsigned char* const outEnd = out + outLen;
+
+        while (ip < inEnd)
+        {
+            size_t control = *ip++;
+            if (control < 32)
+            {
+                const size_t run = control + 1;
+                if (static_cast<size_t>(inEnd - ip) < run || static_cast<size_t>(outEnd - op) < run) return 0;
+                std::memcpy(op, ip, run);
+                op += run;
+                ip += run;
+                continue;
+            }
+            size_t len = control >> 5;
+            if (len == 7)
+            {
+                if (ip >= inEnd) return 0;
+                len += *ip++;
+            }
+            if (ip >= inEnd) return 0;
+            const size_t distance = ((control & 0x1F) << 8) + *ip++ + 1;
+            len += 2;
+            if (distance > static_cast<size_t>(op - out) || static_cast<size_t>(outEnd - op) < len) return 0;
+            for (size_t i = 0; i < len; ++i) op[i] = op[static_cast<std::ptrdiff_t>(i) - static_cast<std::ptrdiff_t>(distance)]; //May overlap, byte by byte on purpose
+            op += len;
+        }
+        return static_cast<size_t>(op - out);
+    }
+}
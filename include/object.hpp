@@ -0,0 +1,432 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <boost/variant/get.hpp>
+
+#include "config.h"
+#include "intset.hpp"
+#include "listpack.hpp"
+#include "quicklist.hpp"
+#include "respvalue.hpp"
+
+enum class Encoding : uint8_t {EMBSTR, BOXED, INT, LISTPACK, INTSET, QUICKLIST}; //EMBSTR: short string inside the Object, BOXED: RESPValue on the heap, INT: int64 inside the Object, LISTPACK: small LIST/SET/HASH in one buffer, INTSET: SET of integers as a sorted array, QUICKLIST: big LIST as linked listpack nodes
+
+class alignas(8) Object { //Keyspace value, 24 bytes: one header word (type, encoding, eviction clock) then the value or a pointer to it
+public:
+    static constexpr size_t EMBSTR_MAX = 19; //Longest string kept inline
+
+    Object() { setInline({}); }
+    explicit Object(RESPValue value)
+    {
+        const bool plain = value.type == storeType::STR && boost::get<std::string>(&value.value);
+        if (plain && parseInteger(value.getStr())) setInt(*parseInteger(value.getStr()));
+        else if (plain && value.getStr().size() <= EMBSTR_MAX) setInline(value.getStr());
+        else if (auto ints = intsetOf(value)) setIntset(std::move(*ints));
+        else if (packable(value)) setListpack(value.type, pack(value));
+        else if (value.type == storeType::LIST) setQuicklist(quicklistOf(value));
+        else setBoxed(new RESPValue(std::move(value)));
+    }
+    static Object str(const std::string_view v) //STR value, INT when it reads as one, inline when short, shareable when large (RESPValue::makeStr)
+    {
+        if (auto n = parseInteger(v)) return integer(*n);
+        if (v.size() > EMBSTR_MAX) return Object(RESPValue::makeStr(std::string(v)));
+        Object obj;
+        obj.setInline(v);
+        return obj;
+    }
+    static Object integer(const long long n)
+    {
+        Object obj;
+        obj.setInt(n);
+        return obj;
+    }
+    static Object packed(const storeType type, const Encoding encoding = Encoding::LISTPACK) //Empty LIST/SET/HASH in a listpack (or SET in an intset), commands fill it and unpack() it once it outgrows the limits
+    {
+        Object obj;
+        if (encoding == Encoding::INTSET) obj.setIntset(Intset());
+        else obj.setListpack(type, Listpack());
+        return obj;
+    }
+    static std::optional<long long> parseInteger(const std::string_view v) //Only digits with an optional '-', no leading zeros or "-0", so it renders back to the same bytes
+    {
+        if (v.empty() || v.size() > 20) return std::nullopt;
+        const size_t first = v[0] == '-' ? 1 : 0;
+        if (first == v.size() || (v[first] == '0' && v.size() > 1)) return std::nullopt;
+        long long n = 0;
+        const auto [end, err] = std::from_chars(v.data(), v.data() + v.size(), n);
+        if (err != std::errc() || end != v.data() + v.size()) return std::nullopt;
+        return n;
+    }
+
+    Object(Object&& other) noexcept { take(other); }
+    Object& operator=(Object&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            take(other);
+        }
+        return *this;
+    }
+    Object(const Object&) = delete;
+    Object& operator=(const Object&) = delete;
+    ~Object() { release(); }
+
+    storeType type() const { return static_cast<storeType>(bits() & 0xF); }
+    Encoding encoding() const { return static_cast<Encoding>((bits() >> 4) & 0xF); }
+    uint32_t lruClock() const { return bits() >> 8; } //Eviction clock of the last access (LRU.hpp)
+    void touch(const uint32_t clock) const //Reads stamp under a shared lock so the word is stored atomically, type and encoding only change under an exclusive one
+    {
+        std::atomic_ref<uint32_t> word(header);
+        word.store((word.load(std::memory_order_relaxed) & 0xFFu) | clock << 8, std::memory_order_relaxed);
+    }
+
+    std::string str() const //STR payload whichever way it is stored, INT is rendered here
+    {
+        if (encoding() == Encoding::INT)
+        {
+            char digits[24];
+            const auto [end, err] = std::to_chars(digits, digits + sizeof(digits), intValue());
+            return std::string(digits, end);
+        }
+        return std::string(view());
+    }
+    std::shared_ptr<const std::string> sharedStr() const //Payload to pin in a reply, only shared ones of ZERO_COPY_MIN or more, null for the rest (written out instead)
+    {
+        if (encoding() != Encoding::BOXED) return nullptr;
+        auto shared = boxed()->sharedStr();
+        if (shared && shared->size() < ZERO_COPY_MIN) return nullptr; //Loaded from a snapshot that way, copying is cheaper
+        return shared;
+    }
+    template<class Fn> void readStr(Fn&& fn) const //fn(string_view) on the STR payload where it lies, INT is rendered on the stack
+    {
+        if (encoding() != Encoding::INT) return fn(view());
+        char digits[24];
+        const auto [end, err] = std::to_chars(digits, digits + sizeof(digits), intValue());
+        fn(std::string_view(digits, static_cast<size_t>(end - digits)));
+    }
+    std::optional<long long> toInt() const //STR as an int64, nullopt unless it is one written the canonical way
+    {
+        if (encoding() == Encoding::INT) return intValue();
+        return parseInteger(view());
+    }
+    void setInt(const long long n) //Keeps the eviction clock bits
+    {
+        release();
+        header = (header & ~0xFFu) | static_cast<uint32_t>(storeType::STR) | static_cast<uint32_t>(Encoding::INT) << 4;
+        std::memcpy(payload, &n, sizeof(n));
+    }
+    size_t append(const std::string_view v) //STR only, returns the new length
+    {
+        if (encoding() == Encoding::INT) //Appending makes it a plain string
+        {
+            const std::string digits = str();
+            if (digits.size() <= EMBSTR_MAX) setInline(digits);
+            else setBoxed(new RESPValue{storeType::STR, digits});
+        }
+        const size_t len = view().size() + v.size();
+        if (encoding() == Encoding::EMBSTR && len <= EMBSTR_MAX)
+        {
+            std::memcpy(payload + 1 + payload[0], v.data(), v.size());
+            payload[0] = static_cast<char>(len);
+            return len;
+        }
+        if (encoding() == Encoding::EMBSTR) setBoxed(new RESPValue{storeType::STR, std::string(view())});
+
+        RESPValue* value = boxed();
+        std::string& s = value->mutableStr();
+        s += v;
+        if (len >= ZERO_COPY_MIN && boost::get<std::string>(&value->value)) *value = RESPValue::makeStr(std::move(s)); //Grew big enough to share
+        return len;
+    }
+
+    template<class T> T& as() { return boost::get<T>(boxed()->value); } //Container of a boxed value, throws on the wrong type
+    template<class T> const T& as() const { return boost::get<T>(boxed()->value); }
+
+    //Packed payloads, callers check type() under the accessor they hold and branch on encoding(), debug builds assert it
+    Listpack& listpack()
+    {
+        assert(encoding() == Encoding::LISTPACK && "listpack() on another encoding");
+        return *std::launder(reinterpret_cast<Listpack*>(payload + HANDLE_AT));
+    }
+    const Listpack& listpack() const
+    {
+        assert(encoding() == Encoding::LISTPACK && "listpack() on another encoding");
+        return *std::launder(reinterpret_cast<const Listpack*>(payload + HANDLE_AT));
+    }
+    Intset& intset()
+    {
+        assert(type() == storeType::SET && encoding() == Encoding::INTSET && "intset() on another encoding");
+        return *std::launder(reinterpret_cast<Intset*>(payload + HANDLE_AT));
+    }
+    const Intset& intset() const
+    {
+        assert(type() == storeType::SET && encoding() == Encoding::INTSET && "intset() on another encoding");
+        return *std::launder(reinterpret_cast<const Intset*>(payload + HANDLE_AT));
+    }
+    Quicklist& quicklist() { return *quicklistPtr(); }
+    const Quicklist& quicklist() const { return *quicklistPtr(); }
+    void unpack() //LISTPACK or INTSET to the full container (a quicklist for a LIST), keeps the eviction clock bits
+    {
+        if (type() == storeType::LIST)
+        {
+            auto list = std::make_unique<Quicklist>();
+            for (const std::string_view i : listpack()) list->pushBack(i);
+            release();
+            setQuicklist(list.release());
+            return;
+        }
+        RESPValue* value = new RESPValue(unpacked());
+        release();
+        setBoxed(value);
+    }
+    static bool fitsListpack(const size_t entries, const size_t longest) //Entries counts hash fields, not field and value
+    {
+        return entries <= LISTPACK_MAX_ENTRIES && longest <= LISTPACK_MAX_VALUE;
+    }
+    void intsetToListpack() //For a non integer member while the set is still small, numbers are at most 20 bytes so they always fit
+    {
+        Listpack lp;
+        char digits[24];
+        for (size_t i = 0; i < intset().size(); ++i)
+        {
+            const auto [end, err] = std::to_chars(digits, digits + sizeof(digits), intset().at(i));
+            lp.pushBack({digits, static_cast<size_t>(end - digits)});
+        }
+        release();
+        setListpack(storeType::SET, std::move(lp));
+    }
+
+    size_t memoryUsage() const //Heap bytes the value owns beyond its 24 byte Object, O(1) except boxed sets and hashes which are walked (their commands count members instead)
+    {
+        switch (encoding())
+        {
+        case Encoding::LISTPACK: return listpack().bytes();
+        case Encoding::INTSET: return intset().bytes();
+        case Encoding::QUICKLIST: return quicklist().memoryUsage();
+        case Encoding::BOXED: break;
+        default: return 0;
+        }
+        const RESPValue& value = *boxed();
+        size_t bytes = sizeof(RESPValue);
+        if (const auto* shared = boost::get<SharedString>(&value.value)) return bytes + SHARED_BLOCK + heapBytes(*shared->data);
+        if (const auto* s = boost::get<std::string>(&value.value)) return bytes + heapBytes(*s);
+        if (const auto* set = boost::get<std::unordered_set<std::string>>(&value.value))
+        {
+            bytes += bucketBytes(set->bucket_count());
+            for (const auto& member : *set) bytes += entryBytes(member);
+            return bytes;
+        }
+        if (const auto* hash = boost::get<std::unordered_map<std::string, std::string>>(&value.value))
+        {
+            bytes += bucketBytes(hash->bucket_count());
+            for (const auto& field : *hash) bytes += entryBytes(field);
+            return bytes;
+        }
+        return bytes; //LISTs are quicklists, a deque is only ever a snapshot copy
+    }
+    static size_t heapBytes(const std::string& s) //0 while it fits the small string buffer inside the object
+    {
+        const auto* at = reinterpret_cast<const char*>(&s);
+        return s.data() >= at && s.data() < at + sizeof(s) ? 0 : s.capacity() + 1;
+    }
+    static size_t entryBytes(const std::string& member) { return NODE_LINKS + sizeof(std::string) + heapBytes(member); } //One unordered_set node
+    static size_t entryBytes(const std::pair<const std::string, std::string>& field) //One unordered_map node
+    {
+        return NODE_LINKS + sizeof(field) + heapBytes(field.first) + heapBytes(field.second);
+    }
+    static size_t bucketBytes(const size_t buckets) { return buckets * sizeof(void*); }
+
+    RESPValue toValue() const //Plain copy for snapshots, packed encodings are saved as the full container so the file format stays the same
+    {
+        if (encoding() == Encoding::LISTPACK || encoding() == Encoding::INTSET) return unpacked();
+        if (encoding() == Encoding::QUICKLIST)
+        {
+            std::deque<std::string> list;
+            quicklist().forEach([&list](std::string_view v) { list.emplace_back(v); });
+            return RESPValue{storeType::LIST, std::move(list)};
+        }
+        if (encoding() != Encoding::BOXED) return RESPValue{storeType::STR, str()};
+        return *boxed();
+    }
+
+private:
+    static constexpr size_t NODE_LINKS = 2 * sizeof(void*); //Next pointer and cached hash of a std::unordered_* node
+    static constexpr size_t SHARED_BLOCK = 2 * sizeof(void*) + sizeof(std::string); //make_shared control block holding the string
+    static constexpr size_t HANDLE_AT = 4; //Listpack, Intset or Quicklist* lives at object offset 8, pointer aligned
+
+    static Quicklist* quicklistOf(const RESPValue& value)
+    {
+        auto list = std::make_unique<Quicklist>();
+        for (const std::string& i : boost::get<std::deque<std::string>>(value.value)) list->pushBack(i);
+        return list.release();
+    }
+
+    static std::optional<Intset> intsetOf(const RESPValue& value) //Sets of only integers, written the canonical way, up to INTSET_MAX_ENTRIES
+    {
+        const auto* set = boost::get<std::unordered_set<std::string>>(&value.value);
+        if (!set || set->empty() || set->size() > INTSET_MAX_ENTRIES) return std::nullopt;
+        Intset ints;
+        for (const auto& i : *set)
+        {
+            const auto n = parseInteger(i);
+            if (!n) return std::nullopt;
+            ints.insert(*n);
+        }
+        return ints;
+    }
+
+    static bool packable(const RESPValue& value)
+    {
+        size_t longest = 0;
+        if (const auto* list = boost::get<std::deque<std::string>>(&value.value))
+        {
+            for (const auto& i : *list) longest = std::max(longest, i.size());
+            return fitsListpack(list->size(), longest);
+        }
+        if (const auto* set = boost::get<std::unordered_set<std::string>>(&value.value))
+        {
+            for (const auto& i : *set) longest = std::max(longest, i.size());
+            return fitsListpack(set->size(), longest);
+        }
+        if (const auto* hash = boost::get<std::unordered_map<std::string, std::string>>(&value.value))
+        {
+            for (const auto& [field, val] : *hash) longest = std::max({longest, field.size(), val.size()});
+            return fitsListpack(hash->size(), longest);
+        }
+        return false;
+    }
+    static Listpack pack(const RESPValue& value)
+    {
+        Listpack lp;
+        if (const auto* list = boost::get<std::deque<std::string>>(&value.value))
+        {
+            for (const auto& i : *list) lp.pushBack(i);
+        }
+        else if (const auto* set = boost::get<std::unordered_set<std::string>>(&value.value))
+        {
+            for (const auto& i : *set) lp.pushBack(i);
+        }
+        else for (const auto& [field, val] : boost::get<std::unordered_map<std::string, std::string>>(value.value))
+        {
+            lp.pushBack(field);
+            lp.pushBack(val);
+        }
+        return lp;
+    }
+    RESPValue unpacked() const
+    {
+        if (encoding() == Encoding::INTSET)
+        {
+            std::unordered_set<std::string> set;
+            set.reserve(intset().size());
+            for (size_t i = 0; i < intset().size(); ++i) set.emplace(std::to_string(intset().at(i)));
+            return RESPValue{storeType::SET, std::move(set)};
+        }
+        const Listpack& lp = listpack();
+        switch (type())
+        {
+        case storeType::LIST:
+            return RESPValue{storeType::LIST, std::deque<std::string>(lp.begin(), lp.end())};
+        case storeType::SET:
+        {
+            std::unordered_set<std::string> set;
+            set.reserve(lp.size());
+            for (const std::string_view i : lp) set.emplace(i);
+            return RESPValue{storeType::SET, std::move(set)};
+        }
+        default:
+        {
+            std::unordered_map<std::string, std::string> hash;
+            hash.reserve(lp.size() / 2);
+            for (auto it = lp.begin(); it != lp.end(); ++it)
+            {
+                const std::string_view field = *it;
+                hash.emplace(field, *++it);
+            }
+            return RESPValue{storeType::HASH, std::move(hash)};
+        }
+        }
+    }
+
+    std::string_view view() const //EMBSTR or BOXED payload
+    {
+        assert(type() == storeType::STR && "string payload of another type");
+        if (encoding() == Encoding::EMBSTR) return {payload + 1, static_cast<size_t>(payload[0])};
+        return boxed()->getStr();
+    }
+    long long intValue() const
+    {
+        long long n;
+        std::memcpy(&n, payload, sizeof(n)); //Payload is only 4 byte aligned
+        return n;
+    }
+    void setInline(const std::string_view v) //Keeps the eviction clock bits
+    {
+        header = (header & ~0xFFu) | static_cast<uint32_t>(storeType::STR) | static_cast<uint32_t>(Encoding::EMBSTR) << 4;
+        payload[0] = static_cast<char>(v.size());
+        if (!v.empty()) std::memcpy(payload + 1, v.data(), v.size());
+    }
+    void setListpack(const storeType type, Listpack&& lp) //Keeps the eviction clock bits
+    {
+        header = (header & ~0xFFu) | static_cast<uint32_t>(type) | static_cast<uint32_t>(Encoding::LISTPACK) << 4;
+        new (payload + HANDLE_AT) Listpack(std::move(lp));
+    }
+    void setIntset(Intset&& ints) //Keeps the eviction clock bits
+    {
+        header = (header & ~0xFFu) | static_cast<uint32_t>(storeType::SET) | static_cast<uint32_t>(Encoding::INTSET) << 4;
+        new (payload + HANDLE_AT) Intset(std::move(ints));
+    }
+    void setQuicklist(Quicklist* list) //Takes ownership, keeps the eviction clock bits
+    {
+        header = (header & ~0xFFu) | static_cast<uint32_t>(storeType::LIST) | static_cast<uint32_t>(Encoding::QUICKLIST) << 4;
+        std::memcpy(payload + HANDLE_AT, &list, sizeof(list));
+    }
+    Quicklist* quicklistPtr() const
+    {
+        assert(type() == storeType::LIST && encoding() == Encoding::QUICKLIST && "quicklist() on another encoding");
+        Quicklist* list;
+        std::memcpy(&list, payload + HANDLE_AT, sizeof(list));
+        return list;
+    }
+    void setBoxed(RESPValue* value) //Takes ownership, keeps the eviction clock bits
+    {
+        header = (header & ~0xFFu) | static_cast<uint32_t>(value->type) | static_cast<uint32_t>(Encoding::BOXED) << 4;
+        std::memcpy(payload, &value, sizeof(value));
+    }
+    RESPValue* boxed() const
+    {
+        RESPValue* value;
+        std::memcpy(&value, payload, sizeof(value)); //Payload is only 4 byte aligned
+        return value;
+    }
+    uint32_t bits() const { return std::atomic_ref<uint32_t>(header).load(std::memory_order_relaxed); } //Another reader may be touching it
+    void take(Object& other)
+    {
+        header = other.header;
+        std::memcpy(payload, other.payload, sizeof(payload)); //Handles and pointers move bitwise
+        other.setInline({});
+    }
+    void release()
+    {
+        if (encoding() == Encoding::BOXED) delete boxed();
+        else if (encoding() == Encoding::LISTPACK) listpack().~Listpack();
+        else if (encoding() == Encoding::INTSET) intset().~Intset();
+        else if (encoding() == Encoding::QUICKLIST) delete quicklistPtr();
+    }
+
+    mutable uint32_t header = 0; //Type in bits 0-3, encoding in 4-7, eviction clock in 8-31, mutable so reads can touch()
+    char payload[EMBSTR_MAX + 1]; //EMBSTR: length byte then the bytes, BOXED: RESPValue*, INT: int64, LISTPACK/INTSET/QUICKLIST: handle at HANDLE_AT
+};
+static_assert(sizeof(Object) == 24);
+static_assert(std::atomic_ref<uint32_t>::is_always_lock_free);
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <sys/uio.h>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "config.h"
+
+class OutputBuffer { //Per session reply queue of iovec segments, small replies coalesce and big values are pinned, not copied
+public:
+    OutputBuffer() = default;
+    OutputBuffer(std::string resp) { append(std::move(resp)); } //Implicit so cmd handlers can keep returning plain RESP strings
+    OutputBuffer(const char* resp) { append(std::string_view(resp)); }
+
+    void append(std::string_view bytes) //Copied into the tail chunk
+    {
+        if (bytes.empty()) return;
+        if (segments.empty() || segments.back().pinned || segments.back().owned.size() >= OUTPUT_CHUNK) segments.emplace_back();
+        segments.back().owned.append(bytes);
+        total += bytes.size();
+    }
+    void append(std::string&& bytes) //Large replies become their own segment without a copy
+    {
+        if (bytes.size() < ZERO_COPY_MIN) return append(std::string_view(bytes));
+        total += bytes.size();
+        segments.emplace_back(std::move(bytes));
+    }
+    void append(std::shared_ptr<const std::string> value) //Stored value kept alive until the socket took every byte
+    {
+        if (value->size() < ZERO_COPY_MIN) return append(std::string_view(*value));
+        total += value->size();
+        segments.emplace_back(std::move(value));
+    }
+    void append(OutputBuffer&& other)
+    {
+        for (auto& segment : other.segments)
+        {
+            if (segment.pinned || segment.owned.size() >= ZERO_COPY_MIN) segments.push_back(std::move(segment));
+            else
+            {
+                append(segment.view());
+                total -= segment.view().size(); //Counted again below
+            }
+        }
+        total += other.total;
+        other.clear();
+    }
+
+    bool empty() const { return total == 0; }
+    size_t size() const { return total; }
+
+    int fillIov(iovec* iov, const int max) const //Points at the front segments, valid until the next append or consume
+    {
+        int count = 0;
+        for (auto it = segments.begin(); it != segments.end() && count < max; ++it, ++count)
+        {
+            const std::string_view bytes = it->view();
+            iov[count].iov_base = const_cast<char*>(bytes.data());
+            iov[count].iov_len = bytes.size();
+        }
+        return count;
+    }
+    void consume(size_t bytes) //Drops what the socket accepted, a short write leaves the rest of the segment queued
+    {
+        total -= bytes;
+        while (bytes > 0)
+        {
+            Segment& front = segments.front();
+            const size_t left = front.view().size();
+            if (bytes < left)
+            {
+                front.offset += bytes;
+                return;
+            }
+            bytes -= left;
+            segments.pop_front();
+        }
+    }
+    void clear()
+    {
+        segments.clear();
+        total = 0;
+    }
+
+    std::string str() const //Flattened copy, for tests and logging
+    {
+        std::string ret;
+        ret.reserve(total);
+        for (const auto& segment : segments) ret += segment.view();
+        return ret;
+    }
+
+private:
+    struct Segment {
+        Segment() = default;
+        explicit Segment(std::string bytes) : owned(std::move(bytes)) {}
+        explicit Segment(std::shared_ptr<const std::string> value) : pinned(std::move(value)) {}
+
+        std::string owned;
+        std::shared_ptr<const std::string> pinned; //Set for zero copy values, owned is unused then
+        size_t offset = 0; //Bytes already sent from the front of this segment
+
+        std::string_view view() const
+        {
+            const std::string& bytes = pinned ? *pinned : owned;
+            return std::string_view(bytes).substr(offset);
+        }
+    };
+
+    std::deque<Segment> segments;
+    size_t total = 0;
+};
@@ -1,17 +1,58 @@
 #pragma once
 
-#include <vector>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class RESPParser { //Incremental RESP reader, kept in the Session so a split cmd resumes where it stopped
+public:
+    enum class Status {COMMAND, NEED_MORE, ERROR};
+
+    //Parses at most one cmd from input, consumed tells how many bytes may be dropped (also when more are needed)
+    //Args are views into input, valid until input is consumed or next() is called again, nothing is copied
+    //A partial cmd is not consumed, the caller hands the same bytes back with more appended
+    Status next(std::string_view input, size_t& consumed, std::vector<std::string_view>& command); //Binary safe, never throws
+    std::span<char> directTarget(); //Unfilled part of a large bulk being received, the loop may recv straight into it
+    void directFilled(size_t bytes);
+    const std::string& error() const { return errorMsg; }
+
+private:
+    enum class State {TYPE, ARRAY_LEN, BULK_LEN, BULK_BODY, BULK_CRLF, LINE};
+
+    bool readLine(std::string_view input, size_t& pos, std::string_view& line); //False until the CRLF arrived
+    bool finishElement(); //True once the whole cmd is in, null bulks count but are skipped
+    void spill(std::string_view input); //Large bulk ahead, copy what was parsed so far and consume as we go from here
+    Status complete(std::string_view input, size_t pos, size_t& consumed, std::vector<std::string_view>& command);
+    Status needMore(size_t pos, size_t& consumed);
+    Status lineMissing(std::string_view input, size_t pos, size_t& consumed);
+    Status fail(std::string msg);
+
+    State state = State::TYPE;
+    bool inArray = false;
+    char lineType = '+'; //Top level simple string, error or integer
+    long long arrayLeft = 0; //Elements of the current cmd still to come
+    long long bulkLen = 0;
+    size_t scanned = 0; //Bytes of the unconsumed cmd already parsed, next() resumes there
+    std::vector<std::pair<size_t, size_t>> spans; //Offset and length of each arg in input
 
-#include "respvalue.hpp"
+    bool spilled = false; //Set for cmds carrying a large bulk, args are owned and bytes consumed as they are parsed
+    size_t bulkFilled = 0; //Bytes of the current bulk received so far
+    std::string bulk; //Allocated at full size upfront for large bulks so they are received in place
+    std::vector<std::string> owned;
+    std::string errorMsg;
+};
 
-std::vector<std::vector<std::string>> parseRESPPipeline(const char* buffer, size_t len, size_t& offset); //Enables pipelining
-std::vector<std::string> parseRESP(const char* buffer, size_t len, size_t& offset); //Switch cases depending on RESP symbol
-std::vector<std::string> parseSimpleString(const char* buffer, size_t len, size_t& offset); //+
-std::vector<std::string> parseError(const char* buffer, size_t len, size_t& offset); //-ERR
-std::vector<std::string> parseInteger(const char* buffer, size_t len, size_t& offset); //:
-std::vector<std::string> parseBulkString(const char* buffer, size_t len, size_t& offset); //$
-std::vector<std::string> parseArray(const char* buffer, size_t len, size_t& offset); //*
+inline std::vector<std::string_view> viewOf(const std::vector<std::string>& parts) //Views over an owned cmd, e.g. one queued by MULTI
+{
+    return {parts.begin(), parts.end()};
+}
+inline std::vector<std::string> materialize(const std::vector<std::string_view>& parts) //Owned copy for cmds that outlive the receive buffer
+{
+    return {parts.begin(), parts.end()};
+}
 
 std::string parseCommandToRESP(const std::string& command); //Only used in client.cpp for CLI to RESP
-int intParser(const std::string& line); //RESP int to int
\ No newline at end of file
+int intParser(const std::string& line); //RESP int to int
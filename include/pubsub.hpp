@@ -4,19 +4,20 @@
 #include <unordered_map>
 #include <vector>
 #include <mutex>
-#include <sys/socket.h>
 
-class PubSub {
+struct Session;
+
+class PubSub { //Messages are posted to each subscriber's own loop, which queues them behind its replies
 public:
-    int subscribe(const std::string& channel, int sock);
+    int subscribe(const std::string& channel, Session* session);
     int publish(const std::string& channel, const std::string& message);
-    int unsubscribe(const std::string& channel, int sock);
-    void unsubscribeAll(int sock);
+    int unsubscribe(const std::string& channel, Session* session);
+    void unsubscribeAll(Session* session); //Before the session's loop drops what is still posted to it
 
 private:
-    std::unordered_map<std::string, std::vector<int>> channels; //Holds all socks subbed
-    std::unordered_map<int, std::vector<std::string>> users; //Holds all channels subbed to (For tracking sub count per user)
-    std::mutex mtx;
+    std::unordered_map<std::string, std::vector<Session*>> channels; //Holds all sessions subbed
+    std::unordered_map<Session*, std::vector<std::string>> users; //Holds all channels subbed to (For tracking sub count per user)
+    std::mutex mtx; //Also held while posting, so nothing reaches a session after unsubscribeAll
 
     static std::string formatMessage(const std::string& channel, const std::string& message); //Used for pubing
 };
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config.h"
+#include "listpack.hpp"
+#include "lzf.hpp"
+
+class Quicklist { //Big LIST as a doubly linked list of listpack nodes up to nodeBytes each, nodes deeper than compressDepth from both ends are LZF compressed
+public:
+    explicit Quicklist(const size_t nodeBytes = QUICKLIST_NODE_BYTES, const unsigned compressDepth = QUICKLIST_COMPRESS_DEPTH)
+        : nodeBytes(nodeBytes), depth(compressDepth) {}
+    Quicklist(const Quicklist&) = delete;
+    Quicklist& operator=(const Quicklist&) = delete;
+    ~Quicklist()
+    {
+        while (head)
+        {
+            Node* next = head->next;
+            destroy(head);
+            head = next;
+        }
+    }
+
+    size_t size() const { return count; }
+    size_t nodeCount() const { return nodes; }
+    size_t memoryUsage() const { return sizeof(Quicklist) + bytes; } //Kept as nodes change, no walk
+    size_t compressedNodes() const
+    {
+        size_t compressed = 0;
+        for (const Node* n = head; n; n = n->next) compressed += n->lzf != nullptr;
+        return compressed;
+    }
+
+    void pushFront(const std::string_view v)
+    {
+        if (!fits(head, v)) link(nullptr, head);
+        head->lp.pushFront(v);
+        bytes += Listpack::entrySize(v.size());
+        ++head->count;
+        ++count;
+        compressEnds();
+    }
+    void pushBack(const std::string_view v)
+    {
+        if (!fits(tail, v)) link(tail, nullptr);
+        tail->lp.pushBack(v);
+        bytes += Listpack::entrySize(v.size());
+        ++tail->count;
+        ++count;
+        compressEnds();
+    }
+    std::optional<std::string> popFront()
+    {
+        if (!head) return std::nullopt;
+        open(*head);
+        std::string ret(head->lp.at(0));
+        head->lp.erase(0);
+        bytes -= Listpack::entrySize(ret.size());
+        if (--head->count == 0) unlink(head);
+        --count;
+        compressEnds();
+        return ret;
+    }
+    std::optional<std::string> popBack()
+    {
+        if (!tail) return std::nullopt;
+        open(*tail);
+        std::string ret(tail->lp.at(tail->count - 1));
+        tail->lp.erase(tail->count - 1);
+        bytes -= Listpack::entrySize(ret.size());
+        if (--tail->count == 0) unlink(tail);
+        --count;
+        compressEnds();
+        return ret;
+    }
+
+    std::optional<std::string> at(const size_t i) const
+    {
+        if (i >= count) return std::nullopt;
+        const Position at = locate(i);
+        if (!at.node->lzf) return std::string(at.node->lp.at(at.offset));
+        return std::string(inflate(*at.node).at(at.offset));
+    }
+    bool set(const size_t i, const std::string_view v)
+    {
+        if (i >= count) return false;
+        const Position at = locate(i);
+        open(*at.node);
+        const size_t before = at.node->lp.bytes();
+        at.node->lp.replace(at.offset, v);
+        bytes = bytes + at.node->lp.bytes() - before;
+        if (isInterior(at.index)) compress(*at.node);
+        return true;
+    }
+    size_t remove(const std::string_view v, const long long limit) //LREM: limit > 0 from the head, < 0 from the tail, 0 every match
+    {
+        const size_t wanted = limit == 0 ? std::numeric_limits<size_t>::max() : static_cast<size_t>(limit < 0 ? -limit : limit);
+        size_t removed = 0;
+        for (Node* n = limit < 0 ? tail : head; n && removed < wanted;)
+        {
+            Node* following = limit < 0 ? n->prev : n->next;
+            if (n->lzf && !inflate(*n).find(v)) //Nothing here, leave it compressed
+            {
+                n = following;
+                continue;
+            }
+            open(*n);
+            const size_t before = n->lp.bytes();
+            removed += removeIn(*n, v, wanted - removed, limit >= 0);
+            bytes -= before - n->lp.bytes();
+            if (n->count == 0) unlink(n);
+            n = following;
+        }
+        count -= removed;
+        if (removed) compressAll();
+        return removed;
+    }
+
+    template<class Fn> void forRange(const size_t start, const size_t stop, Fn&& fn) const //fn(string_view) on entries start to stop, nodes before start are skipped by their counts
+    {
+        if (start > stop || stop >= count) return;
+        Position at = locate(start);
+        size_t left = stop - start + 1;
+        for (const Node* n = at.node; n && left; n = n->next, at.offset = 0)
+        {
+            Listpack scratch;
+            if (n->lzf) scratch = inflate(*n);
+            const Listpack& lp = n->lzf ? scratch : n->lp;
+            for (auto it = std::next(lp.begin(), static_cast<std::ptrdiff_t>(at.offset)); it != lp.end() && left; ++it, --left) fn(*it);
+        }
+    }
+    template<class Fn> void forEach(Fn&& fn) const
+    {
+        if (count) forRange(0, count - 1, fn);
+    }
+
+private:
+    static constexpr size_t MIN_COMPRESS_BYTES = 48; //Smaller nodes are not worth it
+    static constexpr size_t MIN_SAVING = 8; //Nor is compression that saves less than this
+
+    struct Node {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        Listpack lp; //Empty while compressed
+        char* lzf = nullptr; //Compressed listpack bytes
+        uint32_t lzfBytes = 0;
+        uint32_t rawBytes = 0;
+        uint32_t count = 0; //Entries, kept while compressed so lookups can skip the node
+    };
+    struct Position {
+        Node* node;
+        size_t offset; //Entry inside the node
+        size_t index; //Of the node from the head
+    };
+
+    bool fits(const Node* n, const std::string_view v) const
+    {
+        return n && !n->lzf && n->lp.bytes() + Listpack::entrySize(v.size()) <= nodeBytes;
+    }
+    bool isInterior(const size_t index) const { return depth && index >= depth && index + depth < nodes; }
+
+    Position locate(size_t i) const //Walks from the nearer end, whole nodes at a time
+    {
+        if (i < count / 2)
+        {
+            size_t index = 0;
+            Node* n = head;
+            for (; i >= n->count; n = n->next, ++index) i -= n->count;
+            return {n, i, index};
+        }
+        size_t fromEnd = count - 1 - i;
+        size_t index = nodes - 1;
+        Node* n = tail;
+        for (; fromEnd >= n->count; n = n->prev, --index) fromEnd -= n->count;
+        return {n, n->count - 1 - fromEnd, index};
+    }
+
+    void link(Node* after, Node* before) //New empty node between the two, either may be null at an end
+    {
+        Node* n = new Node;
+        n->prev = after;
+        n->next = before;
+        (after ? after->next : head) = n;
+        (before ? before->prev : tail) = n;
+        ++nodes;
+        bytes += sizeof(Node);
+    }
+    void unlink(Node* n)
+    {
+        (n->prev ? n->prev->next : head) = n->next;
+        (n->next ? n->next->prev : tail) = n->prev;
+        bytes -= sizeof(Node) + (n->lzf ? n->lzfBytes : n->lp.bytes());
+        destroy(n);
+        --nodes;
+    }
+    static void destroy(Node* n)
+    {
+        std::free(n->lzf);
+        delete n;
+    }
+
+    static size_t removeIn(Node& n, const std::string_view v, const size_t wanted, const bool fromHead) //Up to wanted matches from one side of a raw node
+    {
+        std::vector<size_t> hits;
+        size_t i = 0;
+        for (auto it = n.lp.begin(); it != n.lp.end(); ++it, ++i)
+        {
+            if (*it == v) hits.push_back(i);
+        }
+        if (hits.size() > wanted)
+        {
+            if (fromHead) hits.resize(wanted);
+            else hits.erase(hits.begin(), hits.end() - static_cast<std::ptrdiff_t>(wanted));
+        }
+        for (auto j = hits.rbegin(); j != hits.rend(); ++j) n.lp.erase(*j); //Back to front so the indexes stay valid
+        n.count -= static_cast<uint32_t>(hits.size());
+        return hits.size();
+    }
+
+    static Listpack inflate(const Node& n) //Decompressed copy, for readers that must not change the node
+    {
+        char* raw = static_cast<char*>(std::malloc(n.rawBytes));
+        if (!raw) throw std::bad_alloc();
+        lzf::decompress(n.lzf, n.lzfBytes, raw, n.rawBytes);
+        return Listpack::adopt(raw, n.rawBytes, n.count);
+    }
+    void open(Node& n) //Decompresses in place
+    {
+        if (!n.lzf) return;
+        n.lp = inflate(n);
+        bytes = bytes + n.rawBytes - n.lzfBytes;
+        std::free(n.lzf);
+        n.lzf = nullptr;
+    }
+    void compress(Node& n)
+    {
+        if (!depth || n.lzf || n.lp.bytes() < MIN_COMPRESS_BYTES) return;
+        char* out = static_cast<char*>(std::malloc(n.lp.bytes()));
+        if (!out) throw std::bad_alloc();
+        const size_t packed = lzf::compress(n.lp.raw(), n.lp.bytes(), out, n.lp.bytes() - MIN_SAVING);
+        if (!packed)
+        {
+            std::free(out);
+            return;
+        }
+        if (char* shrunk = static_cast<char*>(std::realloc(out, packed))) out = shrunk;
+        n.lzf = out;
+        n.lzfBytes = static_cast<uint32_t>(packed);
+        n.rawBytes = static_cast<uint32_t>(n.lp.bytes());
+        bytes -= n.rawBytes - packed;
+        n.lp = Listpack();
+    }
+    void compressEnds() //Pushes and pops only move the boundary: the depth nodes at each end are raw, the next one in gets compressed
+    {
+        if (!depth) return;
+        Node* front = head;
+        Node* back = tail;
+        for (unsigned i = 0; i < depth && front; ++i, front = front->next, back = back->prev)
+        {
+            open(*front);
+            open(*back);
+        }
+        if (nodes > 2 * static_cast<size_t>(depth))
+        {
+            compress(*front);
+            compress(*back);
+        }
+    }
+    void compressAll() //After changes anywhere in the list
+    {
+        if (!depth) return;
+        size_t index = 0;
+        for (Node* n = head; n; n = n->next, ++index)
+        {
+            if (isInterior(index)) compress(*n);
+            else open(*n);
+        }
+    }
+
+    Node* head = nullptr;
+    Node* tail = nullptr;
+    size_t count = 0; //Entries
+    size_t nodes = 0;
+    size_t bytes = 0; //Nodes and their raw or compressed listpacks
+    size_t nodeBytes;
+    unsigned depth;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+#include "config.h"
+
+class RecvBuffer { //Per session receive buffer, parsed in place and compacted only when the free tail runs short
+public:
+    char* prepare(const size_t minFree) //Writable tail of at least minFree bytes, recv straight into it then commit()
+    {
+        if (capacity - tail >= minFree) return data.get() + tail;
+
+        const size_t used = tail - head;
+        if (head >= used && capacity - used >= minFree) //Moving the leftover costs less than what was already consumed
+        {
+            std::memmove(data.get(), data.get() + head, used);
+        }
+        else
+        {
+            const size_t grown = std::max(capacity * 2, used + minFree);
+            auto bigger = std::make_unique_for_overwrite<char[]>(grown);
+            if (used > 0) std::memcpy(bigger.get(), data.get() + head, used);
+            data = std::move(bigger);
+            capacity = grown;
+        }
+        head = 0;
+        tail = used;
+        return data.get() + tail;
+    }
+    size_t writable() const { return capacity - tail; }
+    void commit(const size_t bytes) { tail += bytes; }
+    void append(const char* bytes, const size_t len) //For loops that can't pick the recv target (io_uring provided buffers)
+    {
+        std::memcpy(prepare(len), bytes, len);
+        commit(len);
+    }
+
+    std::string_view readable() const { return {data.get() + head, tail - head}; }
+    void consume(const size_t bytes)
+    {
+        head += bytes;
+        if (head != tail) return;
+        head = tail = 0; //Drained, next recv starts at the front for free
+        if (capacity > RECV_KEEP)
+        {
+            data.reset(); //Give back what a huge value needed
+            capacity = 0;
+        }
+    }
+    bool empty() const { return head == tail; }
+    size_t size() const { return tail - head; }
+
+private:
+    std::unique_ptr<char[]> data;
+    size_t capacity = 0;
+    size_t head = 0; //First unparsed byte
+    size_t tail = 0; //End of received bytes
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config.h"
+#include "outputbuffer.hpp"
+
+//Fixed replies, short enough to stay in SSO when copied out
+inline constexpr std::string_view RESP_OK = "+OK\r\n";
+inline constexpr std::string_view RESP_ZERO = ":0\r\n";
+inline constexpr std::string_view RESP_ONE = ":1\r\n";
+inline constexpr std::string_view RESP_NIL = "$-1\r\n";
+inline constexpr std::string_view RESP_PONG = "+PONG\r\n";
+inline constexpr std::string_view RESP_QUEUED = "+QUEUED\r\n";
+inline constexpr std::string_view RESP_WRONG_TYPE = "-ERR wrong type\r\n";
+
+class ReplyWriter { //Builds one RESP reply in a single buffer, numbers go through to_chars instead of std::format
+public:
+    ReplyWriter() = default;
+    explicit ReplyWriter(OutputBuffer& sink) : sink(&sink) {} //Streams: every OUTPUT_CHUNK written moves on to sink, flush() hands over the rest
+
+    ReplyWriter& raw(const std::string_view bytes)
+    {
+        buf += bytes;
+        return *this;
+    }
+    ReplyWriter& simple(const std::string_view text)
+    {
+        buf += '+';
+        buf += text;
+        buf += "\r\n";
+        return *this;
+    }
+    ReplyWriter& integer(const long long value)
+    {
+        buf += ':';
+        number(value);
+        buf += "\r\n";
+        return *this;
+    }
+    ReplyWriter& arrayHeader(const size_t count)
+    {
+        buf += '*';
+        number(static_cast<long long>(count));
+        buf += "\r\n";
+        return *this;
+    }
+    ReplyWriter& bulkHeader(const size_t len) //For values appended separately, e.g. pinned ones
+    {
+        buf += '$';
+        number(static_cast<long long>(len));
+        buf += "\r\n";
+        return *this;
+    }
+    ReplyWriter& bulk(const std::string_view value)
+    {
+        buf.reserve(buf.size() + value.size() + 16);
+        bulkHeader(value.size());
+        buf += value;
+        buf += "\r\n";
+        if (sink && buf.size() >= OUTPUT_CHUNK) flush(); //Bounded pieces, a long reply is never one big string
+        return *this;
+    }
+    ReplyWriter& bulkOrNil(const std::optional<std::string>& value)
+    {
+        return value ? bulk(std::string_view(*value)) : raw(RESP_NIL);
+    }
+    ReplyWriter& array(const std::vector<std::optional<std::string>>& values) //Header once, one reserve for the whole reply
+    {
+        size_t total = 16;
+        for (const auto& value : values) total += value ? value->size() + 16 : RESP_NIL.size();
+        buf.reserve(buf.size() + total);
+
+        arrayHeader(values.size());
+        for (const auto& value : values) bulkOrNil(value);
+        return *this;
+    }
+
+    size_t size() const { return buf.size(); }
+    std::string take() { return std::move(buf); }
+    void flush() //Queued as its own segment when a whole chunk, without a copy
+    {
+        if (!sink || buf.empty()) return;
+        sink->append(std::move(buf));
+        buf.clear();
+    }
+
+private:
+    void number(const long long value)
+    {
+        char digits[24];
+        const auto [end, err] = std::to_chars(digits, digits + sizeof(digits), value);
+        buf.append(digits, end);
+    }
+
+    std::string buf;
+    OutputBuffer* sink = nullptr;
+};
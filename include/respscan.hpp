@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+//Hot loop helpers for the RESP parser, every header line goes through both
+
+namespace respscan
+{
+    inline size_t findCRLFScalar(const char* data, const size_t len, size_t from)
+    {
+        while (from + 1 < len)
+        {
+            const void* cr = std::memchr(data + from, '\r', len - from - 1);
+            if (!cr) return std::string_view::npos;
+            from = static_cast<const char*>(cr) - data;
+            if (data[from + 1] == '\n') return from;
+            ++from;
+        }
+        return std::string_view::npos;
+    }
+
+#if defined(__x86_64__)
+    inline size_t findCRLFSSE2(const char* data, const size_t len, size_t from) //SSE2 is always there on x86-64
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        for (; from + 17 <= len; from += 16) //Second load is one byte ahead so a CRLF across blocks is still seen
+        {
+            const __m128i here = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from));
+            const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + from + 1));
+            const int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(here, cr), _mm_cmpeq_epi8(next, lf)));
+            if (mask) return from + __builtin_ctz(mask);
+        }
+        return findCRLFScalar(data, len, from);
+    }
+
+    __attribute__((target("avx2"))) inline size_t findCRLFAVX2(const char* data, const size_t len, size_t from)
+    {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        for (; from + 33 <= len; from += 32)
+        {
+            const __m256i here = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from));
+            const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + from + 1));
+            const unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(here, cr), _mm256_cmpeq_epi8(next, lf)));
+            if (mask) return from + __builtin_ctz(mask);
+        }
+        return findCRLFSSE2(data, len, from);
+    }
+#endif
+
+    inline size_t findCRLF(const std::string_view input, const size_t from) //Position of the next "\r\n" at or after from, npos if none yet
+    {
+        if (from >= input.size()) return std::string_view::npos;
+#if defined(__x86_64__)
+        static const bool avx2 = __builtin_cpu_supports("avx2"); //Checked once, the build doesn't assume the host CPU
+        return avx2 ? findCRLFAVX2(input.data(), input.size(), from) : findCRLFSSE2(input.data(), input.size(), from);
+#else
+        return findCRLFScalar(input.data(), input.size(), from);
+#endif
+    }
+
+    inline bool parseInt(const std::string_view text, long long& out) //RESP header number, whole text must be digits with an optional '-'
+    {
+        const char* it = text.data();
+        const char* end = it + text.size();
+        const bool negative = it != end && *it == '-';
+        it += negative;
+        if (it == end || end - it > 18) return false; //18 digits never overflow, far above any protocol limit
+
+        unsigned long long value = 0;
+        unsigned bad = 0;
+        for (; it != end; ++it)
+        {
+            const unsigned digit = static_cast<unsigned char>(*it) - '0';
+            bad |= digit > 9; //One branch at the end instead of one per byte
+            value = value * 10 + digit;
+        }
+        if (bad) return false;
+        out = negative ? -static_cast<long long>(value) : static_cast<long long>(value);
+        return true;
+    }
+}
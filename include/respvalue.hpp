@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <deque>
+#include <memory>
 #include <variant>
 #include <unordered_set>
 #include <unordered_map>
@@ -11,6 +13,9 @@
 #include <boost/serialization/unordered_set.hpp>
 #include <boost/serialization/deque.hpp>
 #include <boost/serialization/string.hpp>
+#include <boost/serialization/split_member.hpp>
+
+#include "config.h"
 
 enum class storeType {STR, LIST, SET, HASH};
 
@@ -19,6 +24,24 @@ template<class Archive> void serialize(Archive& ar, storeType& t, const unsigned
     ar & reinterpret_cast<int&>(t);
 }
 
+struct SharedString //Large STR payload, replies pin it instead of copying the bytes
+{
+    std::shared_ptr<std::string> data;
+
+private:
+    friend class boost::serialization::access;
+    template<class Archive> void save(Archive& ar, const unsigned) const //Same on disk as a plain string
+    {
+        ar & *data;
+    }
+    template<class Archive> void load(Archive& ar, const unsigned)
+    {
+        data = std::make_shared<std::string>();
+        ar & *data;
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+};
+
 struct RESPValue
 {
     storeType type; //For type checking or switch casing
@@ -26,7 +49,32 @@ struct RESPValue
         std::string,
         std::deque<std::string>,
         std::unordered_set<std::string>,
-        std::unordered_map<std::string, std::string>> value; //Uses boost for serialization
+        std::unordered_map<std::string, std::string>,
+        SharedString> value; //Uses boost for serialization, new alternatives go last to keep old snapshots loadable
+
+    static RESPValue makeStr(std::string v) //STR value, large ones are stored shareable
+    {
+        if (v.size() < ZERO_COPY_MIN) return RESPValue{storeType::STR, std::move(v)};
+        return RESPValue{storeType::STR, SharedString{std::make_shared<std::string>(std::move(v))}};
+    }
+    const std::string& getStr() const //STR payload whichever way it is stored
+    {
+        if (const auto* shared = boost::get<SharedString>(&value)) return *shared->data;
+        return boost::get<std::string>(value);
+    }
+    std::string& mutableStr() //Copy on write, a pinned value may still be in some socket's send queue
+    {
+        auto* shared = boost::get<SharedString>(&value);
+        if (!shared) return boost::get<std::string>(value);
+        if (shared->data.use_count() > 1) shared->data = std::make_shared<std::string>(*shared->data);
+        else std::atomic_thread_fence(std::memory_order_acquire); //Pairs with the last reader's release of its reference
+        return *shared->data;
+    }
+    std::shared_ptr<const std::string> sharedStr() const //Reference to a shareable payload, null for a plain string
+    {
+        if (const auto* shared = boost::get<SharedString>(&value)) return shared->data;
+        return nullptr;
+    }
 
 private:
     friend class boost::serialization::access;
@@ -1,33 +1,53 @@
 #pragma once
 
 #include <netinet/in.h>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
-#include <boost/asio/thread_pool.hpp>
 
 #include "config.h"
 #include "kvstore.hpp"
 #include "session.hpp"
 #include "pubsub.hpp"
+#include "eventloop.hpp"
+#include "shard.hpp"
 
 class Server {
 public:
-	explicit Server();
+	explicit Server(IOBackend backend = IOBackend::EPOLL, int shardCount = 0); //0 shards: pooled loops over one shared store
 	~Server();
 
-	void start(); //Sets up server loop for connection acceptance
+	void start(); //Spawns the event loops and blocks until they stop
 	void stop(); //Called by main to signal graceful shutdown
-	void handleCommunication(int clientSock, sockaddr_in clientAddress); //Handles accepted connection for REQ/RES loop
-	std::string handleCommand(const std::vector<std::string>& command, Session* session); //Individual cmd handling, returns RESP
+	void processInput(Session* session); //Handles every complete cmd in the session read buffer, replies go to its write buffer
+	void onDisconnect(Session* session); //Cleans up server side state tied to the session
+	OutputBuffer handleCommand(const std::vector<std::string_view>& command, Session* session, KVStore& store); //Individual cmd handling, returns RESP (session is null when run on a key's owner shard)
 
 private:
-	int sock;
+	int openListener(bool reusePort) const; //SO_REUSEPORT lets every shard bind its own
+
+	//Shared-nothing routing, replies for cmds owned by other shards come back through the session's reply queue
+	void dispatch(const std::vector<std::string_view>& command, Session* session); //Args may point into the read buffer, copied before they leave the loop
+	int shardOf(std::string_view key) const;
+	void reply(Session* session, OutputBuffer resp);
+	std::shared_ptr<PendingReply> reserveReply(Session* session);
+	void completeReply(const std::shared_ptr<PendingReply>& slot, OutputBuffer resp);
+	template<class Work, class Done> void submitTo(int origin, int owner, Work work, Done done); //Runs work on owner's store, done back on origin
+
+	int sock = -1;
 	int servPort = PORT_NUM;
 	std::string hostIP = HOST_IP;
 
-	bool running = true;
-	boost::asio::thread_pool pool; //TODO maybe convert to use epoll like redis
+	std::atomic<bool> running = true;
+	IOBackend ioBackend; //Runtime switch between epoll and io_uring loops
+	std::vector<std::unique_ptr<EventLoop>> loops; //Reactors sharing the listen sock
+	std::vector<std::thread> loopThreads;
+	int shardCount;
+	std::vector<std::unique_ptr<Shard>> shards; //Shared-nothing mode, one per core with its own listener and keys
 
 	PubSub pubsubManager;
-	KVStore kvstore;
+	std::unique_ptr<KVStore> kvstore; //Pooled mode only
 };
@@ -1,18 +1,46 @@
 #pragma once
+#include <deque>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "outputbuffer.hpp"
+#include "parser.hpp"
+#include "recvbuffer.hpp"
+
+class EventLoop;
+struct Session;
+
+struct PendingReply { //Reply slot for a cmd answered by another shard, filled on the session's own loop thread
+    Session* session; //Nulled if the session closes before the reply arrives
+    OutputBuffer reply{};
+    bool ready = false;
+};
 
 struct Session {
+    Session(const int sock, std::string address, EventLoop* owner) : clientSock(sock), clientAddress(std::move(address)), loop(owner) {}
+
     //Basic client info
-    int clientSock;
+    int clientSock = -1;
     std::string clientAddress;
+    EventLoop* loop = nullptr; //Loop (and in shared-nothing mode shard) the session lives on
+
+    //Owned IO buffers, only touched by the event loop the session lives on
+    RecvBuffer readBuffer; //Received bytes not yet parsed
+    RESPParser parser; //Where the partially received cmd left off
+    OutputBuffer writeBuffer; //Replies not yet accepted by the socket, sent with one sendmsg per batch of segments
 
-    //For handling partially received cmds
-    std::string partialCommand;
+    //Replies waiting on other shards, later replies queue behind them to keep pipeline order
+    std::deque<std::shared_ptr<PendingReply>> pendingReplies;
 
     //Transaction necessities
     bool transActive = false;
     std::vector<std::vector<std::string>> transQueue;
 
     //TODO Authentication here in future
+
+    ~Session()
+    {
+        for (const auto& pending : pendingReplies) pending->session = nullptr;
+    }
 };
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "eventloop.hpp"
+#include "kvstore.hpp"
+#include "session.hpp"
+#include "spscqueue.hpp"
+
+class Server;
+
+using ShardTask = std::function<void()>; //Runs on the receiving shard's loop thread
+
+class Shard { //One core in shared-nothing mode, owns a listener, an event loop and a partition of the keyspace
+public:
+    Shard(Server& server, int id, int shardCount, IOBackend backend, int listenSock);
+    ~Shard();
+
+    void start(std::vector<std::unique_ptr<Shard>>& all); //Spawns the loop thread pinned to core id
+    void stop();
+    void join();
+    void closeLoop(); //Closes remaining sessions while every shard is still alive
+
+    void send(int to, ShardTask task); //Own loop thread only, queues task for shard to
+    void markDirty(Session* session); //Write buffer filled by a cross shard reply, flushed after the current drain
+    void forget(Session* session); //Session is closing
+
+    KVStore& store() { return kvstore; }
+    int id() const { return shardId; }
+
+private:
+    void drain(); //Wake handler, runs every queued task then flushes dirty sessions
+    void retryBacklog();
+
+    const int shardId;
+    int listenSock;
+    KVStore kvstore; //Only this shard's keys, the map is no longer shared by every thread
+    std::vector<std::unique_ptr<Shard>>* peers = nullptr;
+
+    std::vector<std::unique_ptr<SPSCQueue<ShardTask>>> inbox; //Indexed by sending shard
+    std::vector<std::deque<ShardTask>> backlog; //Indexed by receiving shard, tasks that found its inbox full
+    std::atomic<bool> wakePending{false}; //Coalesces eventfd writes from every sender
+    std::atomic<bool> hasBacklog{false}; //Receivers wake us once they free up room
+
+    std::unordered_set<Session*> dirty;
+    std::unique_ptr<EventLoop> loop;
+    std::thread thread;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "config.h"
+
+class Slab { //Size classed chunks carved from big pages, not thread safe, each dict stripe owns one and uses it under its lock
+public:
+    static constexpr size_t ALIGN = 8; //Chunk sizes step by this, so a chunk wastes at most 7 bytes
+
+    void* allocate(const size_t bytes)
+    {
+        if (bytes > SLAB_MAX_CHUNK)
+        {
+            used += bytes;
+            large += bytes;
+            return ::operator new(bytes);
+        }
+        const size_t cls = classOf(bytes);
+        used += sizeOf(cls);
+        if (void* chunk = freeLists[cls])
+        {
+            freeLists[cls] = *static_cast<void**>(chunk);
+            return chunk;
+        }
+        if (pageLeft < sizeOf(cls)) //Tail too small for this class is left unused
+        {
+            pages.push_back(std::make_unique_for_overwrite<std::byte[]>(SLAB_PAGE));
+            cursor = pages.back().get();
+            pageLeft = SLAB_PAGE;
+        }
+        void* chunk = cursor;
+        cursor += sizeOf(cls);
+        pageLeft -= sizeOf(cls);
+        return chunk;
+    }
+
+    void deallocate(void* chunk, const size_t bytes) //bytes as passed to allocate
+    {
+        if (bytes > SLAB_MAX_CHUNK)
+        {
+            used -= bytes;
+            large -= bytes;
+            ::operator delete(chunk);
+            return;
+        }
+        const size_t cls = classOf(bytes);
+        used -= sizeOf(cls);
+        *static_cast<void**>(chunk) = freeLists[cls]; //Free chunks link through their first word
+        freeLists[cls] = chunk;
+    }
+
+    void clear() //Drops every page, chunks still in use must have been destroyed (large ones deallocated) first
+    {
+        pages.clear();
+        freeLists.fill(nullptr);
+        cursor = nullptr;
+        pageLeft = 0;
+        used = 0;
+    }
+
+    size_t bytesUsed() const { return used; } //Chunk sizes of live allocations
+    size_t bytesReserved() const { return pages.size() * SLAB_PAGE + large; } //What the slab holds from the heap
+
+private:
+    static constexpr size_t CLASSES = SLAB_MAX_CHUNK / ALIGN;
+    static_assert(SLAB_MAX_CHUNK % ALIGN == 0 && SLAB_PAGE >= SLAB_MAX_CHUNK);
+
+    static size_t classOf(const size_t bytes) { return bytes == 0 ? 0 : (bytes - 1) / ALIGN; }
+    static size_t sizeOf(const size_t cls) { return (cls + 1) * ALIGN; }
+
+    std::array<void*, CLASSES> freeLists{};
+    std::vector<std::unique_ptr<std::byte[]>> pages;
+    std::byte* cursor = nullptr; //Next unused byte of the newest page
+    size_t pageLeft = 0;
+    size_t used = 0;
+    size_t large = 0;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+//Bounded lock-free single producer/single consumer ring, one per (from shard, to shard) pair
+template<class T>
+class SPSCQueue {
+public:
+    explicit SPSCQueue(const size_t capacity) : mask(roundUp(capacity) - 1), slots(std::make_unique<std::optional<T>[]>(mask + 1)) {}
+
+    bool push(T&& item) //Producer thread only, false when full
+    {
+        const size_t tail = tailIdx.load(std::memory_order_relaxed);
+        if (tail - headCache == mask + 1)
+        {
+            headCache = headIdx.load(std::memory_order_acquire);
+            if (tail - headCache == mask + 1) return false;
+        }
+        slots[tail & mask].emplace(std::move(item));
+        tailIdx.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<T> pop() //Consumer thread only
+    {
+        const size_t head = headIdx.load(std::memory_order_relaxed);
+        if (head == tailCache)
+        {
+            tailCache = tailIdx.load(std::memory_order_acquire);
+            if (head == tailCache) return std::nullopt;
+        }
+        std::optional<T> ret = std::move(slots[head & mask]);
+        slots[head & mask].reset();
+        headIdx.store(head + 1, std::memory_order_release);
+        return ret;
+    }
+
+private:
+    static size_t roundUp(const size_t n)
+    {
+        size_t ret = 1;
+        while (ret < n) ret <<= 1;
+        return ret;
+    }
+
+    static constexpr size_t CACHE_LINE = 64;
+
+    const size_t mask;
+    std::unique_ptr<std::optional<T>[]> slots;
+    alignas(CACHE_LINE) std::atomic<size_t> headIdx{0}; //Written by the consumer
+    size_t tailCache = 0; //Consumer's last view of tailIdx
+    alignas(CACHE_LINE) std::atomic<size_t> tailIdx{0}; //Written by the producer
+    size_t headCache = 0; //Producer's last view of headIdx
+};
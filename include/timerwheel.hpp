@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+//Hierarchical timing wheel over 1 ms ticks: level L has 64 slots of 64^L ticks each, so 6 levels cover about 2 years
+//A timer sits in the level its distance calls for and falls a level each time the wheel passes its slot (cascading, like the old Linux timer wheel)
+//Arming, disarming and firing are O(1), the nodes are intrusive so the wheel allocates nothing of its own
+struct TimerNode {
+    int64_t deadline = 0; //Tick it fires at, kept when the slot only holds an approximation
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    uint16_t slot = 0; //Level * SLOTS + index + 1, or OVERDUE + 1, 0 while not armed
+};
+
+class TimerWheel { //Not thread safe, the owner locks around it
+public:
+    static constexpr unsigned BITS = 6;
+    static constexpr unsigned LEVELS = 6;
+    static constexpr int64_t SLOTS = 1 << BITS;
+    static constexpr int64_t MASK = SLOTS - 1;
+    static constexpr int64_t SPAN = int64_t{1} << (BITS * LEVELS); //Further deadlines are parked in the farthest slot and placed again when it comes up
+
+    explicit TimerWheel(const int64_t now) : current(now) {}
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    void arm(TimerNode& node, const int64_t deadline) //Re-arming moves the node
+    {
+        disarm(node);
+        node.deadline = deadline;
+        link(node);
+        ++count;
+    }
+    void disarm(TimerNode& node)
+    {
+        if (!node.slot) return;
+        unlink(node);
+        --count;
+    }
+    static bool armed(const TimerNode& node) { return node.slot != 0; }
+    size_t size() const { return count; }
+    int64_t lag(const int64_t now) const { return std::max<int64_t>(0, now + 1 - current); } //Ticks up to now not processed yet
+
+    template<class Fn> size_t advance(const int64_t now, const size_t limit, Fn&& fn) //fn(TimerNode&) on up to limit nodes due by now, each disarmed first, returns how many
+    {
+        size_t fired = 0;
+        while (slots[OVERDUE] && fired < limit) //Armed behind current, due whatever now is
+        {
+            TimerNode& node = *slots[OVERDUE];
+            disarm(node);
+            fn(node);
+            ++fired;
+        }
+        while (current <= now && fired < limit)
+        {
+            if (count == 0) //Nothing to cascade either
+            {
+                current = now + 1;
+                break;
+            }
+            TimerNode*& head = slots[current & MASK];
+            if (!head) //Skip to the next armed level 0 slot, or to the next cascade of the lowest level holding anything
+            {
+                int64_t next;
+                if (const uint64_t ahead = occupied[0] >> (current & MASK)) next = current + std::countr_zero(ahead);
+                else
+                {
+                    unsigned level = 1; //Level 0 slots behind current are its next round, so they wait for the next cascade too
+                    if (!occupied[0]) while (level + 1 < LEVELS && !occupied[level]) ++level;
+                    next = (current | ((int64_t{1} << (BITS * level)) - 1)) + 1; //Next multiple of that level's slot size
+                }
+                step(std::min(next, now + 1));
+                continue;
+            }
+            TimerNode& node = *head;
+            disarm(node);
+            if (node.deadline > current) //Parked past SPAN, placed again without writing the deadline others may read
+            {
+                link(node);
+                ++count;
+                continue;
+            }
+            fn(node);
+            ++fired;
+        }
+        return fired;
+    }
+
+private:
+    static constexpr size_t OVERDUE = LEVELS * SLOTS; //Extra list past the wheel's slots
+
+    void step(const int64_t to) //Moves current without crossing a cascade point it doesn't handle
+    {
+        current = to;
+        if ((current & MASK) == 0) cascade();
+    }
+    void cascade() //Level 1 slot for the new round of level 0, and up while a level wraps too
+    {
+        for (unsigned level = 1; level < LEVELS; ++level)
+        {
+            const int64_t index = (current >> (BITS * level)) & MASK;
+            TimerNode* node = std::exchange(slots[level * SLOTS + index], nullptr); //Detached whole, every node lands in another slot
+            occupied[level] &= ~(uint64_t{1} << index);
+            while (node)
+            {
+                TimerNode* next = node->next;
+                link(*node);
+                node = next;
+            }
+            if (index != 0) return;
+        }
+    }
+
+    void link(TimerNode& node)
+    {
+        size_t at = OVERDUE;
+        if (node.deadline >= current)
+        {
+            const int64_t tick = std::min(node.deadline, current + SPAN - 1);
+            const auto distance = static_cast<uint64_t>(tick - current);
+            unsigned level = 0;
+            while (distance >> (BITS * (level + 1))) ++level;
+            const auto index = static_cast<size_t>((tick >> (BITS * level)) & MASK);
+            at = level * SLOTS + index;
+            occupied[level] |= uint64_t{1} << index;
+        }
+        TimerNode*& head = slots[at];
+        node.prev = nullptr;
+        node.next = head;
+        if (head) head->prev = &node;
+        head = &node;
+        node.slot = static_cast<uint16_t>(at + 1);
+    }
+    void unlink(TimerNode& node)
+    {
+        const size_t at = node.slot - 1;
+        if (node.prev) node.prev->next = node.next;
+        else slots[at] = node.next;
+        if (node.next) node.next->prev = node.prev;
+        if (!slots[at] && at != OVERDUE) occupied[at / SLOTS] &= ~(uint64_t{1} << (at % SLOTS));
+        node.prev = node.next = nullptr;
+        node.slot = 0;
+    }
+
+    std::array<TimerNode*, LEVELS * SLOTS + 1> slots{};
+    std::array<uint64_t, LEVELS> occupied{}; //Bit per non empty wheel slot
+    int64_t current; //Next tick to process, every earlier one has fired
+    size_t count = 0;
+};
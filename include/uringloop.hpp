@@ -0,0 +1,100 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "config.h"
+#include "eventloop.hpp"
+#include "session.hpp"
+
+class Server;
+
+class UringLoop final : public EventLoop {
+public:
+    UringLoop(Server& server, int listenSock, int id); //Throws if the kernel lacks multishot/provided buffer support
+    ~UringLoop() override;
+
+    void run() override; //Submits and reaps completions until stop()
+    void stop() override; //Thread safe, completes the eventfd poll armed on the ring
+    void wake() override;
+    void flush(Session* session) override;
+
+private:
+    enum class Op : uint8_t {ACCEPT, RECV, SEND, WAKE};
+
+    struct Connection : Session {
+        using Session::Session;
+
+        uint64_t id = 0; //Never reused, stale completions for closed connections are dropped
+        OutputBuffer sending; //Segments referenced by the in flight sendmsg, writeBuffer keeps filling meanwhile
+        iovec sendIov[IOV_BATCH];
+        msghdr sendMsg{};
+        bool sendInFlight = false;
+        int pendingOps = 0; //Memory must outlive every op the kernel still holds
+        bool closing = false;
+    };
+
+    //Ring plumbing (raw syscalls, the uapi header is all that is needed)
+    void setupRing();
+    void setupBufferRing();
+    void probeMultishotRecv(); //Throws when recv can't be multishot, so create() falls back to epoll instead of failing per connection
+    io_uring_sqe* getSqe();
+    int submit(unsigned waitNr);
+    void reapCompletions();
+
+    void armAccept(); //Multishot, one sqe yields a cqe per connection
+    void armWake(); //Poll on the eventfd, drained and handled before re-arming
+    void armRecv(Connection& conn); //Multishot with buffers picked by the kernel from the provided ring
+    void submitSends(Connection& conn); //One sendmsg over the front segments, resubmitted until everything is out
+
+    void onAccept(int res, uint32_t flags);
+    void onRecv(Connection& conn, int res, uint32_t flags);
+    void onSend(Connection& conn, int res);
+    void returnBuffer(uint16_t bid);
+    void closeConnection(Connection& conn);
+    void releaseIfDone(Connection& conn);
+
+    static uint64_t packData(Op op, uint64_t id) { return static_cast<uint64_t>(op) << 56 | id; }
+
+    Server& server;
+    int listenSock;
+    int ringFd = -1;
+    int wakeFd = -1;
+    uint64_t wakeValue = 0; //Read target for the eventfd
+    std::atomic<bool> running{true};
+
+    //Submission queue
+    void* sqRingPtr = nullptr;
+    size_t sqRingBytes = 0;
+    void* cqRingPtr = nullptr;
+    size_t cqRingBytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesBytes = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned sqLocalTail = 0;
+    unsigned sqSubmitted = 0;
+
+    //Completion queue
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    //Provided buffer ring, recv picks a free buffer at completion time instead of pinning one per connection
+    io_uring_buf_ring* bufRing = nullptr;
+    size_t bufRingBytes = 0;
+    std::unique_ptr<char[]> bufPool;
+    uint16_t bufTail = 0;
+
+    uint64_t nextId = 1;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections; //Only accessed by the loop thread
+};
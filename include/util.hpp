@@ -10,7 +10,11 @@
 #include <unordered_map>
 #include <sys/sysinfo.h>
 #include <unistd.h>
-#include <tbb/concurrent_hash_map.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <optional>
+#include <string_view>
 
 #include "kvstore.hpp"
 
@@ -44,22 +48,6 @@
 // }
 
 //Parsing
-inline std::string readLine(const char* buffer, const size_t len, size_t& offset)
-{
-    const size_t readStart = offset;
-    while (offset + 1 < len)
-    {
-        if (buffer[offset] == '\r' && buffer[offset + 1] == '\n')
-        {
-            std::string line(buffer + readStart, offset - readStart);
-            offset += 2;
-            return line;
-        }
-        offset++;
-    }
-    throw std::runtime_error("Incomplete command in readLine");
-}
-
 inline std::vector<std::string> splitSpaces(const std::string& line)
 {
     std::vector<std::string> retVec;
@@ -72,6 +60,53 @@ inline std::vector<std::string> splitSpaces(const std::string& line)
     return retVec;
 }
 
+template<class T = int>
+T parseInt(const std::string_view arg) //Like std::stoi on an arg view, throws on junk or overflow of T
+{
+    T ret = 0;
+    const auto [end, err] = std::from_chars(arg.data(), arg.data() + arg.size(), ret);
+    if (err == std::errc::result_out_of_range) throw std::out_of_range("parseInt");
+    if (err != std::errc() || end != arg.data() + arg.size()) throw std::invalid_argument("parseInt");
+    return ret;
+}
+
+inline bool iequals(const std::string_view a, const std::string_view b) //ASCII case insensitive, for subcommands and config names
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) return false;
+    }
+    return true;
+}
+
+inline std::optional<size_t> parseMemory(const std::string_view arg) //Bytes like redis.conf: 1k is 1000, 1kb 1024, same for m(b) and g(b)
+{
+    const size_t digits = arg.find_first_not_of("0123456789");
+    const std::string_view unit = arg.substr(std::min(digits, arg.size()));
+    size_t scale = 1;
+    if (unit.empty() || iequals(unit, "b")) scale = 1;
+    else if (iequals(unit, "k")) scale = 1000;
+    else if (iequals(unit, "kb")) scale = 1024;
+    else if (iequals(unit, "m")) scale = 1000 * 1000;
+    else if (iequals(unit, "mb")) scale = 1024 * 1024;
+    else if (iequals(unit, "g")) scale = 1000 * 1000 * 1000;
+    else if (iequals(unit, "gb")) scale = 1024 * 1024 * 1024;
+    else return std::nullopt;
+
+    size_t n = 0;
+    try
+    {
+        n = parseInt<size_t>(arg.substr(0, digits));
+    }
+    catch (const std::exception&) {
+        return std::nullopt;
+    }
+    size_t bytes = 0;
+    if (__builtin_mul_overflow(n, scale, &bytes)) return std::nullopt;
+    return bytes;
+}
+
 inline std::string argumentError(std::string expected, size_t got)
 {
     return std::format("-ERR command expected {} arguments, got {} instead\r\n", expected, got);
@@ -81,24 +116,24 @@ inline std::string argumentError(std::string expected, size_t got)
 
 
 //For serialization (to work with Boost)
-inline std::unordered_map<std::string, RESPValue> convertToUnorderedMap(const tbb::concurrent_hash_map<std::string, RESPValue>& conMap)
+inline std::unordered_map<std::string, RESPValue> convertToUnorderedMap(const Dict<Object>& conMap)
 {
     std::unordered_map<std::string, RESPValue> retMap;
-    for (const auto & [key, val] : conMap)
+    retMap.reserve(conMap.size());
+    conMap.forEach([&retMap](const Dict<Object>::Entry& entry)
     {
-        retMap[key] = val;
-    }
+        retMap.emplace(entry.key(), entry.second.toValue());
+    });
     return retMap;
 }
 
-inline tbb::concurrent_hash_map<std::string, RESPValue> convertToConcurrentMap(const std::unordered_map<std::string, RESPValue>& conMap)
+inline void loadIntoDict(Dict<Object>& dict, const std::unordered_map<std::string, RESPValue>& conMap) //Dict isn't copyable, refilled in place
 {
-    tbb::concurrent_hash_map<std::string, RESPValue> retMap;
+    dict.clear();
     for (const auto & [key, val] : conMap)
     {
-        retMap.insert({key, val});
+        dict.insert(key, Object(val));
     }
-    return retMap;
 }
 
 //Memory management
@@ -1,534 +1,591 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <string>
-#include <format>
-#include <unordered_map>
 
 #include "commands.hpp"
 #include "kvstore.hpp"
 #include "pubsub.hpp"
+#include "replywriter.hpp"
 #include "session.hpp"
 #include "util.hpp"
 
-Commands strToCmd(const std::string& cmd)
-{
-    static const std::unordered_map<std::string, Commands> cmdMap =
-    {
-        {"PING", Commands::PING},
-        {"ECHO", Commands::ECHO},
-        {"DEL", Commands::DEL},
-        {"EXISTS", Commands::EXISTS},
-        {"FLUSHALL", Commands::FLUSHALL},
-        {"SET", Commands::SET},
-        {"GET", Commands::GET},
-        {"INCR", Commands::INCR},
-        {"DCR", Commands::DCR},
-        {"INCRBY", Commands::INCRBY},
-        {"DCRBY", Commands::DCRBY},
-        {"APPEND", Commands::APPEND},
-        {"EXPIRE", Commands::EXPIRE},
-        {"TTL", Commands::TTL},
-        {"PERSIST", Commands::PERSIST},
-        {"MGET", Commands::MGET},
-        {"LPUSH", Commands::LPUSH},
-        {"RPUSH", Commands::RPUSH},
-        {"LPOP", Commands::LPOP},
-        {"RPOP", Commands::RPOP},
-        {"LRANGE", Commands::LRANGE},
-        {"LLEN", Commands::LLEN},
-        {"LINDEX", Commands::LINDEX},
-        {"LSET", Commands::LSET},
-        {"LREM", Commands::LREM},
-        {"SADD", Commands::SADD},
-        {"SREM", Commands::SREM},
-        {"SISMEMBER", Commands::SISMEMBER},
-        {"SMEMBERS", Commands::SMEMBERS},
-        {"SCARD", Commands::SCARD},
-        {"SPOP", Commands::SPOP},
-        {"HSET", Commands::HSET},
-        {"HGET", Commands::HGET},
-        {"HDEL", Commands::HDEL},
-        {"HEXISTS", Commands::HEXISTS},
-        {"HLEN", Commands::HLEN},
-        {"HKEYS", Commands::HKEYS},
-        {"HVALS", Commands::HVALS},
-        {"HMGET", Commands::HMGET},
-        {"HGETALL", Commands::HGETALL},
-        {"MULTI", Commands::MULTI},
-        {"EXEC", Commands::EXEC},
-        {"DISCARD", Commands::DISCARD},
-        {"PUBLISH", Commands::PUBLISH},
-        {"SUBSCRIBE", Commands::SUBSCRIBE},
-        {"UNSUBSCRIBE", Commands::UNSUBSCRIBE},
-        {"CONFIG", Commands::CONFIG},
-        {"TYPE", Commands::TYPE},
-        {"SAVE", Commands::SAVE}
-    };
-
-    const auto found = cmdMap.find(cmd);
-    return found != cmdMap.end() ? found->second : Commands::UNKNOWN;
-}
-
-std::string handlePING(const std::vector<std::string>& args)
+std::string handlePING(const std::vector<std::string_view>& args)
 {
     if (args.size() > 1) return argumentError("1 or none", args.size());
 
-    return args.size() == 1 ? std::format("${}\r\n{}\r\n", args[0].length(), args[0]) : "+PONG\r\n";
+    return args.size() == 1 ? ReplyWriter().bulk(args[0]).take() : std::string(RESP_PONG);
 }
-std::string handleECHO(const std::vector<std::string>& args)
+std::string handleECHO(const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
 
-    return std::format("${}\r\n{}\r\n", args[0].length(), args[0]);
+    return ReplyWriter().bulk(args[0]).take();
 }
-std::string handleDEL(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleDEL(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.empty()) return argumentError("1 or more", args.size());
 
-    return std::format(":{}\r\n",kvstore.del(args));
+    return ReplyWriter().integer(kvstore.del(args)).take();
 }
-std::string handleEXISTS(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleEXISTS(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.empty()) return argumentError("1 or more", args.size());
 
-    return std::format(":{}\r\n", kvstore.exists(args));
+    return ReplyWriter().integer(kvstore.exists(args)).take();
 }
-std::string handleFLUSHALL(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleFLUSHALL(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (!args.empty()) return argumentError("0", args.size());
 
     kvstore.flushall();
-    return "+OK\r\n";
+    return std::string(RESP_OK);
 }
 
-std::string handleSET(KVStore& kvstore, const std::vector<std::string>& args)
+//EXPIRE family time as a CoarseClock deadline, unitMs 1000 for seconds, unix times are moved over by the current offset between the clocks
+static std::optional<int64_t> deadlineOf(const long long n, const int64_t unitMs, const bool unixTime)
 {
-    if (args.size() != 2) return argumentError("2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::STR)) return *err;
+    const int64_t base = unixTime ? CoarseClock::nowMs() - CoarseClock::unixMs() : CoarseClock::nowMs();
+    int64_t ms = 0;
+    int64_t deadline = 0;
+    if (__builtin_mul_overflow(n, unitMs, &ms) || __builtin_add_overflow(ms, base, &deadline)) return std::nullopt;
+    return deadline;
+}
+
+std::string handleSET(KVStore& kvstore, const std::vector<std::string_view>& args) //key value [NX|XX] [GET] [EX s|PX ms|KEEPTTL]
+{
+    if (args.size() < 2) return argumentError("2 or more", args.size());
+
+    using Condition = KVStore::SetOptions::Condition;
+    KVStore::SetOptions options;
+    for (size_t i = 2; i < args.size(); ++i)
+    {
+        const std::string_view opt = args[i];
+        const bool ex = iequals(opt, "EX");
+        if (iequals(opt, "NX") && options.condition == Condition::ALWAYS) options.condition = Condition::NX;
+        else if (iequals(opt, "XX") && options.condition == Condition::ALWAYS) options.condition = Condition::XX;
+        else if (iequals(opt, "GET")) options.get = true;
+        else if (iequals(opt, "KEEPTTL") && !options.deadline) options.keepTtl = true;
+        else if ((ex || iequals(opt, "PX")) && !options.keepTtl && !options.deadline && i + 1 < args.size())
+        {
+            long long n = 0;
+            try
+            {
+                n = parseInt<long long>(args[++i]);
+            }
+            catch (const std::exception&) {
+                return "-ERR value is not an integer or out of range\r\n";
+            }
+            options.deadline = n > 0 ? deadlineOf(n, ex ? 1000 : 1, false) : std::nullopt;
+            if (!options.deadline) return "-ERR invalid expire time in 'set' command\r\n";
+        }
+        else return "-ERR syntax error\r\n";
+    }
 
-    return kvstore.set(args[0], args[1]) ? "+OK\r\n" : "-ERR something went wrong in set\r\n";
+    const auto result = kvstore.set(args[0], args[1], options);
+    if (result.wrongType) return std::string(RESP_WRONG_TYPE);
+    if (options.get) return ReplyWriter().bulkOrNil(result.old).take();
+    return result.written ? std::string(RESP_OK) : std::string(RESP_NIL);
 }
-std::string handleGET(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleGET(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::STR)) return *err;
 
-    auto val = kvstore.get(args[0]);
-    return val ? std::format("${}\r\n{}\r\n", val->length(), val.value()) : "$-1\r\n";
+    const auto val = kvstore.get(args[0]);
+    if (val.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().bulkOrNil(val.value).take();
 }
-std::string handleINCR(KVStore& kvstore, const std::vector<std::string>& args)
+OutputBuffer handleGETPinned(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::STR)) return *err;
 
-    if (auto found = kvstore.incr(args[0])) return std::format(":{}\r\n", found.value());
+    ReplyWriter resp;
+    auto pinned = kvstore.getInto(args[0], resp);
+    OutputBuffer reply(resp.take());
+    if (pinned) //Header is in resp, the bytes go out from the store
+    {
+        reply.append(std::move(pinned));
+        reply.append(std::string_view("\r\n"));
+    }
+    return reply;
+}
+std::string handleINCR(KVStore& kvstore, const std::vector<std::string_view>& args)
+{
+    if (args.size() != 1) return argumentError("1", args.size());
+
+    const auto found = kvstore.incr(args[0]);
+    if (found.wrongType) return std::string(RESP_WRONG_TYPE);
+    if (found.value) return ReplyWriter().integer(*found.value).take();
     return "-ERR value is not number or out of range\r\n";
 }
-std::string handleDCR(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleDCR(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::STR)) return *err;
 
-    if (auto found = kvstore.dcr(args[0])) return std::format(":{}\r\n", found.value());
+    const auto found = kvstore.dcr(args[0]);
+    if (found.wrongType) return std::string(RESP_WRONG_TYPE);
+    if (found.value) return ReplyWriter().integer(*found.value).take();
     return "-ERR value is not number or out of range\r\n";
 }
-std::string handleINCRBY(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleINCRBY(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 2) return argumentError("2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::STR)) return *err;
 
     try
     {
-        const int count = std::stoi(args[1]);
-        if (auto found = kvstore.incrby(args[0], count)) return std::format(":{}\r\n", found.value());
+        const long long count = parseInt<long long>(args[1]);
+        const auto found = kvstore.incrby(args[0], count);
+        if (found.wrongType) return std::string(RESP_WRONG_TYPE);
+        if (found.value) return ReplyWriter().integer(*found.value).take();
         return "-ERR value is not number or out of range\r\n";
     }
     catch (const std::exception&) {
         return "-ERR arg given not a number\r\n";
     }
 }
-std::string handleDCRBY(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleDCRBY(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 2) return argumentError("2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::STR)) return *err;
 
     try
     {
-        const int count = std::stoi(args[1]);
-        if (auto found = kvstore.dcrby(args[0], count)) return std::format(":{}\r\n", found.value());
+        const long long count = parseInt<long long>(args[1]);
+        const auto found = kvstore.dcrby(args[0], count);
+        if (found.wrongType) return std::string(RESP_WRONG_TYPE);
+        if (found.value) return ReplyWriter().integer(*found.value).take();
         return "-ERR value is not number or out of range\r\n";
     }
     catch (const std::exception&) {
         return "-ERR arg given not a number\r\n";
     }
 }
-std::string handleMGET(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleMGET(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.empty()) return argumentError("1 or more", args.size());
 
 
-    const auto vals = kvstore.mget(args);
-    std::string resp = std::format("*{}\r\n", vals.size());
-    for (const auto& i : vals)
-    {
-        if (i == std::nullopt) resp += std::format("$-1\r\n");
-        else resp += std::format("${}\r\n{}\r\n", i->length(), *i);
-    }
-    return resp;
+    return ReplyWriter().array(kvstore.mget(args)).take();
 }
-std::string handleAPPEND(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleAPPEND(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 2) return argumentError("2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::STR)) return *err;
 
-    return std::format(":{}\r\n", kvstore.append(args[0], args[1]));
+    const auto len = kvstore.append(args[0], args[1]);
+    if (len.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(len.value).take();
 }
 
-std::string handleEXPIRE(KVStore& kvstore, const std::vector<std::string>& args)
+static std::string expireWith(KVStore& kvstore, const std::vector<std::string_view>& args, const int64_t unitMs, const bool unixTime, const std::string_view name)
 {
     if (args.size() != 2) return argumentError("2", args.size());
 
+    long long n = 0;
     try
     {
-        if (const int seconds = std::stoi(args[1]); kvstore.expire(args[0], seconds)) return ":1\r\n";
-        return ":0\r\n";
+        n = parseInt<long long>(args[1]);
     }
     catch (const std::exception&) {
-        return "-ERR seconds provided not number\r\n";
+        return "-ERR value is not an integer or out of range\r\n";
     }
+    const auto deadline = deadlineOf(n, unitMs, unixTime);
+    if (!deadline) return std::format("-ERR invalid expire time in '{}' command\r\n", name);
+    return std::string(kvstore.expireAt(args[0], *deadline) ? RESP_ONE : RESP_ZERO);
 }
-std::string handleTTL(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleEXPIRE(KVStore& kvstore, const std::vector<std::string_view>& args)
+{
+    return expireWith(kvstore, args, 1000, false, "expire");
+}
+std::string handlePEXPIRE(KVStore& kvstore, const std::vector<std::string_view>& args)
+{
+    return expireWith(kvstore, args, 1, false, "pexpire");
+}
+std::string handleEXPIREAT(KVStore& kvstore, const std::vector<std::string_view>& args)
+{
+    return expireWith(kvstore, args, 1000, true, "expireat");
+}
+std::string handlePEXPIREAT(KVStore& kvstore, const std::vector<std::string_view>& args)
+{
+    return expireWith(kvstore, args, 1, true, "pexpireat");
+}
+std::string handleTTL(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
 
-    return std::format(":{}\r\n", kvstore.ttl(args[0]));
+    return ReplyWriter().integer(kvstore.ttl(args[0])).take();
 }
-std::string handlePERSIST(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handlePTTL(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
 
-    return kvstore.persist(args[0]) ? ":1\r\n" : ":0\r\n";
+    return ReplyWriter().integer(kvstore.pttl(args[0])).take();
+}
+std::string handlePERSIST(KVStore& kvstore, const std::vector<std::string_view>& args)
+{
+    if (args.size() != 1) return argumentError("1", args.size());
+
+    return kvstore.persist(args[0]) ? std::string(RESP_ONE) : std::string(RESP_ZERO);
 }
 
-std::string handleLPUSH(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleLPUSH(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.empty()) return argumentError("1 or more", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
-    return std::format(":{}\r\n",kvstore.lpush(args));
+    const auto size = kvstore.lpush(args);
+    if (size.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(size.value).take();
 }
-std::string handleRPUSH(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleRPUSH(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.empty()) return argumentError("1 or more", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
-    return std::format(":{}\r\n",kvstore.rpush(args));
+    const auto size = kvstore.rpush(args);
+    if (size.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(size.value).take();
 }
-std::string handleLPOP(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleLPOP(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
-    auto val = kvstore.lpop(args[0]);
-    return val ? std::format("${}\r\n{}\r\n", val->length(), val.value()) : "$-1\r\n";
+    const auto val = kvstore.lpop(args[0]);
+    if (val.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().bulkOrNil(val.value).take();
 }
-std::string handleRPOP(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleRPOP(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
-    auto val = kvstore.rpop(args[0]);
-    return val ? std::format("${}\r\n{}\r\n", val->length(), val.value()) : "$-1\r\n";
+    const auto val = kvstore.rpop(args[0]);
+    if (val.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().bulkOrNil(val.value).take();
 }
-std::string handleLRANGE(KVStore& kvstore, const std::vector<std::string>& args)
+OutputBuffer handleLRANGE(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 3) return argumentError("3", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
     try
     {
-        const int start = std::stoi(args[1]);
-        const int stop = std::stoi(args[2]);
-        const auto vals = kvstore.lrange(args[0], start, stop);
-        std::string resp = std::format("*{}\r\n", vals.size());
-        for (const auto& i : vals)
-        {
-            if (i == std::nullopt) resp += std::format("$-1\r\n");
-            else resp += std::format("${}\r\n{}\r\n", i->length(), *i);
-        }
-        return resp;
+        const int start = parseInt(args[1]);
+        const int stop = parseInt(args[2]);
+        OutputBuffer reply;
+        ReplyWriter resp(reply);
+        kvstore.lrangeInto(args[0], start, stop, resp);
+        resp.flush();
+        return reply;
     }
     catch (const std::exception&) {
         return "-ERR value is not an integer or out of range\r\n";
     }
 }
-std::string handleLLEN(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleLLEN(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
-    return std::format(":{}\r\n", kvstore.llen(args[0]));
+    const auto len = kvstore.llen(args[0]);
+    if (len.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(len.value).take();
 }
-std::string handleLINDEX(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleLINDEX(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 2) return argumentError("2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
     try
     {
-        const int index = std::stoi(args[1]);
-        auto val = kvstore.lindex(args[0], index);
-        return val ? std::format("${}\r\n{}\r\n", val->length(), val.value()) : "$-1\r\n";
+        const int index = parseInt(args[1]);
+        const auto val = kvstore.lindex(args[0], index);
+        if (val.wrongType) return std::string(RESP_WRONG_TYPE);
+        return ReplyWriter().bulkOrNil(val.value).take();
     }
     catch (const std::exception&) {
         return "-ERR value is not an integer or out of range\r\n";
     }
 }
-std::string handleLSET(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleLSET(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 3) return argumentError("3", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
     try
     {
-        const int index = std::stoi(args[1]);
-        return kvstore.lset(args[0], index, args[2]) ? "+OK\r\n" : "-ERR no such key or value out of range\r\n";  //fix ERR to make sense
+        const int index = parseInt(args[1]);
+        const auto replaced = kvstore.lset(args[0], index, args[2]);
+        if (replaced.wrongType) return std::string(RESP_WRONG_TYPE);
+        return replaced.value ? std::string(RESP_OK) : "-ERR no such key or value out of range\r\n";  //fix ERR to make sense
     }
     catch (const std::exception&) {
         return "-ERR value is not an integer or out of range\r\n";
     }
 }
-std::string handleLREM(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleLREM(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 3) return argumentError("3", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::LIST)) return *err;
 
     try
     {
-        const int count = std::stoi(args[1]);
-        return std::format(":{}\r\n", kvstore.lrem(args[0], count, args[2]));
+        const int count = parseInt(args[1]);
+        const auto removed = kvstore.lrem(args[0], count, args[2]);
+        if (removed.wrongType) return std::string(RESP_WRONG_TYPE);
+        return ReplyWriter().integer(removed.value).take();
     }
     catch (const std::exception&) {
         return "-ERR value is not an integer or out of range\r\n";
     }
 }
 
-std::string handleSADD(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleSADD(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() < 2) return argumentError("2 or more", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::SET)) return *err;
 
-    return std::format(":{}\r\n", kvstore.sadd(args));
+    const auto added = kvstore.sadd(args);
+    if (added.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(added.value).take();
 }
-std::string handleSREM(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleSREM(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() < 2) return argumentError("2 or more", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::SET)) return *err;
 
-    return std::format(":{}\r\n", kvstore.srem(args));
+    const auto removed = kvstore.srem(args);
+    if (removed.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(removed.value).take();
 }
-std::string handleSISMEMBER(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleSISMEMBER(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 2) return argumentError("2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::SET)) return *err;
 
-    return kvstore.sismember(args[0], args[1]) ? ":1\r\n" : ":0\r\n";
+    const auto member = kvstore.sismember(args[0], args[1]);
+    if (member.wrongType) return std::string(RESP_WRONG_TYPE);
+    return member.value ? std::string(RESP_ONE) : std::string(RESP_ZERO);
 }
-std::string handleSMEMBERS(KVStore& kvstore, const std::vector<std::string>& args)
+OutputBuffer handleSMEMBERS(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::SET)) return *err;
 
-    const auto vals = kvstore.smembers(args[0]);
-    std::string resp = std::format("*{}\r\n", vals.size());
-    for (const auto& i : vals)
-    {
-        if (i == std::nullopt) resp += std::format("$-1\r\n");
-        else resp += std::format("${}\r\n{}\r\n", i->length(), *i);
-    }
-    return resp;
+    OutputBuffer reply;
+    ReplyWriter resp(reply);
+    kvstore.smembersInto(args[0], resp);
+    resp.flush();
+    return reply;
 }
-std::string handleSCARD(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleSCARD(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::SET)) return *err;
 
-    return std::format(":{}\r\n", kvstore.scard(args[0]));
+    const auto card = kvstore.scard(args[0]);
+    if (card.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(card.value).take();
 }
-std::string handleSPOP(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleSPOP(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (!(args.size() == 1 || args.size() == 2)) return argumentError("1 or 2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::SET)) return *err;
 
     try
     {
         int count;
-        std::string resp;
-        if (args.size() == 2) count = std::stoi(args[1]);
+        if (args.size() == 2) count = parseInt(args[1]);
         else count = 1;
 
-        const auto vals = kvstore.spop(args[0], count);
-        if (vals.empty()) return "$-1\r\n";
+        const auto popped = kvstore.spop(args[0], count);
+        if (popped.wrongType) return std::string(RESP_WRONG_TYPE);
+        const auto& vals = popped.value;
+        if (vals.empty()) return std::string(RESP_NIL);
 
-        if (vals.size() > 1) resp += std::format("*{}\r\n", vals.size());
-        for (const auto& i : vals)
-        {
-            if (i == std::nullopt) resp += std::format("$-1\r\n");
-            else resp += std::format("${}\r\n{}\r\n", i->length(), *i);
-        }
-        return resp;
+        if (vals.size() > 1) return ReplyWriter().array(vals).take();
+        return ReplyWriter().bulkOrNil(vals[0]).take();
     }
     catch (const std::exception&) {
         return "-ERR value is not an integer or out of range\r\n";
     }
 }
 
-std::string handleHSET(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleHSET(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() < 3) return argumentError("3 or more", args.size());
     if (args.size() % 2 == 0) return "-ERR expected pair of fields and values";
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
-    return std::format(":{}\r\n", kvstore.hset(args));
+    const auto added = kvstore.hset(args);
+    if (added.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(added.value).take();
 }
-std::string handleHGET(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleHGET(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 2) return argumentError("2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
-    auto val = kvstore.hget(args[0], args[1]);
-    return val ? std::format("${}\r\n{}\r\n", val->length(), val.value()) : "$-1\r\n";
+    const auto val = kvstore.hget(args[0], args[1]);
+    if (val.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().bulkOrNil(val.value).take();
 }
-std::string handleHDEL(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleHDEL(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() < 2) return argumentError("2 or more", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
-    return std::format(":{}\r\n", kvstore.hdel(args));
+    const auto removed = kvstore.hdel(args);
+    if (removed.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(removed.value).take();
 }
-std::string handleHEXISTS(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleHEXISTS(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 2) return argumentError("2", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
-    return kvstore.hexists(args[0], args[1]) ? ":1\r\n" : ":0\r\n";
+    const auto exists = kvstore.hexists(args[0], args[1]);
+    if (exists.wrongType) return std::string(RESP_WRONG_TYPE);
+    return exists.value ? std::string(RESP_ONE) : std::string(RESP_ZERO);
 }
-std::string handleHLEN(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleHLEN(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
-    return std::format(":{}\r\n", kvstore.hlen(args[0]));
+    const auto len = kvstore.hlen(args[0]);
+    if (len.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().integer(len.value).take();
 }
-std::string handleHKEYS(KVStore& kvstore, const std::vector<std::string>& args)
+OutputBuffer handleHKEYS(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
-    const auto vals = kvstore.hkeys(args[0]);
-    std::string resp = std::format("*{}\r\n", vals.size());
-    for (const auto& i : vals)
-    {
-        if (i == std::nullopt) resp += std::format("$-1\r\n");
-        else resp += std::format("${}\r\n{}\r\n", i->length(), *i);
-    }
-    return resp;
+    OutputBuffer reply;
+    ReplyWriter resp(reply);
+    kvstore.hkeysInto(args[0], resp);
+    resp.flush();
+    return reply;
 }
-std::string handleHVALS(KVStore& kvstore, const std::vector<std::string>& args)
+OutputBuffer handleHVALS(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
-    const auto vals = kvstore.hvals(args[0]);
-    std::string resp = std::format("*{}\r\n", vals.size());
-    for (const auto& i : vals)
-    {
-        if (i == std::nullopt) resp += std::format("$-1\r\n");
-        else resp += std::format("${}\r\n{}\r\n", i->length(), *i);
-    }
-    return resp;
+    OutputBuffer reply;
+    ReplyWriter resp(reply);
+    kvstore.hvalsInto(args[0], resp);
+    resp.flush();
+    return reply;
 }
-std::string handleHMGET(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleHMGET(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() < 2) return argumentError("2 or more", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
     const auto vals = kvstore.hmget(args);
-    std::string resp = std::format("*{}\r\n", vals.size());
-    for (const auto& i : vals)
-    {
-        if (i == std::nullopt) resp += std::format("$-1\r\n");
-        else resp += std::format("${}\r\n{}\r\n", i->length(), *i);
-    }
-    return resp;
+    if (vals.wrongType) return std::string(RESP_WRONG_TYPE);
+    return ReplyWriter().array(vals.value).take();
 }
-std::string handleHGETALL(KVStore& kvstore, const std::vector<std::string>& args)
+OutputBuffer handleHGETALL(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
-    if (auto err = kvstore.checkTypeError(args[0], storeType::HASH)) return *err;
 
-    const auto vals = kvstore.hgetall(args[0]);
-    std::string resp = std::format("*{}\r\n", vals.size());
-    for (const auto& i : vals)
-    {
-        if (i == std::nullopt) resp += std::format("$-1\r\n");
-        else resp += std::format("${}\r\n{}\r\n", i->length(), *i);
-    }
-    return resp;
+    OutputBuffer reply;
+    ReplyWriter resp(reply);
+    kvstore.hgetallInto(args[0], resp);
+    resp.flush();
+    return reply;
 
 }
 
-std::string handlePUBLISH(PubSub& ps, const std::vector<std::string>& args)
+std::string handlePUBLISH(PubSub& ps, const std::vector<std::string_view>& args)
 {
     if (args.size() != 2) return argumentError("2", args.size());
-    return std::format(":{}\r\n", ps.publish(args[0],args[1]));
+    return ReplyWriter().integer(ps.publish(std::string(args[0]), std::string(args[1]))).take();
 }
-std::string handleSUBSCRIBE(PubSub& ps, const std::vector<std::string>& args, const int sock)
+std::string handleSUBSCRIBE(PubSub& ps, const std::vector<std::string_view>& args, Session* session)
 {
     if (args.empty()) return argumentError("1 or more", args.size());
 
-    std::string resp;
+    ReplyWriter resp;
     for (const auto& i : args)
     {
-        resp += std::format("*3\r\n$9\r\nsubscribe\r\n${}\r\n{}\r\n:{}\r\n", i.size(), i, ps.subscribe(i, sock));
+        resp.arrayHeader(3).bulk("subscribe").bulk(i).integer(ps.subscribe(std::string(i), session));
     }
-    return resp;
+    return resp.take();
 }
-std::string handleUNSUBSCRIBE(PubSub& ps, const std::vector<std::string>& args, const int sock)
+std::string handleUNSUBSCRIBE(PubSub& ps, const std::vector<std::string_view>& args, Session* session)
 {
     if (args.empty()) return argumentError("1 or more", args.size());
 
-    std::string resp;
+    ReplyWriter resp;
     for (const auto& i : args)
     {
-        resp += std::format("*3\r\n$11\r\nunsubscribe\r\n${}\r\n{}\r\n:{}\r\n", i.size(), i, ps.unsubscribe(i, sock));
+        resp.arrayHeader(3).bulk("unsubscribe").bulk(i).integer(ps.unsubscribe(std::string(i), session));
     }
-    return resp;
+    return resp.take();
 }
 
-std::string handleMULTI(Session* session, const std::vector<std::string>& args)
+std::string handleMULTI(Session* session, const std::vector<std::string_view>& args)
 {
     if (!args.empty()) return argumentError("0", args.size());
     if (session->transActive) return "-ERR MULTI calls can not be nested";
     session->transActive = true;
     session->transQueue.clear();
-    return "+OK\r\n";
+    return std::string(RESP_OK);
 }
 //EXEC handled in server.cpp handleCommands
-std::string handleDISCARD(Session* session, const std::vector<std::string>& args)
+std::string handleDISCARD(Session* session, const std::vector<std::string_view>& args)
 {
     if (!args.empty()) return argumentError("0", args.size());
     if (session->transActive) return "-ERR DISCARD without MULTI";
     session->transActive = false;
     session->transQueue.clear();
-    return "+OK\r\n";
+    return std::string(RESP_OK);
 }
 
-std::string handleCONFIG(const std::vector<std::string>& args) //TODO remove or actually implement (only for benchmark start)
+std::string handleCONFIG(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
-    if (args[0] == "GET") return "*14\r\n$7\r\ntimeout\r\n$1\r\n0\r\n$9\r\ndatabases\r\n$1\r\n1\r\n$11\r\nrequirepass\r\n$0\r\n\r\n$9\r\nmaxmemory\r\n$1\r\n0\r\n$3\r\ndir\r\n$5\r\n./data\r\n";
-    return "-ERR not handled";
+    if (iequals(args[0], "GET"))
+    {
+        if (args.size() != 2) return argumentError("2", args.size());
+
+        const std::pair<std::string_view, std::string> params[] = {
+            {"maxmemory", std::to_string(kvstore.maxMemory())},
+            {"maxmemory-policy", std::string(policyName(kvstore.evictionPolicy()))},
+            {"maxmemory-samples", std::to_string(kvstore.maxMemorySamples())},
+            {"timeout", "0"}, {"databases", "1"}, {"requirepass", ""}, {"dir", "./data"}, //Fixed, what benchmark tools ask for
+        };
+        std::vector<std::string_view> matched;
+        for (const auto& [name, value] : params)
+        {
+            if (args[1] != "*" && !iequals(args[1], name)) continue;
+            matched.push_back(name);
+            matched.push_back(value);
+        }
+        ReplyWriter resp;
+        resp.arrayHeader(matched.size());
+        for (const auto& i : matched) resp.bulk(i);
+        return resp.take();
+    }
+    if (iequals(args[0], "SET"))
+    {
+        if (args.size() != 3) return argumentError("3", args.size());
+
+        if (iequals(args[1], "maxmemory"))
+        {
+            const auto bytes = parseMemory(args[2]);
+            if (!bytes) return std::format("-ERR Invalid argument '{}' for CONFIG SET 'maxmemory'\r\n", args[2]);
+            kvstore.setMaxMemory(*bytes);
+            kvstore.makeRoom(); //A lower limit evicts right away
+            return std::string(RESP_OK);
+        }
+        if (iequals(args[1], "maxmemory-policy"))
+        {
+            std::string name(args[2]);
+            std::ranges::transform(name, name.begin(), [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            const auto policy = policyFromName(name);
+            if (!policy) return std::format("-ERR Invalid argument '{}' for CONFIG SET 'maxmemory-policy'\r\n", args[2]);
+            kvstore.setEvictionPolicy(*policy);
+            return std::string(RESP_OK);
+        }
+        if (iequals(args[1], "maxmemory-samples"))
+        {
+            try
+            {
+                const int n = parseInt(args[2]);
+                if (n < 1 || n > 64) throw std::out_of_range("maxmemory-samples");
+                kvstore.setMaxMemorySamples(static_cast<unsigned>(n));
+                return std::string(RESP_OK);
+            }
+            catch (const std::exception&) {
+                return std::format("-ERR Invalid argument '{}' for CONFIG SET 'maxmemory-samples'\r\n", args[2]);
+            }
+        }
+        return std::format("-ERR Unknown option '{}' for CONFIG SET\r\n", args[1]);
+    }
+    return std::format("-ERR unknown subcommand '{}' for CONFIG\r\n", args[0]);
 }
-std::string handleTYPE(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleTYPE(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (args.size() != 1) return argumentError("1", args.size());
     if (const auto resp = kvstore.getType(args[0]))
@@ -545,9 +602,207 @@ std::string handleTYPE(KVStore& kvstore, const std::vector<std::string>& args)
     }
     return "+none\r\n"; // Fall back
 }
-std::string handleSAVE(KVStore& kvstore, const std::vector<std::string>& args)
+std::string handleOBJECT(KVStore& kvstore, const std::vector<std::string_view>& args)
+{
+    if (args.size() != 2) return argumentError("2", args.size());
+
+    const bool lfu = tracksLFU(kvstore.evictionPolicy());
+    if (iequals(args[0], "FREQ"))
+    {
+        if (!lfu) return "-ERR An LFU maxmemory policy is not selected, access frequency not tracked\r\n";
+        const auto freq = kvstore.frequency(args[1]);
+        return freq ? ReplyWriter().integer(*freq).take() : std::string(RESP_NIL);
+    }
+    if (iequals(args[0], "IDLETIME"))
+    {
+        if (lfu) return "-ERR An LFU maxmemory policy is selected, idle time not tracked\r\n";
+        const auto idle = kvstore.idleSeconds(args[1]);
+        return idle ? ReplyWriter().integer(*idle).take() : std::string(RESP_NIL);
+    }
+    return std::format("-ERR unknown subcommand '{}' for OBJECT\r\n", args[0]);
+}
+std::string handleSAVE(KVStore& kvstore, const std::vector<std::string_view>& args)
 {
     if (!args.empty()) return argumentError("0", args.size());
     kvstore.saveToDisk();
-    return "+OK\r\n";
-}
\ No newline at end of file
+    return std::string(RESP_OK);
+}
+std::string handleINFO(KVStore& kvstore, const std::vector<std::string_view>&) //Any section name gets every section for now
+{
+    const auto stats = kvstore.rehashStats();
+    const size_t progress = stats.slotsTotal ? 100 * (stats.slotsTotal - stats.slotsLeft) / stats.slotsTotal : 100;
+
+    std::string text = "# Memory\r\n";
+    text += "used_memory:" + std::to_string(kvstore.usedMemory()) + "\r\n"; //Keys and values, what maxmemory is checked against
+    text += "maxmemory:" + std::to_string(kvstore.maxMemory()) + "\r\n";
+    text += "maxmemory_policy:" + std::string(policyName(kvstore.evictionPolicy())) + "\r\n";
+    size_t evicted = 0;
+    std::string byPolicy;
+    for (const auto& row : EVICTION_POLICIES)
+    {
+        if (row.order == EvictionOrder::NONE) continue;
+        const size_t n = kvstore.evictedKeys(row.policy);
+        evicted += n;
+        std::string name(row.name);
+        std::ranges::replace(name, '-', '_');
+        byPolicy += "evicted_keys_" + name + ":" + std::to_string(n) + "\r\n";
+    }
+    text += "evicted_keys:" + std::to_string(evicted) + "\r\n" + byPolicy;
+    const auto expire = kvstore.expireStats();
+    text += "\r\n# Stats\r\n";
+    text += "expired_keys:" + std::to_string(expire.expired) + "\r\n";
+    text += "expired_time_cap_reached_count:" + std::to_string(expire.timeCapReached) + "\r\n";
+    text += "expire_cycles:" + std::to_string(expire.cycles) + "\r\n";
+    text += "expire_cycle_time_us:" + std::to_string(expire.cycleMicros) + "\r\n";
+    text += "expire_cycle_last_us:" + std::to_string(expire.lastCycleMicros) + "\r\n";
+    text += "expire_wheel_lag_ms:" + std::to_string(expire.lagMs) + "\r\n"; //Due keys a budget cut cycle left for the next
+    text += "\r\n# Keyspace\r\n";
+    text += "keys:" + std::to_string(kvstore.keyCount()) + "\r\n";
+    text += "dict_bytes:" + std::to_string(kvstore.dictMemory()) + "\r\n"; //Slot arrays and entry slabs
+    text += "dict_rehashing_stripes:" + std::to_string(stats.rehashing) + "\r\n";
+    text += "dict_rehash_slots_left:" + std::to_string(stats.slotsLeft) + "\r\n";
+    text += "dict_rehash_progress:" + std::to_string(progress) + "\r\n"; //Percent of the old slots already moved
+    text += "dict_rehashes:" + std::to_string(stats.started) + "\r\n";
+    text += "dict_rehash_moved:" + std::to_string(stats.moved) + "\r\n";
+    return ReplyWriter().bulk(text).take();
+}
+
+
+//Registry, adding a cmd is one line here (plus its Commands value)
+namespace
+{
+    template<auto Fn> OutputBuffer plain(CommandContext&, const std::vector<std::string_view>& args) { return Fn(args); }
+    template<auto Fn> OutputBuffer onStore(CommandContext& ctx, const std::vector<std::string_view>& args) { return Fn(ctx.store, args); }
+    template<auto Fn> OutputBuffer onSession(CommandContext& ctx, const std::vector<std::string_view>& args) { return Fn(ctx.session, args); }
+    template<auto Fn> OutputBuffer onPubSub(CommandContext& ctx, const std::vector<std::string_view>& args) { return Fn(ctx.pubsub, args); }
+    template<auto Fn> OutputBuffer onSubscriber(CommandContext& ctx, const std::vector<std::string_view>& args) { return Fn(ctx.pubsub, args, ctx.session); }
+
+    constexpr unsigned RW = CMD_WRITE, RO = CMD_READONLY, SLOW = CMD_SLOW, OOM = CMD_DENYOOM;
+
+    constexpr CommandInfo commandTable[] = {
+        //name, cmd, arity, flags, firstKey, lastKey, keyStep, handler
+        {"PING", Commands::PING, -1, 0, 0, 0, 0, plain<handlePING>},
+        {"ECHO", Commands::ECHO, 2, 0, 0, 0, 0, plain<handleECHO>},
+        {"DEL", Commands::DEL, -2, RW, 1, -1, 1, onStore<handleDEL>},
+        {"EXISTS", Commands::EXISTS, -2, RO, 1, -1, 1, onStore<handleEXISTS>},
+        {"FLUSHALL", Commands::FLUSHALL, 1, RW | SLOW, 0, 0, 0, onStore<handleFLUSHALL>},
+
+        {"SET", Commands::SET, -3, RW | OOM, 1, 1, 1, onStore<handleSET>},
+        {"GET", Commands::GET, 2, RO, 1, 1, 1, onStore<handleGETPinned>},
+        {"INCR", Commands::INCR, 2, RW | OOM, 1, 1, 1, onStore<handleINCR>},
+        {"DCR", Commands::DCR, 2, RW | OOM, 1, 1, 1, onStore<handleDCR>},
+        {"INCRBY", Commands::INCRBY, 3, RW | OOM, 1, 1, 1, onStore<handleINCRBY>},
+        {"DCRBY", Commands::DCRBY, 3, RW | OOM, 1, 1, 1, onStore<handleDCRBY>},
+        {"MGET", Commands::MGET, -2, RO, 1, -1, 1, onStore<handleMGET>},
+        {"APPEND", Commands::APPEND, 3, RW | OOM, 1, 1, 1, onStore<handleAPPEND>},
+
+        {"EXPIRE", Commands::EXPIRE, 3, RW, 1, 1, 1, onStore<handleEXPIRE>},
+        {"PEXPIRE", Commands::PEXPIRE, 3, RW, 1, 1, 1, onStore<handlePEXPIRE>},
+        {"EXPIREAT", Commands::EXPIREAT, 3, RW, 1, 1, 1, onStore<handleEXPIREAT>},
+        {"PEXPIREAT", Commands::PEXPIREAT, 3, RW, 1, 1, 1, onStore<handlePEXPIREAT>},
+        {"TTL", Commands::TTL, 2, RO, 1, 1, 1, onStore<handleTTL>},
+        {"PTTL", Commands::PTTL, 2, RO, 1, 1, 1, onStore<handlePTTL>},
+        {"PERSIST", Commands::PERSIST, 2, RW, 1, 1, 1, onStore<handlePERSIST>},
+
+        {"LPUSH", Commands::LPUSH, -3, RW | OOM, 1, 1, 1, onStore<handleLPUSH>},
+        {"RPUSH", Commands::RPUSH, -3, RW | OOM, 1, 1, 1, onStore<handleRPUSH>},
+        {"LPOP", Commands::LPOP, 2, RW, 1, 1, 1, onStore<handleLPOP>},
+        {"RPOP", Commands::RPOP, 2, RW, 1, 1, 1, onStore<handleRPOP>},
+        {"LRANGE", Commands::LRANGE, 4, RO | SLOW, 1, 1, 1, onStore<handleLRANGE>},
+        {"LLEN", Commands::LLEN, 2, RO, 1, 1, 1, onStore<handleLLEN>},
+        {"LINDEX", Commands::LINDEX, 3, RO | SLOW, 1, 1, 1, onStore<handleLINDEX>},
+        {"LSET", Commands::LSET, 4, RW | OOM | SLOW, 1, 1, 1, onStore<handleLSET>},
+        {"LREM", Commands::LREM, 4, RW | SLOW, 1, 1, 1, onStore<handleLREM>},
+
+        {"SADD", Commands::SADD, -3, RW | OOM, 1, 1, 1, onStore<handleSADD>},
+        {"SREM", Commands::SREM, -3, RW, 1, 1, 1, onStore<handleSREM>},
+        {"SISMEMBER", Commands::SISMEMBER, 3, RO, 1, 1, 1, onStore<handleSISMEMBER>},
+        {"SMEMBERS", Commands::SMEMBERS, 2, RO | SLOW, 1, 1, 1, onStore<handleSMEMBERS>},
+        {"SCARD", Commands::SCARD, 2, RO, 1, 1, 1, onStore<handleSCARD>},
+        {"SPOP", Commands::SPOP, -2, RW, 1, 1, 1, onStore<handleSPOP>},
+
+        {"HSET", Commands::HSET, -4, RW | OOM, 1, 1, 1, onStore<handleHSET>},
+        {"HGET", Commands::HGET, 3, RO, 1, 1, 1, onStore<handleHGET>},
+        {"HDEL", Commands::HDEL, -3, RW, 1, 1, 1, onStore<handleHDEL>},
+        {"HEXISTS", Commands::HEXISTS, 3, RO, 1, 1, 1, onStore<handleHEXISTS>},
+        {"HLEN", Commands::HLEN, 2, RO, 1, 1, 1, onStore<handleHLEN>},
+        {"HKEYS", Commands::HKEYS, 2, RO | SLOW, 1, 1, 1, onStore<handleHKEYS>},
+        {"HVALS", Commands::HVALS, 2, RO | SLOW, 1, 1, 1, onStore<handleHVALS>},
+        {"HMGET", Commands::HMGET, -3, RO, 1, 1, 1, onStore<handleHMGET>},
+        {"HGETALL", Commands::HGETALL, 2, RO | SLOW, 1, 1, 1, onStore<handleHGETALL>},
+
+        {"PUBLISH", Commands::PUBLISH, 3, CMD_PUBSUB, 0, 0, 0, onPubSub<handlePUBLISH>},
+        {"SUBSCRIBE", Commands::SUBSCRIBE, -2, CMD_PUBSUB, 0, 0, 0, onSubscriber<handleSUBSCRIBE>},
+        {"UNSUBSCRIBE", Commands::UNSUBSCRIBE, -2, CMD_PUBSUB, 0, 0, 0, onSubscriber<handleUNSUBSCRIBE>},
+
+        {"MULTI", Commands::MULTI, 1, 0, 0, 0, 0, onSession<handleMULTI>},
+        {"EXEC", Commands::EXEC, 1, CMD_NOQUEUE | SLOW, 0, 0, 0, nullptr}, //Server runs the queue itself
+        {"DISCARD", Commands::DISCARD, 1, CMD_NOQUEUE, 0, 0, 0, onSession<handleDISCARD>},
+
+        {"CONFIG", Commands::CONFIG, -2, 0, 0, 0, 0, onStore<handleCONFIG>},
+        {"TYPE", Commands::TYPE, 2, RO, 1, 1, 1, onStore<handleTYPE>},
+        {"OBJECT", Commands::OBJECT, 3, RO, 2, 2, 1, onStore<handleOBJECT>},
+        {"SAVE", Commands::SAVE, 1, SLOW, 0, 0, 0, onStore<handleSAVE>},
+        {"INFO", Commands::INFO, -1, 0, 0, 0, 0, onStore<handleINFO>},
+    };
+
+    constexpr size_t CMD_SLOTS = 256; //Power of two, ~5x the cmd count so a seed is found in a few tries
+    constexpr size_t CMD_MAX_NAME = 16;
+
+    constexpr char upper(const char c) { return c >= 'a' && c <= 'z' ? static_cast<char>(c - 32) : c; }
+    constexpr size_t slotOf(const std::string_view name, const uint32_t seed) //FNV-1a over the upper cased name
+    {
+        uint32_t h = 2166136261u ^ seed;
+        for (const char c : name)
+        {
+            h ^= static_cast<unsigned char>(upper(c));
+            h *= 16777619u;
+        }
+        return (h ^ (h >> 15)) & (CMD_SLOTS - 1);
+    }
+
+    struct PerfectHash {
+        uint32_t seed = 0;
+        std::array<uint8_t, CMD_SLOTS> slots{}; //Table index + 1, 0 is empty
+    };
+    consteval PerfectHash buildPerfectHash()
+    {
+        for (uint32_t seed = 0;; ++seed)
+        {
+            PerfectHash ph{seed};
+            bool collision = false;
+            for (size_t i = 0; i < std::size(commandTable) && !collision; ++i)
+            {
+                uint8_t& slot = ph.slots[slotOf(commandTable[i].name, seed)];
+                collision = slot != 0;
+                slot = static_cast<uint8_t>(i + 1);
+            }
+            if (!collision) return ph;
+        }
+    }
+    constexpr PerfectHash perfectHash = buildPerfectHash();
+
+    static_assert(std::size(commandTable) < 255, "slot indexes are one byte");
+    static_assert([] { for (const auto& info : commandTable) if (info.name.size() > CMD_MAX_NAME) return false; return true; }());
+}
+
+const CommandInfo* lookupCommand(const std::string_view name)
+{
+    if (name.empty() || name.size() > CMD_MAX_NAME) return nullptr;
+    const uint8_t slot = perfectHash.slots[slotOf(name, perfectHash.seed)];
+    if (slot == 0) return nullptr;
+
+    const CommandInfo& info = commandTable[slot - 1];
+    if (info.name.size() != name.size()) return nullptr;
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        if (upper(name[i]) != info.name[i]) return nullptr;
+    }
+    return &info;
+}
+
+Commands strToCmd(const std::string_view cmd)
+{
+    const CommandInfo* info = lookupCommand(cmd);
+    return info ? info->cmd : Commands::UNKNOWN;
+}
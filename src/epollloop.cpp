@@ -0,0 +1,205 @@
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+
+#include "epollloop.hpp"
+#include "server.hpp"
+#include "config.h"
+
+EpollLoop::EpollLoop(Server& server, const int listenSock, const int id) : EventLoop(id), server(server), listenSock(listenSock)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) throw std::runtime_error("EpollLoop epoll/eventfd creation failed");
+
+    //Listen sock is shared by all loops, EPOLLEXCLUSIVE wakes only one of them per connection
+    epoll_event listenEvent{};
+    listenEvent.events = EPOLLIN | EPOLLEXCLUSIVE;
+    listenEvent.data.fd = listenSock;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSock, &listenEvent) != 0) throw std::runtime_error("EpollLoop listen registration failed");
+
+    epoll_event wakeEvent{};
+    wakeEvent.events = EPOLLIN;
+    wakeEvent.data.fd = wakeFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &wakeEvent) != 0) throw std::runtime_error("EpollLoop wake registration failed");
+}
+
+EpollLoop::~EpollLoop()
+{
+    while (!sessions.empty()) closeSession(sessions.begin()->second.get());
+    close(wakeFd);
+    close(epollFd);
+}
+
+void EpollLoop::run()
+{
+    epoll_event events[EPOLL_BATCH];
+    while (running)
+    {
+        const int ready = epoll_wait(epollFd, events, EPOLL_BATCH, -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: " << errno << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < ready; ++i)
+        {
+            const int fd = events[i].data.fd;
+            if (fd == wakeFd)
+            {
+                uint64_t count;
+                [[maybe_unused]] auto drained = read(wakeFd, &count, sizeof(count));
+                if (!running) continue;
+                deliverPosted();
+                if (wakeHandler) wakeHandler();
+                continue;
+            }
+            if (fd == listenSock)
+            {
+                acceptAll();
+                continue;
+            }
+
+            const auto found = sessions.find(fd);
+            if (found == sessions.end()) continue; //Closed earlier in this batch
+            Session* session = found->second.get();
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                closeSession(session);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT && !writeOut(session))
+            {
+                closeSession(session);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP)) handleReadable(session);
+        }
+    }
+}
+
+void EpollLoop::stop()
+{
+    running = false;
+    wake();
+}
+
+void EpollLoop::wake()
+{
+    constexpr uint64_t one = 1;
+    [[maybe_unused]] auto written = write(wakeFd, &one, sizeof(one));
+}
+
+void EpollLoop::flush(Session* session)
+{
+    if (!writeOut(session)) closeSession(session);
+}
+
+void EpollLoop::acceptAll()
+{
+    while (true)
+    {
+        sockaddr_in connectionAddress{};
+        socklen_t addLen = sizeof(connectionAddress);
+        const int connectionSock = accept4(listenSock, reinterpret_cast<sockaddr*>(&connectionAddress), &addLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (connectionSock < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) std::cerr << "accept failed: " << errno << std::endl;
+            return;
+        }
+
+        std::cout << "New connection from sock: " << connectionSock << std::endl;
+        auto session = std::make_unique<Session>(connectionSock, inet_ntoa(connectionAddress.sin_addr), this);
+
+        //Registered once for both directions, edge triggered so EPOLLOUT only fires when the socket drains
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = connectionSock;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, connectionSock, &event) != 0)
+        {
+            std::cerr << "epoll_ctl add failed for sock: " << connectionSock << std::endl;
+            close(connectionSock);
+            continue;
+        }
+        sessions.emplace(connectionSock, std::move(session));
+    }
+}
+
+void EpollLoop::handleReadable(Session* session)
+{
+    while (true)
+    {
+        //Straight into the session buffer, or into the value itself while a large bulk is being received
+        const std::span<char> direct = session->readBuffer.empty() ? session->parser.directTarget() : std::span<char>();
+        char* target = direct.empty() ? session->readBuffer.prepare(READ_CHUNK) : direct.data();
+        const size_t room = direct.empty() ? session->readBuffer.writable() : direct.size();
+        const ssize_t bytesRead = recv(session->clientSock, target, room, 0);
+        if (bytesRead == 0)
+        {
+            writeOut(session); //Best effort for replies to whatever came before the FIN
+            closeSession(session);
+            return;
+        }
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break; //Drained
+            closeSession(session);
+            return;
+        }
+
+        if (direct.empty()) session->readBuffer.commit(bytesRead);
+        else session->parser.directFilled(bytesRead);
+        try
+        {
+            server.processInput(session);
+        } catch (const std::exception& e) {
+            std::cerr << "Error during communication: " << e.what() << std::endl;
+            closeSession(session);
+            return;
+        }
+    }
+    flush(session);
+}
+
+bool EpollLoop::writeOut(Session* session)
+{
+    iovec iov[IOV_BATCH];
+    while (!session->writeBuffer.empty())
+    {
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = session->writeBuffer.fillIov(iov, IOV_BATCH);
+        const ssize_t sent = sendmsg(session->clientSock, &message, MSG_NOSIGNAL); //writev without SIGPIPE
+        if (sent < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break; //Rest goes out on the next EPOLLOUT
+            return false;
+        }
+        session->writeBuffer.consume(sent); //Short writes keep the unsent tail queued
+    }
+    return true;
+}
+
+void EpollLoop::closeSession(Session* session)
+{
+    const int clientSock = session->clientSock;
+    server.onDisconnect(session);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, clientSock, nullptr);
+    close(clientSock);
+    std::cout << "Closed connection from sock: " << clientSock << std::endl;
+    sessions.erase(clientSock);
+}
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "eventloop.hpp"
+#include "epollloop.hpp"
+#include "uringloop.hpp"
+#include "session.hpp"
+
+std::optional<IOBackend> strToIOBackend(const std::string_view name)
+{
+    if (name == "epoll") return IOBackend::EPOLL;
+    if (name == "uring" || name == "io_uring") return IOBackend::URING;
+    return std::nullopt;
+}
+
+void EventLoop::post(Session* session, std::shared_ptr<const std::string> bytes)
+{
+    bool first;
+    {
+        std::lock_guard lock(postLock);
+        first = posted.empty();
+        posted.emplace_back(session, std::move(bytes));
+    }
+    if (first) wake(); //Later posts ride on the same wake
+}
+
+void EventLoop::dropPosted(Session* session)
+{
+    std::lock_guard lock(postLock);
+    std::erase_if(posted, [session](const auto& item) { return item.first == session; });
+}
+
+void EventLoop::deliverPosted()
+{
+    decltype(posted) batch;
+    {
+        std::lock_guard lock(postLock);
+        batch.swap(posted);
+    }
+    if (batch.empty()) return;
+
+    //Queued whole behind the replies already there, then each session is flushed once, which may close it but no other
+    std::unordered_set<Session*> touched;
+    for (auto& [session, bytes] : batch)
+    {
+        session->writeBuffer.append(std::move(bytes));
+        touched.insert(session);
+    }
+    for (Session* session : touched) flush(session);
+}
+
+std::unique_ptr<EventLoop> EventLoop::create(const IOBackend backend, Server& server, const int listenSock, const int id)
+{
+    if (backend == IOBackend::URING)
+    {
+        try
+        {
+            return std::make_unique<UringLoop>(server, listenSock, id);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "io_uring unavailable (" << e.what() << "), falling back to epoll" << std::endl;
+        }
+    }
+    return std::make_unique<EpollLoop>(server, listenSock, id);
+}
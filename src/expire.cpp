@@ -1,71 +1,55 @@
 #include "expire.hpp"
 
 #include <string>
-#include <unordered_map>
-#include <chrono>
-#include <tbb/concurrent_hash_map.h>
-#include <mutex>
+#include <vector>
 
 
-//TODO expiration is not persistent, meaning keys with ttl lose the ttl and are just saved
-
-void Expiration::setExpiry(const std::string& key, int seconds)
+void Expiration::set(std::string_view key, Deadline deadline)
 {
-    tbb::concurrent_hash_map<std::string, std::chrono::steady_clock::time_point>::accessor accessor;
-
-    auto val  = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
-    if (!expTable.find(accessor, key)) expTable.insert(accessor, key);
-
-    accessor->second = val;
+    Dict<TimerNode>::accessor accessor;
+    expTable.insert(accessor, key);
+    std::lock_guard lock(wheelLock);
+    wheel.arm(accessor->second, deadline);
 }
 
-int Expiration::getTTL(const std::string& key)
+std::vector<std::string> Expiration::expiredKeys(Deadline now) const
 {
-    tbb::concurrent_hash_map<std::string, std::chrono::steady_clock::time_point>::accessor accessor;
-
-    if (!expTable.find(accessor, key)) return -1;
-
-    const auto dur = accessor->second - std::chrono::steady_clock::now();
-    return static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(dur).count());
+    std::vector<std::string> expired;
+    expTable.forEach([&expired, now](const Dict<TimerNode>::Entry& entry)
+    {
+        if (now >= entry.second.deadline) expired.emplace_back(entry.key());
+    });
+    return expired;
 }
 
-void Expiration::removeAllExp()
+std::vector<std::string> Expiration::popDue(Deadline now, size_t limit)
 {
-    for (auto i = expTable.begin(); i != expTable.end();)
-    {
-        tbb::concurrent_hash_map<std::string, std::chrono::steady_clock::time_point>::accessor accessor;
-        const std::string& key = i->first;
-
-        if (expTable.find(accessor, key) && std::chrono::steady_clock::now() >= accessor->second)
-        {
-            expTable.erase(accessor);
-        }
-        ++i;
-    }
+    std::vector<std::string> due;
+    std::lock_guard lock(wheelLock); //An armed node's entry can't be freed meanwhile, erase() disarms under this lock first
+    wheel.advance(now, limit, [&due](const TimerNode& node) { due.emplace_back(Dict<TimerNode>::entryOf(node).key()); });
+    return due;
 }
 
-std::optional<std::string> Expiration::removeKeyExp(const std::string& key)
+int64_t Expiration::wheelLag(Deadline now) const
 {
-    tbb::concurrent_hash_map<std::string, std::chrono::steady_clock::time_point>::accessor accessor;
-    if (expTable.find(accessor, key) && std::chrono::steady_clock::now() >= accessor->second)
-    {
-        auto keyCopy = accessor->first;
-        expTable.erase(accessor);
-        return keyCopy;
-    }
-    return std::nullopt;
+    std::lock_guard lock(wheelLock);
+    return wheel.lag(now);
 }
 
-void Expiration::erase(const std::string& key)
+void Expiration::erase(std::string_view key)
 {
-    expTable.erase(key);
+    Dict<TimerNode>::accessor accessor;
+    if (!expTable.find(accessor, key)) return;
+    {
+        std::lock_guard lock(wheelLock);
+        wheel.disarm(accessor->second);
+    }
+    expTable.erase(accessor);
 }
 
 void Expiration::clear()
 {
-    expTable.clear();
+    std::vector<std::string> keys; //One by one, so every timer is off the wheel before its entry goes
+    expTable.forEach([&keys](const Dict<TimerNode>::Entry& entry) { keys.emplace_back(entry.key()); });
+    for (const auto& key : keys) erase(key);
 }
-
-
-
-
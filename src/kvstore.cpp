@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <iterator>
+#include <limits>
 #include <utility>
 #include <boost/variant.hpp>
 
@@ -8,14 +12,16 @@
 #include "respvalue.hpp"
 #include "expire.hpp"
 
-KVStore::KVStore(const bool persist, const std::string& fileName, const int maxKeys) : persistenceToggle(persist), snapshotManager(fileName), maxSize(static_cast<size_t>(maxKeys))
+KVStore::KVStore(const bool persist, const std::string& fileName, const unsigned shares)
+    : persistenceToggle(persist), snapshotManager(fileName), shares(std::max(1u, shares)), policy(*policyFromName(MAXMEMORY_POLICY))
 {
     if (persistenceToggle) loadFromDisk();
-    for (auto& [k,v] : dict)
+    const uint32_t now = tracksLFU(evictionPolicy()) ? lfuStamp(LFU_INIT_VAL) : lruClock();
+    dict.forEach([this, now](const Dict<Object>::Entry& entry)
     {
-        lruManager.touch(k);
-        currSize.fetch_add(1);
-    }
+        entry.second.touch(now);
+        usedBytes.fetch_add(Dict<Object>::entryBytes(entry.keyLen) + entry.second.memoryUsage(), std::memory_order_relaxed);
+    });
 }
 
 KVStore::~KVStore()
@@ -23,44 +29,136 @@ KVStore::~KVStore()
     if (persistenceToggle) saveToDisk();
 }
 
-std::optional<storeType> KVStore::getType(const std::string& k)
+std::optional<EvictionPolicy> policyFromName(const std::string_view name)
+{
+    const auto row = std::ranges::find(EVICTION_POLICIES, name, &EvictionPolicyInfo::name);
+    if (row == std::end(EVICTION_POLICIES)) return std::nullopt;
+    return row->policy;
+}
+std::string_view policyName(const EvictionPolicy policy)
+{
+    return policyInfo(policy).name;
+}
+
+std::optional<storeType> KVStore::getType(std::string_view k)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::const_accessor accessor;
-    checkExpKey(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return std::nullopt;
-    return accessor->second.type;
+    if (!findLive(accessor, k)) return std::nullopt;
+    return accessor->second.type();
 }
-std::optional<std::string> KVStore::checkTypeError(const std::string& k, const storeType expected)
+std::optional<int> KVStore::frequency(std::string_view k)
 {
-    auto type = this->getType(k);
-    if (type && *type != expected) return "-ERR wrong type\r\n";
-    return std::nullopt;
+    Dict<Object>::const_accessor accessor;
+
+    if (!findLive(accessor, k)) return std::nullopt;
+    return lfuCounter(accessor->second.lruClock(), lfuMinutes());
 }
-void KVStore::checkExpKey(const std::string& k)
+std::optional<long long> KVStore::idleSeconds(std::string_view k)
 {
-    if (const auto removed = expirationManager.removeKeyExp(k))
-    {
-        lruManager.erase(removed.value());
-        dict.erase(removed.value());
-    }
+    Dict<Object>::const_accessor accessor;
+
+    if (!findLive(accessor, k)) return std::nullopt;
+    return static_cast<long long>(idleTicks(accessor->second.lruClock(), lruClock())) * LRU_CLOCK_RESOLUTION_MS / 1000;
+}
+void KVStore::checkExpKey(std::string_view k)
+{
+    Dict<Object>::accessor accessor;
+    findLive(accessor, k);
 }
-bool KVStore::spaceLeft() const
+
+bool KVStore::makeRoom()
 {
-    size_t currKeyCount = currSize.load();
-    std::cout << "Using: " << currSize.load() << " keys Max allowed: " << maxSize << std::endl; //TODO rem only for demo
-    return currKeyCount < maxSize;
+    if (maxMemory() == 0) return true;
+    const size_t budget = std::max<size_t>(1, maxMemory() / shares);
+    if (usedMemory() <= budget) return true;
+    const EvictionPolicy current = evictionPolicy();
+    const EvictionPolicyInfo& info = policyInfo(current);
+    if (info.order == EvictionOrder::NONE) return false;
+
+    std::lock_guard lock(evictLock);
+    if (current != poolPolicy) //Scores from another policy don't compare
+    {
+        evictionPool.clear();
+        poolPolicy = current;
+    }
+    while (usedMemory() > budget)
+    {
+        std::optional<std::string> victim;
+        if (info.order == EvictionOrder::RANDOM) victim = randomKey(info.volatileOnly);
+        else if (fillPool(info)) victim = evictionPool.takeBest();
+        if (!victim) return false; //Nothing (with a ttl, for volatile policies) left to evict
+        if (info.volatileOnly && !expirationManager.contains(*victim)) continue; //Persisted since it was sampled
+
+        if (Dict<Object>::accessor accessor; dict.find(accessor, *victim))
+        {
+            removeKey(accessor, *victim);
+            evictions[static_cast<size_t>(current)].fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (info.volatileOnly) expirationManager.erase(*victim); //A ttl left behind by a key that is gone, so it isn't sampled again
+    }
+    return true;
 }
-void KVStore::evictTill()
+bool KVStore::fillPool(const EvictionPolicyInfo& info)
 {
-    while (!spaceLeft())
+    const bool lfu = info.order == EvictionOrder::LFU;
+    const uint32_t now = lfu ? lfuMinutes() : lruClock();
+    const auto score = [lfu, now](const uint32_t stamp) -> uint32_t { return lfu ? 255 - lfuCounter(stamp, now) : idleTicks(stamp, now); }; //Least used or most idle scores highest
+    if (!info.volatileOnly)
     {
-        std::string evicted = lruManager.evict();
-        currSize.fetch_sub(1);
-        std::cout << "Evicted: " << evicted << std::endl; //TODO rem only for demo
-        dict.erase(evicted);
+        return dict.sample(maxMemorySamples(), rng(), [&](const Dict<Object>::Entry& entry) { evictionPool.offer(entry.key(), score(entry.second.lruClock())); }) != 0;
     }
-} //TODO change to maybe get actual value of needed deletions and delete as needed and not loop
+
+    std::vector<std::pair<std::string, Expiration::Deadline>> sampled; //Copied out first, a ttl stripe is never held while taking a dict one
+    expirationManager.sample(maxMemorySamples(), rng(), [&sampled](const std::string_view k, const Expiration::Deadline deadline) { sampled.emplace_back(k, deadline); });
+    const int64_t clockNow = CoarseClock::nowMs();
+    for (const auto& [k, deadline] : sampled)
+    {
+        if (info.order == EvictionOrder::TTL) //Soonest deadline scores highest
+        {
+            const int64_t left = deadline - clockNow;
+            evictionPool.offer(k, std::numeric_limits<uint32_t>::max() - static_cast<uint32_t>(std::clamp<long long>(left, 0, std::numeric_limits<uint32_t>::max())));
+            continue;
+        }
+        Dict<Object>::const_accessor accessor;
+        evictionPool.offer(k, dict.find(accessor, k) ? score(accessor->second.lruClock()) : std::numeric_limits<uint32_t>::max()); //Gone keys come out first and get their ttl dropped
+    }
+    return !sampled.empty();
+}
+std::optional<std::string> KVStore::randomKey(const bool volatileOnly)
+{
+    std::optional<std::string> key;
+    if (volatileOnly) expirationManager.sample(1, rng(), [&key](const std::string_view k, Expiration::Deadline) { key.emplace(k); });
+    else dict.sample(1, rng(), [&key](const Dict<Object>::Entry& entry) { key.emplace(entry.key()); });
+    return key;
+}
+Object& KVStore::addKey(Dict<Object>::accessor& accessor, const std::string_view k, Object value)
+{
+    dict.insert(accessor, k);
+    accessor->second = std::move(value);
+    accessor->second.touch(tracksLFU(evictionPolicy()) ? lfuStamp(LFU_INIT_VAL) : lruClock());
+    usedBytes.fetch_add(Dict<Object>::entryBytes(k.size()) + accessor->second.memoryUsage(), std::memory_order_relaxed);
+    return accessor->second;
+}
+void KVStore::removeKey(Dict<Object>::accessor& accessor, const std::string_view k)
+{
+    usedBytes.fetch_sub(Dict<Object>::entryBytes(k.size(), accessor->hasDeadline()) + accessor->second.memoryUsage(), std::memory_order_relaxed);
+    if (accessor->hasDeadline()) expirationManager.erase(k);
+    dict.erase(accessor);
+}
+void KVStore::armDeadline(Dict<Object>::accessor& accessor, const std::string_view k, const int64_t deadline)
+{
+    if (!accessor->hasDeadline()) charge(Dict<Object>::entryBytes(k.size()), Dict<Object>::entryBytes(k.size(), true));
+    dict.setDeadline(accessor, deadline);
+    expirationManager.set(k, deadline); //Under the key's stripe, so the wheel can't disagree with the entry
+}
+void KVStore::dropDeadline(Dict<Object>::accessor& accessor, const std::string_view k)
+{
+    if (!accessor->hasDeadline()) return;
+    charge(Dict<Object>::entryBytes(k.size(), true), Dict<Object>::entryBytes(k.size()));
+    dict.clearDeadline(accessor);
+    expirationManager.erase(k);
+}
 
 void KVStore::loadFromDisk()
 {
@@ -74,7 +172,7 @@ void KVStore::loadFromDisk()
 }
 void KVStore::saveToDisk()
 {
-    expirationManager.removeAllExp();
+    for (const auto& k : expirationManager.expiredKeys(CoarseClock::preciseMs())) checkExpKey(k); //Expired keys are not saved
     try
     {
         snapshotManager.save(dict);
@@ -84,30 +182,79 @@ void KVStore::saveToDisk()
     }
 }
 
-int KVStore::del(const std::vector<std::string>& args)
+bool KVStore::rehashStep()
+{
+    return dict.rehashFor(std::chrono::microseconds(REHASH_CRON_US));
+}
+size_t KVStore::activeExpireCycle() //Like Redis' activeExpireCycle, but the wheel hands over exactly the due keys instead of sampling for them
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto budgetEnd = start + std::chrono::microseconds(ACTIVE_EXPIRE_CYCLE_US);
+    size_t removed = 0;
+    bool capped = false;
+    while (true)
+    {
+        const auto due = expirationManager.popDue(CoarseClock::nowMs(), ACTIVE_EXPIRE_BATCH); //Copied out, the wheel lock is never held while taking a dict stripe
+        for (const auto& k : due)
+        {
+            Dict<Object>::accessor accessor;
+            if (!dict.find(accessor, k))
+            {
+                expirationManager.erase(k); //Left behind by a flush racing the ttl
+                continue;
+            }
+            if (!expired(*accessor)) continue; //Given a new ttl (back on the wheel) or none since it was popped
+            removeKey(accessor, k);
+            ++removed;
+        }
+        if (due.size() < ACTIVE_EXPIRE_BATCH) break; //Caught up with the clock
+        if (std::chrono::steady_clock::now() >= budgetEnd)
+        {
+            capped = true;
+            break;
+        }
+    }
+
+    const auto micros = static_cast<size_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    expiredKeys.fetch_add(removed, std::memory_order_relaxed);
+    expireCycles.fetch_add(1, std::memory_order_relaxed);
+    expireCycleMicros.fetch_add(micros, std::memory_order_relaxed);
+    lastExpireCycleMicros.store(micros, std::memory_order_relaxed);
+    if (capped) expireTimeCapReached.fetch_add(1, std::memory_order_relaxed);
+    expireLag.store(capped ? expirationManager.wheelLag(CoarseClock::nowMs()) : 0, std::memory_order_relaxed);
+    return removed;
+}
+KVStore::ExpireStats KVStore::expireStats() const
+{
+    ExpireStats stats;
+    stats.expired = expiredKeys.load(std::memory_order_relaxed);
+    stats.cycles = expireCycles.load(std::memory_order_relaxed);
+    stats.cycleMicros = expireCycleMicros.load(std::memory_order_relaxed);
+    stats.lastCycleMicros = lastExpireCycleMicros.load(std::memory_order_relaxed);
+    stats.timeCapReached = expireTimeCapReached.load(std::memory_order_relaxed);
+    stats.lagMs = expireLag.load(std::memory_order_relaxed);
+    return stats;
+}
+
+int KVStore::del(const std::vector<std::string_view>& args)
 {
     int deleted = 0;
     for (const auto& k : args)
     {
-        checkExpKey(k); //Only done to give true expected delete count
-        expirationManager.erase(k);
-        if (tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor; dict.find(accessor, k))
+        if (Dict<Object>::accessor accessor; findLive(accessor, k)) //An expired key doesn't count as deleted
         {
-            dict.erase(accessor);
-            currSize.fetch_sub(1);
-            lruManager.erase(k);
+            removeKey(accessor, k);
             deleted++;
         }
     }
     return deleted;
 }
-int KVStore::exists(const std::vector<std::string>& args)
+int KVStore::exists(const std::vector<std::string_view>& args)
 {
     int exist = 0;
     for (const auto& k : args)
     {
-        checkExpKey(k);
-        if (tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor; dict.find(accessor, k))
+        if (Dict<Object>::const_accessor accessor; findLive(accessor, k))
         {
             exist++;
         }
@@ -117,518 +264,629 @@ int KVStore::exists(const std::vector<std::string>& args)
 void KVStore::flushall()
 {
     expirationManager.clear();
-    lruManager.clear();
+    {
+        std::lock_guard lock(evictLock);
+        evictionPool.clear();
+    }
     dict.clear();
+    usedBytes.store(0, std::memory_order_relaxed);
     if (persistenceToggle) saveToDisk();
 }
 
-bool KVStore::set(const std::string& k, const std::string& v)
+bool KVStore::set(std::string_view k, std::string_view v)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
-    const auto val = RESPValue{storeType::STR, v};
-    if (!dict.find(accessor, k))
-    {
-        if (!spaceLeft()) evictTill();
-        dict.insert(accessor, k);
-        currSize.fetch_add(1);
-    }
-    accessor->second = val;
-    expirationManager.erase(k);
+    putString(accessor, lookup(accessor, k), k, v);
+    dropDeadline(accessor, k); //SET clears the ttl
     return true;
 }
-std::optional<std::string> KVStore::get(const std::string& k)
+KVStore::SetResult KVStore::set(std::string_view k, std::string_view v, const SetOptions& options)
 {
-    try
-    {
-        tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-        checkExpKey(k);
-        lruManager.touch(k);
+    SetResult result;
+    Dict<Object>::accessor accessor;
 
-        if (!dict.find(accessor, k)) return std::nullopt;
-        return boost::get<std::string>(accessor->second.value);
-    }
-    catch (std::exception& e) {
-        std::cerr << "Fail in get: " << e.what() << std::endl;
-        return std::nullopt;
+    const bool found = lookup(accessor, k);
+    if (found && accessor->second.type() != storeType::STR)
+    {
+        result.wrongType = true;
+        return result;
     }
+    if (found && options.get) result.old.emplace(accessor->second.str());
+    if ((options.condition == SetOptions::Condition::NX && found) || (options.condition == SetOptions::Condition::XX && !found)) return result;
+
+    putString(accessor, found, k, v);
+    if (options.deadline) armDeadline(accessor, k, *options.deadline);
+    else if (!options.keepTtl) dropDeadline(accessor, k);
+    result.written = true;
+    return result;
 }
-std::optional<int> KVStore::incr(const std::string& k)
+void KVStore::putString(Dict<Object>::accessor& accessor, const bool found, const std::string_view k, const std::string_view v)
 {
-    int ret = 0;
-
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
-
-    if (!dict.find(accessor, k))
+    auto val = Object::str(v);
+    if (!found)
     {
-        if (!spaceLeft()) evictTill();
-        dict.insert({k,RESPValue{storeType::STR, "1"}});
-        currSize.fetch_add(1);
-        return 1;
+        addKey(accessor, k, std::move(val));
+        return;
     }
-    //else
-    const auto val = boost::get<std::string>(accessor->second.value);
-
-    try{ ret = std::stoi(val); }
-    catch (std::exception& e) {
-        std::cerr << "Fail in incr(" << val << "): " << e.what() << std::endl;
-        return std::nullopt;
-    }
-
-    ret++;
-    accessor->second.value = std::string(std::to_string(ret));
-    return ret;
+    const size_t before = accessor->second.memoryUsage();
+    const uint32_t stamp = accessor->second.lruClock(); //Overwriting keeps the access history, the new value came with a zero clock
+    accessor->second = std::move(val);
+    accessor->second.touch(stamp);
+    charge(before, accessor->second.memoryUsage());
 }
-std::optional<int> KVStore::dcr(const std::string& k)
+KVStore::Typed<std::optional<std::string>> KVStore::get(std::string_view k)
 {
-    int ret = 0;
-
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
-
-    if (!dict.find(accessor, k))
+    try
     {
-        if (!spaceLeft()) evictTill();
-        dict.insert({k,RESPValue{storeType::STR, "-1"}});
-        currSize.fetch_add(1);
-        return -1;
-    }
-    //else
-    const auto val = boost::get<std::string>(accessor->second.value);
+        Dict<Object>::const_accessor accessor;
 
-    try{ ret = std::stoi(val); }
+        if (!lookup(accessor, k)) return std::nullopt;
+        if (accessor->second.type() != storeType::STR) return WrongType{};
+        return std::string(accessor->second.str());
+    }
     catch (std::exception& e) {
-        std::cerr << "Fail in dcr(" << val << "): " << e.what() << std::endl;
+        std::cerr << "Fail in get: " << e.what() << std::endl;
         return std::nullopt;
     }
-
-    ret--;
-    accessor->second.value = std::string(std::to_string(ret));
-    return ret;
 }
-std::optional<int> KVStore::incrby(const std::string& k, const int& count)
+std::shared_ptr<const std::string> KVStore::getInto(std::string_view k, ReplyWriter& out)
 {
-    int ret = 0;
+    Dict<Object>::const_accessor accessor;
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
-
-    if (!dict.find(accessor, k))
+    if (!lookup(accessor, k))
     {
-        if (!spaceLeft()) evictTill();
-        dict.insert({k,RESPValue{storeType::STR, std::to_string(count)}});
-        currSize.fetch_add(1);
-        return count;
+        out.raw(RESP_NIL);
+        return nullptr;
     }
-    //else
-    const auto val = boost::get<std::string>(accessor->second.value);
-
-    try{ ret = std::stoi(val); }
-    catch (std::exception& e) {
-        std::cerr << "Fail in incrby(" << val << "): " << e.what() << std::endl;
-        return std::nullopt;
+    const Object& obj = accessor->second;
+    if (obj.type() != storeType::STR)
+    {
+        out.raw(RESP_WRONG_TYPE);
+        return nullptr;
     }
-
-    ret = ret + count;
-    accessor->second.value = std::string(std::to_string(ret));
-    return ret;
+    if (auto shared = obj.sharedStr())
+    {
+        out.bulkHeader(shared->size());
+        return shared;
+    }
+    obj.readStr([&out](const std::string_view v) { out.bulk(v); });
+    return nullptr;
 }
-std::optional<int> KVStore::dcrby(const std::string& k, const int& count)
+KVStore::Typed<std::optional<long long>> KVStore::incr(std::string_view k)
 {
-    int ret = 0;
-
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    return addInt(k, 1);
+}
+KVStore::Typed<std::optional<long long>> KVStore::dcr(std::string_view k)
+{
+    return addInt(k, -1);
+}
+KVStore::Typed<std::optional<long long>> KVStore::incrby(std::string_view k, long long count)
+{
+    return addInt(k, count);
+}
+KVStore::Typed<std::optional<long long>> KVStore::dcrby(std::string_view k, long long count)
+{
+    if (count == std::numeric_limits<long long>::min()) return std::nullopt; //Negating it would overflow
+    return addInt(k, -count);
+}
+KVStore::Typed<std::optional<long long>> KVStore::addInt(std::string_view k, long long delta)
+{
+    Dict<Object>::accessor accessor;
 
-    if (!dict.find(accessor, k))
+    if (!lookup(accessor, k))
     {
-        if (!spaceLeft()) evictTill();
-        dict.insert({k,RESPValue{storeType::STR, std::to_string(-count)}});
-        currSize.fetch_add(1);
-        return -count;
+        addKey(accessor, k, Object::integer(delta));
+        return delta;
     }
     //else
-    const auto val = boost::get<std::string>(accessor->second.value);
-
-    try{ ret = std::stoi(val); }
-    catch (std::exception& e) {
-        std::cerr << "Fail in dcrby(" << val << "): " << e.what() << std::endl;
-        return std::nullopt;
-    }
-
-    ret = ret - count;
-    accessor->second.value = std::string(std::to_string(ret));
+    if (accessor->second.type() != storeType::STR) return WrongType{};
+    const auto val = accessor->second.toInt(); //Raw int64 for INT, strings are parsed once and stored back as INT
+    long long ret = 0;
+    if (!val || __builtin_add_overflow(*val, delta, &ret)) return std::nullopt;
+
+    const size_t before = accessor->second.memoryUsage();
+    accessor->second.setInt(ret);
+    charge(before, accessor->second.memoryUsage());
     return ret;
 }
-std::vector<std::optional<std::string>> KVStore::mget(const std::vector<std::string>& args)
+std::vector<std::optional<std::string>> KVStore::mget(const std::vector<std::string_view>& args)
 {
     std::vector<std::optional<std::string>> ret;
     for (const auto& i : args)
     {
-        // checkExpKey(i); //Commented out because get already does it
-        // lruManager.touch(i);
-        if (auto err = checkTypeError(i, storeType::STR))
-        {
-            ret.emplace_back(std::nullopt);
-        }
-        else
-        {
-            ret.push_back(get(i));
-        }
+        ret.push_back(std::move(get(i).value)); //nullopt for another type too, like Redis
     }
     return ret;
 }
-int KVStore::append(const std::string& k, const std::string& v)
+KVStore::Typed<int> KVStore::append(std::string_view k, std::string_view v)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
-    if (!dict.find(accessor, k))
+    if (!lookup(accessor, k))
     {
-        if (!spaceLeft()) evictTill();
-        dict.insert({k, {storeType::STR, v}});
-        currSize.fetch_add(1);
+        addKey(accessor, k, Object::str(v));
         return static_cast<int>(v.length());
     }
+    if (accessor->second.type() != storeType::STR) return WrongType{};
 
-    auto& val = boost::get<std::string>(accessor->second.value);
-    val += v;
-
-    return static_cast<int>(boost::get<std::string>(accessor->second.value).size());
+    const size_t before = accessor->second.memoryUsage();
+    const size_t len = accessor->second.append(v);
+    charge(before, accessor->second.memoryUsage());
+    return static_cast<int>(len);
 }
 
-bool KVStore::expire(const std::string& k, const int s)
+bool KVStore::expire(std::string_view k, const int s)
+{
+    return expireAt(k, CoarseClock::nowMs() + static_cast<int64_t>(s) * 1000);
+}
+bool KVStore::expireAt(std::string_view k, const int64_t deadline)
 {
-    if (tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor; !dict.find(accessor, k)) return false;
-    expirationManager.setExpiry(k, s);
+    Dict<Object>::accessor accessor;
+    if (!findLive(accessor, k)) return false;
+
+    armDeadline(accessor, k, deadline);
     return true;
 }
-int KVStore::ttl(const std::string& k)
+int KVStore::ttl(std::string_view k)
+{
+    const long long ms = pttl(k);
+    return static_cast<int>(ms < 0 ? ms : (ms + 500) / 1000); //Rounded like Redis
+}
+long long KVStore::pttl(std::string_view k)
 {
-    checkExpKey(k);
-    if (tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor; !dict.find(accessor, k)) return -2;
-    return expirationManager.getTTL(k);
+    Dict<Object>::const_accessor accessor;
+    if (!findLive(accessor, k)) return -2;
+    if (!accessor->hasDeadline()) return -1;
+    return std::max<long long>(0, accessor->deadline() - CoarseClock::nowMs());
 }
-bool KVStore::persist(const std::string& k)
+bool KVStore::persist(std::string_view k)
 {
-    checkExpKey(k);
-    if (tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor; !dict.find(accessor, k)) return false;
+    Dict<Object>::accessor accessor;
+    if (!findLive(accessor, k) || !accessor->hasDeadline()) return false;
 
-    expirationManager.erase(k);
+    dropDeadline(accessor, k);
     return true;
 }
 
-int KVStore::lpush(const std::vector<std::string>& args)
+//Listpack upkeep for the container commands: an element too long for it unpacks before it goes in, too many entries unpack after
+template<class It> static void unpackForValues(Object& obj, It first, const It last)
+{
+    if (obj.encoding() != Encoding::LISTPACK) return;
+    for (; first != last; ++first)
+    {
+        if (first->size() > LISTPACK_MAX_VALUE) return obj.unpack();
+    }
+}
+static void unpackIfFull(Object& obj, const size_t perEntry = 1) //perEntry is 2 for hashes, field and value
+{
+    if (obj.encoding() == Encoding::LISTPACK && obj.listpack().size() / perEntry > LISTPACK_MAX_ENTRIES) obj.unpack();
+}
+static bool clampRange(const int size, int& start, int& stop) //LRANGE style indexes to [start, stop] inside the list, false if that is empty
+{
+    start = std::max(0, start < 0 ? size + start : start);
+    stop = std::min(size - 1, stop < 0 ? size + stop : stop);
+    return start <= stop;
+}
+
+KVStore::Typed<int> KVStore::lpush(const std::vector<std::string_view>& args)
 {
-    const std::string& k = args[0];
+    const std::string_view k = args[0];
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
-    if (!dict.find(accessor, k))
+    if (!lookup(accessor, k)) addKey(accessor, k, Object::packed(storeType::LIST));
+    else if (accessor->second.type() != storeType::LIST) return WrongType{};
+    Object& obj = accessor->second;
+    const size_t before = obj.memoryUsage(); //O(1) for lists
+    unpackForValues(obj, args.begin() + 1, args.end());
+
+    int size;
+    if (obj.encoding() == Encoding::LISTPACK)
     {
-        if (!spaceLeft()) evictTill();
-        dict.insert({k,RESPValue{
-            storeType::LIST,
-            std::deque<std::string>(args.rbegin(), args.rend() - 1)
-            }});
-        currSize.fetch_add(1);
-        return static_cast<int>(args.size() - 1);
+        Listpack& lp = obj.listpack();
+        for (auto i = args.begin() + 1; i != args.end(); ++i) lp.pushFront(*i);
+        size = static_cast<int>(lp.size());
+        unpackIfFull(obj);
     }
-    //else
-    auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
-
-    for (auto i = args.rbegin(); i != args.rend() - 1; ++i)
+    else
     {
-        val.push_front(*i);
+        Quicklist& val = obj.quicklist();
+        for (auto i = args.begin() + 1; i != args.end(); ++i)
+        {
+            val.pushFront(*i);
+        }
+        size = static_cast<int>(val.size());
     }
-    return static_cast<int>(val.size());
+    charge(before, obj.memoryUsage());
+    return size;
 }
-int KVStore::rpush(const std::vector<std::string>& args)
+KVStore::Typed<int> KVStore::rpush(const std::vector<std::string_view>& args)
 {
-    const std::string& k = args[0];
+    const std::string_view k = args[0];
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
+    if (!lookup(accessor, k)) addKey(accessor, k, Object::packed(storeType::LIST));
+    else if (accessor->second.type() != storeType::LIST) return WrongType{};
+    Object& obj = accessor->second;
+    const size_t before = obj.memoryUsage(); //O(1) for lists
+    unpackForValues(obj, args.begin() + 1, args.end());
 
-    if (!dict.find(accessor, k))
+    int size;
+    if (obj.encoding() == Encoding::LISTPACK)
     {
-        if (!spaceLeft()) evictTill();
-        dict.insert({k, RESPValue{
-            storeType::LIST,
-            std::deque<std::string>(args.begin() + 1, args.end())
-            }});
-        currSize.fetch_add(1);
-        return static_cast<int>(args.size() - 1);
+        Listpack& lp = obj.listpack();
+        for (auto i = args.begin() + 1; i != args.end(); ++i) lp.pushBack(*i);
+        size = static_cast<int>(lp.size());
+        unpackIfFull(obj);
     }
-    //else
-    auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
-
-    for (auto i = args.begin() + 1; i != args.end(); ++i)
+    else
     {
-        val.push_back(*i);
+        Quicklist& val = obj.quicklist();
+        for (auto i = args.begin() + 1; i != args.end(); ++i)
+        {
+            val.pushBack(*i);
+        }
+        size = static_cast<int>(val.size());
     }
-    return static_cast<int>(val.size());
+    charge(before, obj.memoryUsage());
+    return size;
 }
-std::optional<std::string> KVStore::lpop(const std::string& k)
+KVStore::Typed<std::optional<std::string>> KVStore::lpop(std::string_view k)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
-
-    if (!dict.find(accessor, k)) return std::nullopt;
-    auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
+    Dict<Object>::accessor accessor;
 
-    if (val.empty()) return std::nullopt;
-    std::string ret = val.front();
+    if (!lookup(accessor, k)) return std::nullopt;
+    if (accessor->second.type() != storeType::LIST) return WrongType{};
+    Object& obj = accessor->second;
+    const size_t before = obj.memoryUsage();
+    std::string ret;
+    bool empty = false;
 
-    val.pop_front();
-    if (val.empty())
+    if (obj.encoding() == Encoding::LISTPACK)
+    {
+        Listpack& lp = obj.listpack();
+        if (lp.empty()) return std::nullopt;
+        ret = lp.at(0);
+        lp.erase(0);
+        empty = lp.empty();
+    }
+    else
     {
-        expirationManager.erase(k);
-        dict.erase(accessor);
-        currSize.fetch_sub(1);
-        lruManager.erase(k);
+        Quicklist& val = obj.quicklist();
+        auto front = val.popFront();
+        if (!front) return std::nullopt;
+        ret = std::move(*front);
+        empty = val.size() == 0;
     }
+    charge(before, obj.memoryUsage());
+
+    if (empty) removeKey(accessor, k);
 
     return ret;
 }
-std::optional<std::string> KVStore::rpop(const std::string& k)
+KVStore::Typed<std::optional<std::string>> KVStore::rpop(std::string_view k)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
-
-    if (!dict.find(accessor, k)) return std::nullopt;
-    auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
+    Dict<Object>::accessor accessor;
 
-    if (val.empty()) return std::nullopt;
-    std::string ret = val.back();
+    if (!lookup(accessor, k)) return std::nullopt;
+    if (accessor->second.type() != storeType::LIST) return WrongType{};
+    Object& obj = accessor->second;
+    const size_t before = obj.memoryUsage();
+    std::string ret;
+    bool empty = false;
 
-    val.pop_back();
-    if (val.empty())
+    if (obj.encoding() == Encoding::LISTPACK)
+    {
+        Listpack& lp = obj.listpack();
+        if (lp.empty()) return std::nullopt;
+        ret = lp.at(lp.size() - 1);
+        lp.erase(lp.size() - 1);
+        empty = lp.empty();
+    }
+    else
     {
-        expirationManager.erase(k);
-        dict.erase(accessor);
-        currSize.fetch_sub(1);
-        lruManager.erase(k);
+        Quicklist& val = obj.quicklist();
+        auto back = val.popBack();
+        if (!back) return std::nullopt;
+        ret = std::move(*back);
+        empty = val.size() == 0;
     }
+    charge(before, obj.memoryUsage());
+
+    if (empty) removeKey(accessor, k);
 
     return ret;
 }
-std::vector<std::optional<std::string>> KVStore::lrange(const std::string& k, const int& start, const int& stop)
+KVStore::Typed<std::vector<std::optional<std::string>>> KVStore::lrange(std::string_view k, const int& start, const int& stop)
 {
     std::vector<std::optional<std::string>> ret;
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k))
+    if (!lookup(accessor, k))
     {
         ret.emplace_back(std::nullopt);
         return ret;
     }
     //else
-    auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
+    if (accessor->second.type() != storeType::LIST) return WrongType{};
+    int trueStart = start, trueStop = stop;
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        const Listpack& lp = accessor->second.listpack();
+        if (!clampRange(static_cast<int>(lp.size()), trueStart, trueStop)) return ret;
 
-    int trueStart = start < 0 ? static_cast<int>(val.size()) + start : start;
-    int trueStop = stop < 0 ? static_cast<int>(val.size()) + stop : stop;
-    trueStart = std::max(0, trueStart);
-    trueStop = std::min(static_cast<int>(val.size()) - 1, trueStop);
+        auto it = std::next(lp.begin(), trueStart);
+        for (int i = trueStart; i <= trueStop; ++i, ++it) ret.emplace_back(std::string(*it));
+        return ret;
+    }
+    const Quicklist& val = accessor->second.quicklist();
 
-    if (trueStart > trueStop) return ret;
+    if (!clampRange(static_cast<int>(val.size()), trueStart, trueStop)) return ret;
 
-    for (int i = trueStart; i <= trueStop; ++i) {
-        ret.emplace_back(val[i]);
-    }
+    val.forRange(trueStart, trueStop, [&ret](std::string_view v) { ret.emplace_back(std::string(v)); });
     return ret;
 }
-int KVStore::llen(const std::string& k)
+KVStore::Typed<int> KVStore::llen(std::string_view k)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return 0;
-    const auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return 0;
+    if (accessor->second.type() != storeType::LIST) return WrongType{};
+    if (accessor->second.encoding() == Encoding::LISTPACK) return static_cast<int>(accessor->second.listpack().size());
+    const Quicklist& val = accessor->second.quicklist();
 
     return static_cast<int>(val.size());
 }
-std::optional<std::string> KVStore::lindex(const std::string& k, const int& index)
+KVStore::Typed<std::optional<std::string>> KVStore::lindex(std::string_view k, const int& index)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return std::nullopt;
-    auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return std::nullopt;
+    if (accessor->second.type() != storeType::LIST) return WrongType{};
+    if (index < 0) throw std::out_of_range("lindex"); //Reported as out of range, like the old deque::at
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        const Listpack& lp = accessor->second.listpack();
+        if (static_cast<int>(lp.size()) <= index) return std::nullopt;
+        return std::string(lp.at(index));
+    }
+    const Quicklist& val = accessor->second.quicklist();
 
-    if (static_cast<int>(val.size()) <= index) return std::nullopt;
-    return val.at(index);
+    return val.at(index); //Skips whole nodes by their counts
 }
-bool KVStore::lset(const std::string& k, const int& index, const std::string& v)
+KVStore::Typed<bool> KVStore::lset(std::string_view k, const int& index, std::string_view v)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
-    if (!dict.find(accessor, k)) return false;
-    auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return false;
+    if (accessor->second.type() != storeType::LIST) return WrongType{};
+    Object& obj = accessor->second;
+    const size_t before = obj.memoryUsage();
+    const std::string_view values[] = {v};
+    unpackForValues(obj, std::begin(values), std::end(values));
 
-    if (static_cast<int>(val.size()) <= index || index < 0) return false;
-    val.at(index) = v;
-    return true;
+    bool replaced = false;
+    if (obj.encoding() == Encoding::LISTPACK)
+    {
+        Listpack& lp = obj.listpack();
+        replaced = index >= 0 && index < static_cast<int>(lp.size());
+        if (replaced) lp.replace(index, v);
+    }
+    else replaced = index >= 0 && obj.quicklist().set(index, v);
+    charge(before, obj.memoryUsage());
+    return replaced;
 }
-int KVStore::lrem(const std::string& k, const int& count, const std::string& v)
+KVStore::Typed<int> KVStore::lrem(std::string_view k, const int& count, std::string_view v)
 {
     int removed = 0;
+    bool empty = false;
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
-    if (!dict.find(accessor, k)) return 0;
-    auto& val = boost::get<std::deque<std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return 0;
+    if (accessor->second.type() != storeType::LIST) return WrongType{};
+    const size_t before = accessor->second.memoryUsage();
 
-    if (count > 0)
+    if (accessor->second.encoding() == Encoding::LISTPACK)
     {
-        for (auto i = val.begin(); i != val.end() && removed < count;)
+        Listpack& lp = accessor->second.listpack();
+        std::vector<size_t> hits;
+        size_t i = 0;
+        for (auto it = lp.begin(); it != lp.end(); ++it, ++i)
         {
-            if (*i == v)
-            {
-                i = val.erase(i);
-                removed++;
-            }
-            else ++i;
-        }
-    }
-    else if (count < 0)
-    {
-        for (auto i = val.rbegin(); i != val.rend() && removed < -count;)
-        {
-            if (*i == v)
-            {
-                i = std::deque<std::string>::reverse_iterator(val.erase(std::next(i).base())); //gpt-ed this line whole fck
-                removed++;
-            }
-            else ++i;
+            if (*it == v) hits.push_back(i);
         }
+        if (count > 0 && static_cast<int>(hits.size()) > count) hits.resize(count); //First count from the head
+        else if (count < 0 && static_cast<int>(hits.size()) > -count) hits.erase(hits.begin(), hits.end() + count); //Last -count from the tail
+
+        for (auto j = hits.rbegin(); j != hits.rend(); ++j) lp.erase(*j); //Back to front so the indexes stay valid
+        removed = static_cast<int>(hits.size());
+        empty = lp.empty();
     }
     else
     {
-        for (auto it = val.begin(); it != val.end();)
-        {
-            if (*it == v)
-            {
-                it = val.erase(it);
-                removed++;
-            }
-            else ++it;
-        }
+        Quicklist& val = accessor->second.quicklist();
+        removed = static_cast<int>(val.remove(v, count));
+        empty = val.size() == 0;
     }
+    charge(before, accessor->second.memoryUsage());
 
-    if (val.empty()) {
-        expirationManager.erase(k);
-        dict.erase(accessor);
-        currSize.fetch_sub(1);
-        lruManager.erase(k);
-    }
+    if (empty) removeKey(accessor, k);
 
     return removed;
 }
 
-int KVStore::sadd(const std::vector<std::string>& args)
+KVStore::Typed<int> KVStore::sadd(const std::vector<std::string_view>& args)
 {
     int added = 0;
-    const std::string& k = args[0];
+    const std::string_view k = args[0];
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
-    if (!dict.find(accessor, k))
+    if (!lookup(accessor, k))
     {
-        if (!spaceLeft()) evictTill();
-        dict.insert({k,RESPValue{
-            storeType::SET,
-            std::unordered_set<std::string>(args.begin() + 1, args.end())
-            }});
-        currSize.fetch_add(1);
-        return static_cast<int>(args.size() - 1);
+        const bool allInts = std::all_of(args.begin() + 1, args.end(), [](std::string_view v) { return Object::parseInteger(v).has_value(); });
+        addKey(accessor, k, Object::packed(storeType::SET, allInts ? Encoding::INTSET : Encoding::LISTPACK));
     }
-    //else
-    auto& val = boost::get<std::unordered_set<std::string>>(accessor->second.value);
+    else if (accessor->second.type() != storeType::SET) return WrongType{};
+    Object& obj = accessor->second;
+    const bool packed = obj.encoding() != Encoding::BOXED; //Packed sets are measured whole, boxed ones member by member
+    const size_t before = packed ? obj.memoryUsage() : 0;
+
+    if (obj.encoding() == Encoding::INTSET)
+    {
+        std::vector<long long> ints;
+        ints.reserve(args.size() - 1);
+        for (auto i = args.begin() + 1; i != args.end(); ++i)
+        {
+            const auto n = Object::parseInteger(*i);
+            if (!n) break;
+            ints.push_back(*n);
+        }
+        if (ints.size() == args.size() - 1)
+        {
+            Intset& set = obj.intset();
+            for (const long long n : ints) added += set.insert(n);
+            if (set.size() > INTSET_MAX_ENTRIES) obj.unpack();
+            charge(before, obj.memoryUsage());
+            return added;
+        }
+        //A non integer member ends the intset
+        if (obj.intset().size() + args.size() - 1 <= LISTPACK_MAX_ENTRIES) obj.intsetToListpack();
+        else obj.unpack();
+    }
+    unpackForValues(obj, args.begin() + 1, args.end());
+
+    if (obj.encoding() == Encoding::LISTPACK)
+    {
+        Listpack& lp = obj.listpack();
+        for (auto i = args.begin() + 1; i != args.end(); ++i)
+        {
+            if (lp.find(*i)) continue;
+            lp.pushBack(*i);
+            added++;
+        }
+        unpackIfFull(obj);
+        charge(before, obj.memoryUsage());
+        return added;
+    }
+    if (packed) charge(before, obj.memoryUsage()); //Just unpacked
+    auto& val = obj.as<std::unordered_set<std::string>>();
+    const size_t buckets = val.bucket_count();
+    size_t grown = 0;
 
     for (auto i = args.begin() + 1; i != args.end(); ++i)
     {
-        if (val.insert(*i).second)
+        if (const auto [member, inserted] = val.emplace(*i); inserted)
         {
+            grown += Object::entryBytes(*member);
             added++;
         }
     }
+    charge(Object::bucketBytes(buckets), Object::bucketBytes(val.bucket_count()) + grown);
 
     return added;
 }
-int KVStore::srem(const std::vector<std::string>& args)
+KVStore::Typed<int> KVStore::srem(const std::vector<std::string_view>& args)
 {
     int removed = 0;
-    const std::string& k = args[0];
+    bool empty = false;
+    const std::string_view k = args[0];
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
-    if (!dict.find(accessor, k)) return removed;
-    auto& val = boost::get<std::unordered_set<std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return removed;
+    if (accessor->second.type() != storeType::SET) return WrongType{};
+    Object& obj = accessor->second;
 
-    for (auto i = args.begin() + 1; i != args.end(); ++i)
+    if (obj.encoding() == Encoding::INTSET)
     {
-        if (val.erase(*i))
+        Intset& set = obj.intset();
+        const size_t before = set.bytes();
+        for (auto i = args.begin() + 1; i != args.end(); ++i)
         {
-            removed++;
+            const auto n = Object::parseInteger(*i);
+            if (n && set.erase(*n)) removed++;
         }
+        charge(before, set.bytes());
+        empty = set.empty();
     }
+    else if (obj.encoding() == Encoding::LISTPACK)
+    {
+        Listpack& lp = obj.listpack();
+        const size_t before = lp.bytes();
+        for (auto i = args.begin() + 1; i != args.end(); ++i)
+        {
+            if (const auto at = lp.find(*i))
+            {
+                lp.erase(*at);
+                removed++;
+            }
+        }
+        charge(before, lp.bytes());
+        empty = lp.empty();
+    }
+    else
+    {
+        auto& val = obj.as<std::unordered_set<std::string>>();
+        const size_t buckets = val.bucket_count();
+        size_t shrunk = 0;
 
-    if (val.empty()) {
-        expirationManager.erase(k);
-        dict.erase(accessor);
-        currSize.fetch_sub(1);
-        lruManager.erase(k);
+        for (auto i = args.begin() + 1; i != args.end(); ++i)
+        {
+            if (const auto member = val.find(std::string(*i)); member != val.end())
+            {
+                shrunk += Object::entryBytes(*member);
+                val.erase(member);
+                removed++;
+            }
+        }
+        charge(Object::bucketBytes(buckets) + shrunk, Object::bucketBytes(val.bucket_count()));
+        empty = val.empty();
     }
 
+    if (empty) removeKey(accessor, k);
+
     return removed;
 }
-bool KVStore::sismember(const std::string& k, const std::string& v)
+KVStore::Typed<bool> KVStore::sismember(std::string_view k, std::string_view v)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return false;
-    const auto& val = boost::get<std::unordered_set<std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return false;
+    if (accessor->second.type() != storeType::SET) return WrongType{};
+    if (accessor->second.encoding() == Encoding::INTSET)
+    {
+        const auto n = Object::parseInteger(v);
+        return n && accessor->second.intset().contains(*n);
+    }
+    if (accessor->second.encoding() == Encoding::LISTPACK) return accessor->second.listpack().find(v).has_value();
+    const auto& val = accessor->second.as<std::unordered_set<std::string>>();
 
-    return val.contains(v);
+    return val.contains(std::string(v));
 }
-std::vector<std::optional<std::string>> KVStore::smembers(const std::string& k)
+KVStore::Typed<std::vector<std::optional<std::string>>> KVStore::smembers(std::string_view k)
 {
     std::vector<std::optional<std::string>> ret{};
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return ret;
-    const auto& val = boost::get<std::unordered_set<std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return ret;
+    if (accessor->second.type() != storeType::SET) return WrongType{};
+    if (accessor->second.encoding() == Encoding::INTSET)
+    {
+        const Intset& set = accessor->second.intset();
+        for (size_t i = 0; i < set.size(); ++i) ret.emplace_back(std::to_string(set.at(i)));
+        return ret;
+    }
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        for (const std::string_view i : accessor->second.listpack()) ret.emplace_back(std::string(i));
+        return ret;
+    }
+    const auto& val = accessor->second.as<std::unordered_set<std::string>>();
 
     for (const auto& i : val)
     {
@@ -637,156 +895,245 @@ std::vector<std::optional<std::string>> KVStore::smembers(const std::string& k)
 
     return ret;
 }
-int KVStore::scard(const std::string& k)
+KVStore::Typed<int> KVStore::scard(std::string_view k)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return 0;
-    const auto& val = boost::get<std::unordered_set<std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return 0;
+    if (accessor->second.type() != storeType::SET) return WrongType{};
+    if (accessor->second.encoding() == Encoding::INTSET) return static_cast<int>(accessor->second.intset().size());
+    if (accessor->second.encoding() == Encoding::LISTPACK) return static_cast<int>(accessor->second.listpack().size());
+    const auto& val = accessor->second.as<std::unordered_set<std::string>>();
 
     return static_cast<int>(val.size());
 }
-std::vector<std::optional<std::string>> KVStore::spop(const std::string& k, const int& count)
+KVStore::Typed<std::vector<std::optional<std::string>>> KVStore::spop(std::string_view k, const int& count)
 {
     std::vector<std::optional<std::string>> ret{};
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    bool empty = false;
+    Dict<Object>::accessor accessor;
+
+    if (!lookup(accessor, k)) return ret;
+    if (accessor->second.type() != storeType::SET) return WrongType{};
+    if (count == 0) return ret;
 
-    if (!dict.find(accessor, k) || count == 0) return ret;
-    auto& val = boost::get<std::unordered_set<std::string>>(accessor->second.value);
+    thread_local std::minstd_rand popRng{std::random_device{}()}; //Per thread, only the stripe lock is held here
+    const auto randomIndex = [](const size_t size) { return std::uniform_int_distribution<size_t>(0, size - 1)(popRng); };
 
-    for (int i = 0; i < count && !val.empty(); ++i)
+    Object& obj = accessor->second;
+    if (obj.encoding() == Encoding::INTSET)
     {
-        //TODO make randomized pop
-        auto it = val.begin();
-        ret.emplace_back(*it);
-        val.erase(it);
+        Intset& set = obj.intset();
+        const size_t before = set.bytes();
+        for (int i = 0; i < count && !set.empty(); ++i)
+        {
+            const long long n = set.at(randomIndex(set.size())); //Sorted, so never the front
+            ret.emplace_back(std::to_string(n));
+            set.erase(n);
+        }
+        charge(before, set.bytes());
+        empty = set.empty();
     }
+    else if (obj.encoding() == Encoding::LISTPACK)
+    {
+        Listpack& lp = obj.listpack();
+        const size_t before = lp.bytes();
+        for (int i = 0; i < count && !lp.empty(); ++i)
+        {
+            const size_t at = randomIndex(lp.size());
+            ret.emplace_back(std::string(lp.at(at)));
+            lp.erase(at);
+        }
+        charge(before, lp.bytes());
+        empty = lp.empty();
+    }
+    else
+    {
+        auto& val = obj.as<std::unordered_set<std::string>>();
+        const size_t buckets = val.bucket_count();
+        size_t shrunk = 0;
 
-    if (val.empty()) {
-        expirationManager.erase(k);
-        dict.erase(accessor);
-        currSize.fetch_sub(1);
-        lruManager.erase(k);
+        for (int i = 0; i < count && !val.empty(); ++i)
+        {
+            //TODO make randomized pop
+            auto it = val.begin();
+            shrunk += Object::entryBytes(*it);
+            ret.emplace_back(*it);
+            val.erase(it);
+        }
+        charge(Object::bucketBytes(buckets) + shrunk, Object::bucketBytes(val.bucket_count()));
+        empty = val.empty();
     }
 
+    if (empty) removeKey(accessor, k);
+
     return ret;
 }
 
-int KVStore::hset(const std::vector<std::string>& args)
+KVStore::Typed<int> KVStore::hset(const std::vector<std::string_view>& args)
 {
 
     int added = 0;
-    const std::string& k = args[0];
+    const std::string_view k = args[0];
+
+    Dict<Object>::accessor accessor;
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    if (args.size() < 3 || args.size() % 2 == 0) return 0; //just to be cautious, but handle function already handles this
 
-    if (args.size() < 3 || args.size() % 2 == 0) return false; //just to be cautious, but handle function already handles this
+    if (!lookup(accessor, k)) addKey(accessor, k, Object::packed(storeType::HASH));
+    else if (accessor->second.type() != storeType::HASH) return WrongType{};
+    Object& obj = accessor->second;
+    const bool packed = obj.encoding() != Encoding::BOXED; //Packed hashes are measured whole, boxed ones field by field
+    const size_t before = packed ? obj.memoryUsage() : 0;
+    unpackForValues(obj, args.begin() + 1, args.end());
 
-    if (!dict.find(accessor, k))
+    if (obj.encoding() == Encoding::LISTPACK)
     {
-        if (!spaceLeft()) evictTill();
-        std::unordered_map<std::string, std::string> newMap;
+        Listpack& lp = obj.listpack();
         for (auto i = 1; i < args.size(); i += 2)
         {
-            newMap[args[i]] = args[i + 1];
-            added++;
+            if (const auto at = lp.find(args[i], 2)) lp.replace(*at + 1, args[i + 1]);
+            else
+            {
+                lp.pushBack(args[i]);
+                lp.pushBack(args[i + 1]);
+                added++;
+            }
         }
-        dict.insert({k,RESPValue{storeType::HASH, newMap}});
-        currSize.fetch_add(1);
+        unpackIfFull(obj, 2);
+        charge(before, obj.memoryUsage());
         return added;
     }
-    //else
-    auto& val = boost::get<std::unordered_map<std::string, std::string>>(accessor->second.value);
+    if (packed) charge(before, obj.memoryUsage()); //Just unpacked
+    auto& val = obj.as<std::unordered_map<std::string, std::string>>();
+    size_t was = Object::bucketBytes(val.bucket_count()), now = 0;
 
     for (auto i = 1; i < args.size(); i += 2)
     {
-        if (!val.contains(args[i])) added++;
-        val[args[i]] = args[i + 1];
+        if (const auto field = val.find(std::string(args[i])); field != val.end())
+        {
+            was += Object::entryBytes(*field);
+            field->second = args[i + 1];
+            now += Object::entryBytes(*field);
+        }
+        else
+        {
+            now += Object::entryBytes(*val.emplace(args[i], args[i + 1]).first);
+            added++;
+        }
     }
+    charge(was, Object::bucketBytes(val.bucket_count()) + now);
     return added;
 }
-std::optional<std::string> KVStore::hget(const std::string& k, const std::string& f)
+KVStore::Typed<std::optional<std::string>> KVStore::hget(std::string_view k, std::string_view f)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return std::nullopt;
-    auto& val = boost::get<std::unordered_map<std::string,std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return std::nullopt;
+    if (accessor->second.type() != storeType::HASH) return WrongType{};
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        const Listpack& lp = accessor->second.listpack();
+        if (const auto at = lp.find(f, 2)) return std::string(lp.at(*at + 1));
+        return std::nullopt;
+    }
+    auto& val = accessor->second.as<std::unordered_map<std::string,std::string>>();
 
-    const auto foundField = val.find(f);
+    const auto foundField = val.find(std::string(f));
     if (foundField == val.end()) return std::nullopt;
 
     return foundField->second;
 }
-int KVStore::hdel(const std::vector<std::string>& args)
+KVStore::Typed<int> KVStore::hdel(const std::vector<std::string_view>& args)
 {
     int removed = 0;
-    const std::string& k = args[0];
+    bool empty = false;
+    const std::string_view k = args[0];
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::accessor accessor;
 
-    if (!dict.find(accessor, k)) return removed;
-    auto& val = boost::get<std::unordered_map<std::string,std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return removed;
+    if (accessor->second.type() != storeType::HASH) return WrongType{};
 
-    for (auto it = args.begin() + 1; it != args.end(); ++it)
+    if (accessor->second.encoding() == Encoding::LISTPACK)
     {
-        if (val.erase(*it) > 0)
+        Listpack& lp = accessor->second.listpack();
+        const size_t before = lp.bytes();
+        for (auto it = args.begin() + 1; it != args.end(); ++it)
         {
-            removed++;
+            if (const auto at = lp.find(*it, 2))
+            {
+                lp.erase(*at, 2);
+                removed++;
+            }
         }
+        charge(before, lp.bytes());
+        empty = lp.empty();
     }
+    else
+    {
+        auto& val = accessor->second.as<std::unordered_map<std::string,std::string>>();
+        const size_t buckets = val.bucket_count();
+        size_t shrunk = 0;
 
-    if (val.empty()) {
-        expirationManager.erase(k);
-        dict.erase(accessor);
-        currSize.fetch_sub(1);
-        lruManager.erase(k);
+        for (auto it = args.begin() + 1; it != args.end(); ++it)
+        {
+            if (const auto field = val.find(std::string(*it)); field != val.end())
+            {
+                shrunk += Object::entryBytes(*field);
+                val.erase(field);
+                removed++;
+            }
+        }
+        charge(Object::bucketBytes(buckets) + shrunk, Object::bucketBytes(val.bucket_count()));
+        empty = val.empty();
     }
 
+    if (empty) removeKey(accessor, k);
+
     return removed;
 }
-bool KVStore::hexists(const std::string& k, const std::string& f)
+KVStore::Typed<bool> KVStore::hexists(std::string_view k, std::string_view f)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return false;
-    auto& val = boost::get<std::unordered_map<std::string,std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return false;
+    if (accessor->second.type() != storeType::HASH) return WrongType{};
+    if (accessor->second.encoding() == Encoding::LISTPACK) return accessor->second.listpack().find(f, 2).has_value();
+    auto& val = accessor->second.as<std::unordered_map<std::string,std::string>>();
 
-    if (const auto foundField = val.find(f); foundField == val.end()) return false;
+    if (const auto foundField = val.find(std::string(f)); foundField == val.end()) return false;
 
     return true;
 }
-int KVStore::hlen(const std::string& k)
+KVStore::Typed<int> KVStore::hlen(std::string_view k)
 {
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return 0;
-    const auto& val = boost::get<std::unordered_map<std::string,std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return 0;
+    if (accessor->second.type() != storeType::HASH) return WrongType{};
+    if (accessor->second.encoding() == Encoding::LISTPACK) return static_cast<int>(accessor->second.listpack().size() / 2);
+    const auto& val = accessor->second.as<std::unordered_map<std::string,std::string>>();
 
     return static_cast<int>(val.size());
 }
-std::vector<std::optional<std::string>> KVStore::hkeys(const std::string& k)
+KVStore::Typed<std::vector<std::optional<std::string>>> KVStore::hkeys(std::string_view k)
 {
     std::vector<std::optional<std::string>> ret{};
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return ret;
-    auto& val = boost::get<std::unordered_map<std::string,std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return ret;
+    if (accessor->second.type() != storeType::HASH) return WrongType{};
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        size_t i = 0;
+        for (const std::string_view entry : accessor->second.listpack())
+        {
+            if (i++ % 2 == 0) ret.emplace_back(std::string(entry));
+        }
+        return ret;
+    }
+    auto& val = accessor->second.as<std::unordered_map<std::string,std::string>>();
 
     for (const auto& i : val)
     {
@@ -795,16 +1142,24 @@ std::vector<std::optional<std::string>> KVStore::hkeys(const std::string& k)
     //would use std::sort(ret.begin(), ret.end()) but not needed as redis doesn't do it either (same for hvals)
     return ret;
 }
-std::vector<std::optional<std::string>> KVStore::hvals(const std::string& k)
+KVStore::Typed<std::vector<std::optional<std::string>>> KVStore::hvals(std::string_view k)
 {
     std::vector<std::optional<std::string>> ret{};
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return ret;
-    const auto& val = boost::get<std::unordered_map<std::string,std::string>>(accessor->second.value);
+    if (!lookup(accessor, k)) return ret;
+    if (accessor->second.type() != storeType::HASH) return WrongType{};
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        size_t i = 0;
+        for (const std::string_view entry : accessor->second.listpack())
+        {
+            if (i++ % 2 == 1) ret.emplace_back(std::string(entry));
+        }
+        return ret;
+    }
+    const auto& val = accessor->second.as<std::unordered_map<std::string,std::string>>();
 
     for (const auto& i : val)
     {
@@ -812,26 +1167,35 @@ std::vector<std::optional<std::string>> KVStore::hvals(const std::string& k)
     }
     return ret;
 }
-std::vector<std::optional<std::string>> KVStore::hmget(const std::vector<std::string>& args)
+KVStore::Typed<std::vector<std::optional<std::string>>> KVStore::hmget(const std::vector<std::string_view>& args)
 {
-    const std::string& k = args[0];
+    const std::string_view k = args[0];
     std::vector<std::optional<std::string>> ret{};
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k))
+    if (!lookup(accessor, k))
     {
         ret.resize(args.size() - 1, std::nullopt); //a bit messy but will do?
         return ret;
     }
     //else
-    auto& val = boost::get<std::unordered_map<std::string, std::string>>(accessor->second.value);
+    if (accessor->second.type() != storeType::HASH) return WrongType{};
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        const Listpack& lp = accessor->second.listpack();
+        for (size_t i = 1; i < args.size(); ++i)
+        {
+            if (const auto at = lp.find(args[i], 2)) ret.emplace_back(std::string(lp.at(*at + 1)));
+            else ret.emplace_back(std::nullopt);
+        }
+        return ret;
+    }
+    auto& val = accessor->second.as<std::unordered_map<std::string, std::string>>();
 
     for (auto i = 1; i < args.size(); ++i)
     {
-        const auto field = val.find(args[i]);
+        const auto field = val.find(std::string(args[i]));
 
         if (field == val.end()) ret.emplace_back(std::nullopt);
         else ret.emplace_back(std::make_optional(field->second));
@@ -839,17 +1203,21 @@ std::vector<std::optional<std::string>> KVStore::hmget(const std::vector<std::st
 
     return ret;
 }
-std::vector<std::optional<std::string>> KVStore::hgetall(const std::string& k)
+KVStore::Typed<std::vector<std::optional<std::string>>> KVStore::hgetall(std::string_view k)
 {
     std::vector<std::optional<std::string>> ret{};
 
-    tbb::concurrent_hash_map<std::string, RESPValue>::accessor accessor;
-    checkExpKey(k);
-    lruManager.touch(k);
+    Dict<Object>::const_accessor accessor;
 
-    if (!dict.find(accessor, k)) return ret;
+    if (!lookup(accessor, k)) return ret;
+    if (accessor->second.type() != storeType::HASH) return WrongType{};
+    if (accessor->second.encoding() == Encoding::LISTPACK) //Already field, value, field, value...
+    {
+        for (const std::string_view entry : accessor->second.listpack()) ret.emplace_back(std::string(entry));
+        return ret;
+    }
 
-    const auto& val = boost::get<std::unordered_map<std::string, std::string>>(accessor->second.value);
+    const auto& val = accessor->second.as<std::unordered_map<std::string, std::string>>();
     for (const auto& [field, value] : val)
     {
         ret.emplace_back(field);
@@ -858,3 +1226,166 @@ std::vector<std::optional<std::string>> KVStore::hgetall(const std::string& k)
 
     return ret;
 }
+
+void KVStore::lrangeInto(std::string_view k, const int start, const int stop, ReplyWriter& out)
+{
+    Dict<Object>::const_accessor accessor;
+
+    if (!lookup(accessor, k))
+    {
+        out.arrayHeader(0);
+        return;
+    }
+    if (accessor->second.type() != storeType::LIST)
+    {
+        out.raw(RESP_WRONG_TYPE);
+        return;
+    }
+    int trueStart = start, trueStop = stop;
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        const Listpack& lp = accessor->second.listpack();
+        if (!clampRange(static_cast<int>(lp.size()), trueStart, trueStop))
+        {
+            out.arrayHeader(0);
+            return;
+        }
+        out.arrayHeader(trueStop - trueStart + 1);
+        auto it = std::next(lp.begin(), trueStart);
+        for (int i = trueStart; i <= trueStop; ++i, ++it) out.bulk(*it);
+        return;
+    }
+    const Quicklist& val = accessor->second.quicklist();
+
+    if (!clampRange(static_cast<int>(val.size()), trueStart, trueStop))
+    {
+        out.arrayHeader(0);
+        return;
+    }
+    out.arrayHeader(trueStop - trueStart + 1);
+    val.forRange(trueStart, trueStop, [&out](std::string_view v) { out.bulk(v); });
+}
+void KVStore::smembersInto(std::string_view k, ReplyWriter& out)
+{
+    Dict<Object>::const_accessor accessor;
+
+    if (!lookup(accessor, k))
+    {
+        out.arrayHeader(0);
+        return;
+    }
+    if (accessor->second.type() != storeType::SET)
+    {
+        out.raw(RESP_WRONG_TYPE);
+        return;
+    }
+    if (accessor->second.encoding() == Encoding::INTSET)
+    {
+        const Intset& set = accessor->second.intset();
+        out.arrayHeader(set.size());
+        char digits[24];
+        for (size_t i = 0; i < set.size(); ++i)
+        {
+            const auto [end, err] = std::to_chars(digits, digits + sizeof(digits), set.at(i));
+            out.bulk({digits, static_cast<size_t>(end - digits)});
+        }
+        return;
+    }
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        const Listpack& lp = accessor->second.listpack();
+        out.arrayHeader(lp.size());
+        for (const std::string_view i : lp) out.bulk(i);
+        return;
+    }
+    const auto& val = accessor->second.as<std::unordered_set<std::string>>();
+
+    out.arrayHeader(val.size());
+    for (const auto& i : val) out.bulk(i);
+}
+void KVStore::hkeysInto(std::string_view k, ReplyWriter& out)
+{
+    Dict<Object>::const_accessor accessor;
+
+    if (!lookup(accessor, k))
+    {
+        out.arrayHeader(0);
+        return;
+    }
+    if (accessor->second.type() != storeType::HASH)
+    {
+        out.raw(RESP_WRONG_TYPE);
+        return;
+    }
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        const Listpack& lp = accessor->second.listpack();
+        out.arrayHeader(lp.size() / 2);
+        size_t i = 0;
+        for (const std::string_view entry : lp)
+        {
+            if (i++ % 2 == 0) out.bulk(entry);
+        }
+        return;
+    }
+    const auto& val = accessor->second.as<std::unordered_map<std::string, std::string>>();
+
+    out.arrayHeader(val.size());
+    for (const auto& i : val) out.bulk(i.first);
+}
+void KVStore::hvalsInto(std::string_view k, ReplyWriter& out)
+{
+    Dict<Object>::const_accessor accessor;
+
+    if (!lookup(accessor, k))
+    {
+        out.arrayHeader(0);
+        return;
+    }
+    if (accessor->second.type() != storeType::HASH)
+    {
+        out.raw(RESP_WRONG_TYPE);
+        return;
+    }
+    if (accessor->second.encoding() == Encoding::LISTPACK)
+    {
+        const Listpack& lp = accessor->second.listpack();
+        out.arrayHeader(lp.size() / 2);
+        size_t i = 0;
+        for (const std::string_view entry : lp)
+        {
+            if (i++ % 2 == 1) out.bulk(entry);
+        }
+        return;
+    }
+    const auto& val = accessor->second.as<std::unordered_map<std::string, std::string>>();
+
+    out.arrayHeader(val.size());
+    for (const auto& i : val) out.bulk(i.second);
+}
+void KVStore::hgetallInto(std::string_view k, ReplyWriter& out)
+{
+    Dict<Object>::const_accessor accessor;
+
+    if (!lookup(accessor, k))
+    {
+        out.arrayHeader(0);
+        return;
+    }
+    if (accessor->second.type() != storeType::HASH)
+    {
+        out.raw(RESP_WRONG_TYPE);
+        return;
+    }
+    if (accessor->second.encoding() == Encoding::LISTPACK) //Already field, value, field, value...
+    {
+        const Listpack& lp = accessor->second.listpack();
+        out.arrayHeader(lp.size());
+        for (const std::string_view entry : lp) out.bulk(entry);
+        return;
+    }
+    const auto& val = accessor->second.as<std::unordered_map<std::string, std::string>>();
+
+    out.arrayHeader(val.size() * 2);
+    for (const auto& [field, value] : val) out.bulk(field).bulk(value);
+}
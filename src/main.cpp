@@ -1,6 +1,8 @@
 #include <csignal>
+#include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
 #include "server.hpp"
 
 Server* redis = nullptr;
@@ -15,9 +17,40 @@ void signalHandler(const int signal)
     exit(signal);
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-    redis = new Server(); //Uses default Redis port (config.h to change)
+    IOBackend backend = IOBackend::EPOLL;
+    int shardCount = 0; //Pooled loops over a shared store unless --shards is given
+    for (int i = 1; i < argc; ++i) //Flags: --io epoll|uring, --shards N|auto
+    {
+        if (std::string(argv[i]) == "--io" && i + 1 < argc)
+        {
+            const auto parsed = strToIOBackend(argv[++i]);
+            if (!parsed)
+            {
+                std::cerr << "Unknown io backend: " << argv[i] << " (expected epoll or uring)" << std::endl;
+                return 1;
+            }
+            backend = *parsed;
+        }
+        else if (std::string(argv[i]) == "--shards" && i + 1 < argc)
+        {
+            const std::string count = argv[++i];
+            shardCount = count == "auto" ? static_cast<int>(std::thread::hardware_concurrency()) : std::atoi(count.c_str());
+            if (shardCount <= 0)
+            {
+                std::cerr << "Invalid shard count: " << count << " (expected a positive number or auto)" << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--io epoll|uring] [--shards N|auto]" << std::endl;
+            return 1;
+        }
+    }
+
+    redis = new Server(backend, shardCount); //Uses default Redis port (config.h to change)
 
     std::signal(SIGINT, signalHandler); //Handle Ctrl+C
     std::signal(SIGTERM, signalHandler); //Handle termination signal
@@ -1,84 +1,200 @@
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <format>
+#include <utility>
 
 #include "parser.hpp"
+#include "respscan.hpp"
 #include "util.hpp"
+#include "config.h"
 
-std::vector<std::vector<std::string>> parseRESPPipeline(const char* buffer, const size_t len, size_t& offset)
+
+RESPParser::Status RESPParser::next(const std::string_view input, size_t& consumed, std::vector<std::string_view>& command)
 {
-    std::vector<std::vector<std::string>> commands;
-    while (offset < len)
+    size_t pos = spilled ? 0 : scanned;
+    std::string_view line;
+    while (true)
     {
-        try
-        {
-            commands.push_back(parseRESP(buffer, len, offset));
-        }
-        catch (const std::runtime_error& e)
+        switch (state)
         {
-            break;
+            case State::TYPE:
+            {
+                if (pos >= input.size()) return needMore(pos, consumed);
+                const char type = input[pos++];
+                if (inArray)
+                {
+                    if (type != '$') return fail(std::format("expected '$', got '{}'", type));
+                    state = State::BULK_LEN;
+                    break;
+                }
+                owned.clear(); //Previous cmd was handled, its spilled args can go
+                switch (type)
+                {
+                    case '*': state = State::ARRAY_LEN; break;
+                    case '$': state = State::BULK_LEN; break;
+                    case '+': case '-': case ':': lineType = type; state = State::LINE; break;
+                    default: return fail(std::format("unexpected '{}'", type));
+                }
+                break;
+            }
+            case State::ARRAY_LEN:
+            {
+                if (!readLine(input, pos, line)) return lineMissing(input, pos, consumed);
+                long long len = 0;
+                if (!respscan::parseInt(line, len) || len > PROTO_MAX_ARGS) return fail("invalid multibulk length");
+                state = State::TYPE;
+                if (len <= 0) return complete(input, pos, consumed, command); //Nothing to run, the handler answers the empty cmd
+                inArray = true;
+                arrayLeft = len;
+                spans.reserve(static_cast<size_t>(std::min<long long>(len, 1024)));
+                break;
+            }
+            case State::BULK_LEN:
+            {
+                if (!readLine(input, pos, line)) return lineMissing(input, pos, consumed);
+                long long len = 0;
+                if (!respscan::parseInt(line, len) || len < -1 || len > PROTO_MAX_BULK) return fail("invalid bulk length");
+                if (len == -1) //Null bulk, skipped like before
+                {
+                    state = State::TYPE;
+                    if (finishElement()) return complete(input, pos, consumed, command);
+                    break;
+                }
+                bulkLen = len;
+                if (!spilled && bulkLen >= ZERO_COPY_MIN) spill(input);
+                if (spilled)
+                {
+                    bulkFilled = 0;
+                    bulk.clear();
+                    if (bulkLen >= ZERO_COPY_MIN) bulk.resize(bulkLen); //Final allocation, filled in place from here on
+                    else bulk.reserve(bulkLen);
+                }
+                state = State::BULK_BODY;
+                break;
+            }
+            case State::BULK_BODY:
+            {
+                //Length prefixed, the bytes are taken as is so values may hold CRLF
+                if (!spilled)
+                {
+                    if (input.size() - pos < static_cast<size_t>(bulkLen)) return needMore(pos, consumed);
+                    pos += bulkLen;
+                    state = State::BULK_CRLF;
+                    break;
+                }
+                const size_t take = std::min(static_cast<size_t>(bulkLen) - bulkFilled, input.size() - pos);
+                if (bulk.size() == static_cast<size_t>(bulkLen)) std::memcpy(bulk.data() + bulkFilled, input.data() + pos, take);
+                else bulk.append(input.data() + pos, take);
+                bulkFilled += take;
+                pos += take;
+                if (bulkFilled < static_cast<size_t>(bulkLen)) return needMore(pos, consumed);
+                state = State::BULK_CRLF;
+                break;
+            }
+            case State::BULK_CRLF:
+            {
+                if (input.size() - pos < 2) return needMore(pos, consumed);
+                if (input[pos] != '\r' || input[pos + 1] != '\n') return fail("bulk not terminated by CRLF");
+                if (spilled) owned.push_back(std::exchange(bulk, {}));
+                else spans.emplace_back(pos - bulkLen, bulkLen);
+                pos += 2;
+                state = State::TYPE;
+                if (finishElement()) return complete(input, pos, consumed, command);
+                break;
+            }
+            case State::LINE:
+            {
+                if (!readLine(input, pos, line)) return lineMissing(input, pos, consumed);
+                state = State::TYPE;
+                const size_t start = line.data() - input.data();
+                if (lineType != '-') spans.emplace_back(start, line.size());
+                else for (size_t i = 0; i < line.size();) //Space separated inline cmd
+                {
+                    if (line[i] == ' ')
+                    {
+                        ++i;
+                        continue;
+                    }
+                    const size_t end = std::min(line.find(' ', i), line.size());
+                    spans.emplace_back(start + i, end - i);
+                    i = end;
+                }
+                return complete(input, pos, consumed, command);
+            }
         }
     }
-    return commands;
 }
 
-
-std::vector<std::string> parseRESP(const char* buffer, size_t len, size_t& offset)
+std::span<char> RESPParser::directTarget()
 {
-    if (offset >= len) throw std::runtime_error("Nothing to parse");
-    const char datatype = buffer[offset];
-    offset++;
-    switch (datatype)
-    {
-        case '+': return parseSimpleString(buffer, len, offset);
-        case '-': return parseError(buffer, len, offset);
-        case ':': return parseInteger(buffer, len, offset);
-        case '$': return parseBulkString(buffer, len, offset);
-        case '*': return parseArray(buffer, len, offset);
-        default: throw std::runtime_error("RESP type not yet implemented or handled");
-    }
+    if (state != State::BULK_BODY || !spilled || bulk.size() != static_cast<size_t>(bulkLen)) return {};
+    return {bulk.data() + bulkFilled, bulk.size() - bulkFilled};
 }
 
-std::vector<std::string> parseSimpleString(const char* buffer, const size_t len, size_t& offset)
+void RESPParser::directFilled(const size_t bytes)
 {
-    return {readLine(buffer, len, offset)};
+    bulkFilled += bytes;
 }
 
-std::vector<std::string> parseError(const char* buffer, const size_t len, size_t& offset)
+bool RESPParser::readLine(const std::string_view input, size_t& pos, std::string_view& line)
 {
-    return splitSpaces(readLine(buffer, len, offset));
+    const size_t end = respscan::findCRLF(input, pos);
+    if (end == std::string_view::npos) return false;
+    line = input.substr(pos, end - pos);
+    pos = end + 2;
+    return true;
 }
 
-std::vector<std::string> parseInteger(const char* buffer, const size_t len, size_t& offset)
+bool RESPParser::finishElement()
 {
-    return {readLine(buffer, len, offset)};
+    if (!inArray) return true; //Top level bulk, a cmd of its own
+    if (--arrayLeft > 0) return false;
+    inArray = false;
+    return true;
 }
 
-std::vector<std::string> parseBulkString(const char* buffer, const size_t len, size_t& offset)
+void RESPParser::spill(const std::string_view input)
 {
-    const std::string lenStr = readLine(buffer, len, offset);
-    const int lenNum = std::stoi(lenStr);
-    if (lenNum == -1) return {};
-    if (offset + lenNum + 2 > len) throw std::runtime_error("Incomplete bulk string");
-
-    std::string retStr = readLine(buffer, len, offset);
-    if (retStr.size() != lenNum) throw std::runtime_error("Malformed bulk string");
+    for (const auto& [offset, len] : spans) owned.emplace_back(input.substr(offset, len));
+    spans.clear();
+    spilled = true;
+}
 
-    return {retStr};
+RESPParser::Status RESPParser::complete(const std::string_view input, const size_t pos, size_t& consumed, std::vector<std::string_view>& command)
+{
+    command.clear();
+    if (spilled) command.assign(owned.begin(), owned.end());
+    else for (const auto& [offset, len] : spans) command.push_back(input.substr(offset, len));
+    spans.clear();
+    spilled = false;
+    scanned = 0;
+    consumed = pos;
+    return Status::COMMAND;
 }
 
-std::vector<std::string> parseArray(const char* buffer, const size_t len, size_t& offset)
+RESPParser::Status RESPParser::needMore(const size_t pos, size_t& consumed)
 {
-    const std::string lenStr = readLine(buffer, len, offset);
-    const int arrayLen = std::stoi(lenStr);
-    std::vector<std::string> ret;
-    for (ssize_t i = 0; i < arrayLen; i++)
+    if (spilled) consumed = pos; //Owned from here on, the input can go
+    else
     {
-        if (offset >= len || buffer[offset] == '*') throw std::runtime_error("Incomplete array element");
-        std::vector<std::string> element = parseRESP(buffer, len, offset);
-        if (!element.empty()) ret.push_back(element[0]);
+        consumed = 0; //Args point into the input, keep it until the cmd is complete
+        scanned = pos;
     }
-    return ret;
+    return Status::NEED_MORE;
+}
+
+RESPParser::Status RESPParser::lineMissing(const std::string_view input, const size_t pos, size_t& consumed)
+{
+    if (input.size() - pos > PROTO_MAX_LINE) return fail("line too long");
+    return needMore(pos, consumed); //Partial line is rescanned on the next read, these are only a few bytes
+}
+
+RESPParser::Status RESPParser::fail(std::string msg)
+{
+    errorMsg = std::move(msg);
+    return Status::ERROR;
 }
 
 std::string parseCommandToRESP(const std::string& command) //Only for the client might move
@@ -93,6 +209,8 @@ std::string parseCommandToRESP(const std::string& command) //Only for the client
 }
 
 int intParser(const std::string& line) {
-    const size_t end = line.find("\r\n");
-    return std::stoi(line.substr(1, end - 1));
+    const size_t end = respscan::findCRLF(line, 0);
+    long long ret = 0;
+    if (line.empty() || !respscan::parseInt(std::string_view(line).substr(1, end - 1), ret)) throw std::invalid_argument("intParser");
+    return static_cast<int>(ret);
 }
\ No newline at end of file
@@ -1,15 +1,17 @@
-#include <sstream>
-#include <format>
+#include <memory>
 
 #include "pubsub.hpp"
+#include "eventloop.hpp"
+#include "replywriter.hpp"
+#include "session.hpp"
 
 
-int PubSub::subscribe(const std::string& channel, const int sock)
+int PubSub::subscribe(const std::string& channel, Session* session)
 {
     std::lock_guard lock(mtx);
-    channels[channel].push_back(sock);
-    users[sock].push_back(channel);
-    return static_cast<int>(users[sock].size());
+    channels[channel].push_back(session);
+    users[session].push_back(channel);
+    return static_cast<int>(users[session].size());
 }
 int PubSub::publish(const std::string& channel, const std::string& message)
 {
@@ -17,46 +19,41 @@ int PubSub::publish(const std::string& channel, const std::string& message)
 
     if (!channels.contains(channel)) return 0;
 
-    const std::string pubbedMessage = formatMessage(channel, message);
-    int count = 0;
+    const auto pubbedMessage = std::make_shared<const std::string>(formatMessage(channel, message)); //One copy shared by every subscriber
+    const auto& subs = channels[channel];
 
-    for (const int subs : channels[channel])
-    {
-        ssize_t sent = send(subs, pubbedMessage.c_str(), pubbedMessage.size(), 0);
-        if (sent >= 0) ++count;
-        // TODO error handle fail maybe
-    }
-    return count;
+    for (Session* sub : subs) sub->loop->post(sub, pubbedMessage);
+    return static_cast<int>(subs.size());
 }
-int PubSub::unsubscribe(const std::string& channel, const int sock)
+int PubSub::unsubscribe(const std::string& channel, Session* session)
 {
     std::lock_guard lock(mtx);
     if (channels.contains(channel))
     {
-        std::erase(channels[channel], sock);
+        std::erase(channels[channel], session);
         if (channels[channel].empty()) {
             channels.erase(channel);
         }
     }
-    std::erase(users[sock], channel);
-    return static_cast<int>(users[sock].size());
+    std::erase(users[session], channel);
+    return static_cast<int>(users[session].size());
 }
-void PubSub::unsubscribeAll(const int sock)
+void PubSub::unsubscribeAll(Session* session)
 {
     std::lock_guard lock(mtx);
-    if (!users.contains(sock)) return;
+    if (!users.contains(session)) return;
 
-    for (const auto& channel : users[sock]) {
+    for (const auto& channel : users[session]) {
         if (channels.contains(channel)) {
-            std::erase(channels[channel], sock);
+            std::erase(channels[channel], session);
             if (channels[channel].empty()) {
                 channels.erase(channel);
             }
         }
     }
-    users.erase(sock);
+    users.erase(session);
 }
 
 std::string PubSub::formatMessage(const std::string& channel, const std::string& message) {
-    return std::format("*3\r\n$7\r\nmessage\r\n${}\r\n{}\r\n${}\r\n{}\r\n", channel.size(), channel, message.size(), message);
+    return ReplyWriter().arrayHeader(3).bulk("message").bulk(channel).bulk(message).take();
 }
@@ -2,8 +2,6 @@
 #include <iostream>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-#include <boost/asio/thread_pool.hpp>
-#include <boost/asio/post.hpp>
 #include <thread>
 #include <format>
 
@@ -14,13 +12,43 @@
 #include "util.hpp"
 #include "commands.hpp"
 #include "pubsub.hpp"
+#include "replywriter.hpp"
 #include "session.hpp"
+#include "eventloop.hpp"
 
 
-Server::Server() : pool(POOL_SIZE), kvstore(true, SAVEFILE_PATH, KEY_LIMIT) //Config.h
+Server::Server(const IOBackend backend, const int shardCount) : ioBackend(backend), shardCount(shardCount)
 {
     std::cout << "Server launch!" << std::endl;
-    this->sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (shardCount == 0)
+    {
+        kvstore = std::make_unique<KVStore>(true, SAVEFILE_PATH); //Config.h
+        this->sock = openListener(false);
+        return;
+    }
+
+    //Shared-nothing, the kernel spreads connections over one SO_REUSEPORT listener per shard
+    for (int i = 0; i < shardCount; ++i) shards.push_back(std::make_unique<Shard>(*this, i, shardCount, ioBackend, openListener(true)));
+}
+
+Server::~Server()
+{
+    std::cout << "Server shutting down..." << std::endl;
+    stop();
+    for (auto& thread : loopThreads)
+    {
+        if (thread.joinable()) thread.join();
+    }
+    for (const auto& shard : shards) shard->join();
+    loops.clear(); //Closes the remaining sessions
+    for (const auto& shard : shards) shard->closeLoop(); //Before any shard goes away, closing sessions touches their owner shard
+    shards.clear();
+    if (this->sock >= 0) close(this->sock);
+}
+
+int Server::openListener(const bool reusePort) const
+{
+    const int listenSock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
 
     sockaddr_in sockAddress{};
     sockAddress.sin_family = AF_INET;
@@ -30,22 +58,17 @@ Server::Server() : pool(POOL_SIZE), kvstore(true, SAVEFILE_PATH, KEY_LIMIT) //Co
     try
     {
         int opt = 1;
-        if (setsockopt(this->sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)  throw std::runtime_error("setsockopt(SO_REUSEADDR) failed");
-        if (bind(this->sock, reinterpret_cast<sockaddr*>(&sockAddress), sizeof(sockAddress)) != 0) throw std::runtime_error("Server bind failed");
-        if (listen(this->sock, 5) != 0) throw std::runtime_error("Server listen failed");
+        if (setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)  throw std::runtime_error("setsockopt(SO_REUSEADDR) failed");
+        if (reusePort && setsockopt(listenSock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)  throw std::runtime_error("setsockopt(SO_REUSEPORT) failed");
+        if (bind(listenSock, reinterpret_cast<sockaddr*>(&sockAddress), sizeof(sockAddress)) != 0) throw std::runtime_error("Server bind failed");
+        if (listen(listenSock, LISTEN_BACKLOG) != 0) throw std::runtime_error("Server listen failed");
         std::cout << "Listening on: " << hostIP << " : " << servPort << std::endl;
     }
     catch (const std::exception& e)
     {
         std::cout << "Error caught: " << e.what() << std::endl;
     }
-}
-
-Server::~Server()
-{
-    std::cout << "Server shutting down..." << std::endl;
-    pool.join();
-    close(this->sock);
+    return listenSock;
 }
 
 void Server::start()
@@ -55,172 +78,339 @@ void Server::start()
         while (running)
         {
             std::this_thread::sleep_for(std::chrono::seconds(SNAP_TIMER));
-            kvstore.saveToDisk();
+            if (kvstore) kvstore->saveToDisk();
+            for (const auto& shard : shards) shard->store().saveToDisk();
+        }
+    });
+    std::thread cronTimer([this] //Keyspace upkeep between requests: finishing dict rehashes (never waits on a busy stripe) and deleting expired keys
+    {
+        while (running)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(REHASH_CRON_MS));
+            if (kvstore)
+            {
+                kvstore->rehashStep();
+                kvstore->activeExpireCycle();
+            }
+            for (const auto& shard : shards)
+            {
+                shard->store().rehashStep();
+                shard->store().activeExpireCycle();
+            }
         }
     });
 
-    while (running)
+    if (!shards.empty())
     {
-        sockaddr_in connectionAddress{};
-        socklen_t addLen = sizeof(connectionAddress);
+        for (const auto& shard : shards) shard->start(shards);
+        std::cout << "Waiting for new connections on " << shards.size() << " shards..." << std::endl;
+        for (const auto& shard : shards) shard->join();
+        snapshotTimer.join();
+        cronTimer.join();
+        return;
+    }
+
+    //Every loop multiplexes its own share of the connections, a slow client no longer pins a thread
+    for (int i = 0; i < POOL_SIZE; ++i) loops.push_back(EventLoop::create(ioBackend, *this, this->sock, i));
+    for (auto& loop : loops) loopThreads.emplace_back([&loop] { loop->run(); });
+    std::cout << "Waiting for new connections on " << POOL_SIZE << " event loops..." << std::endl;
 
-        std::cout << "Waiting for new connections..." << std::endl;
-        int connectionSock = accept(this->sock, reinterpret_cast<sockaddr*>(&connectionAddress), &addLen);
-        if (connectionSock == -1) break;
-        boost::asio::post(pool,[this, connectionSock, connectionAddress]() {
-            handleCommunication(connectionSock, connectionAddress);
-        });
+    for (auto& thread : loopThreads)
+    {
+        if (thread.joinable()) thread.join();
     }
     snapshotTimer.join();
+    cronTimer.join();
 }
 
 void Server::stop()
 {
     running = false;
+    for (const auto& loop : loops) loop->stop();
+    for (const auto& shard : shards) shard->stop();
 }
 
 
-void Server::handleCommunication(const int clientSock, const sockaddr_in clientAddress)
+void Server::processInput(Session* session)
 {
-    std::cout << "New connection from sock: " << clientSock << std::endl;
-
-    const auto session = new Session{ //TODO maybe replace with smart ptr
-            .clientSock = clientSock,
-            .clientAddress = inet_ntoa(clientAddress.sin_addr)
-    };
-
-    char buffer[4096];
+    //Parse all in pipeline from the session buffer, a halved cmd stays in the buffer until the rest arrives
+    std::vector<std::string_view> command; //Points into the read buffer, only consumed once the cmd was handled
     while (true)
     {
-        std::string resp;
-        try
+        size_t consumed = 0;
+        const auto status = session->parser.next(session->readBuffer.readable(), consumed, command);
+        if (status == RESPParser::Status::NEED_MORE)
         {
-            //In
-            const ssize_t bytesRead = recv(clientSock, &buffer, sizeof(buffer), 0);
-            if (bytesRead <= 0) break;
-
-            //Append to any halved commands, parse all in pipeline return cmd(s)
-            session->partialCommand.append(buffer, bytesRead);
-            size_t offset = 0;
-            std::vector<std::vector<std::string>> commands = parseRESPPipeline(session->partialCommand.c_str(), session->partialCommand.size(), offset);
-            session->partialCommand = session->partialCommand.substr(offset);
-
-            //Handle
-            for (const auto& command : commands)
-            {
-                resp += handleCommand(command, session);
-            }
-
-            //Out
-            send(clientSock, resp.c_str(), resp.size(), 0);
-        } catch (const std::exception& e) {
-            std::cerr << "Error during communication: " << e.what() << std::endl;
-            break;
+            session->readBuffer.consume(consumed);
+            return;
         }
+        if (status == RESPParser::Status::ERROR) throw std::runtime_error("Protocol error: " + session->parser.error());
+
+        //Handle
+        dispatch(command, session);
+        session->readBuffer.consume(consumed);
     }
-    pubsubManager.unsubscribeAll(session->clientSock);
-    std::cout << "Closed connection from sock: " << clientSock << std::endl;
-    close(clientSock);
-    delete session;
 }
 
+void Server::onDisconnect(Session* session)
+{
+    pubsubManager.unsubscribeAll(session);
+    if (session->loop) session->loop->dropPosted(session); //Nothing is posted to it after unsubscribeAll
+    if (!shards.empty() && session->loop) shards[session->loop->id()]->forget(session);
+}
 
-std::string Server::handleCommand(const std::vector<std::string>& command, Session* session)
+
+int Server::shardOf(const std::string_view key) const
 {
-    const std::vector arguments(command.begin() + 1, command.end());
+    return static_cast<int>(std::hash<std::string_view>{}(key) % shards.size());
+}
 
-    if (command.empty())
+void Server::reply(Session* session, OutputBuffer resp)
+{
+    if (session->pendingReplies.empty())
     {
-        return "-ERR command line empty\r\n";
+        session->writeBuffer.append(std::move(resp));
+        return;
     }
+    session->pendingReplies.push_back(std::make_shared<PendingReply>(PendingReply{session, std::move(resp), true})); //Behind the ones still waiting
+}
 
-    const Commands cmd = strToCmd(command[0]);
-    if (session->transActive && cmd != Commands::EXEC && cmd != Commands::DISCARD)
+std::shared_ptr<PendingReply> Server::reserveReply(Session* session)
+{
+    auto slot = std::make_shared<PendingReply>(PendingReply{session});
+    session->pendingReplies.push_back(slot);
+    return slot;
+}
+
+void Server::completeReply(const std::shared_ptr<PendingReply>& slot, OutputBuffer resp)
+{
+    slot->reply = std::move(resp);
+    slot->ready = true;
+    Session* session = slot->session;
+    if (!session) return; //Client left before the reply came back
+
+    auto& pending = session->pendingReplies;
+    while (!pending.empty() && pending.front()->ready)
+    {
+        session->writeBuffer.append(std::move(pending.front()->reply));
+        pending.pop_front();
+    }
+    shards[session->loop->id()]->markDirty(session);
+}
+
+template<class Work, class Done>
+void Server::submitTo(const int origin, const int owner, Work work, Done done)
+{
+    if (origin == owner)
     {
-        session->transQueue.push_back(command);
-        return "+QUEUED\r\n";
+        done(work(shards[owner]->store()));
+        return;
     }
+    shards[origin]->send(owner, [this, origin, owner, work = std::move(work), done = std::move(done)]() mutable
+    {
+        auto result = work(shards[owner]->store());
+        shards[owner]->send(origin, [result = std::move(result), done = std::move(done)]() mutable { done(std::move(result)); });
+    });
+}
 
+void Server::dispatch(const std::vector<std::string_view>& command, Session* session)
+{
+    if (shards.empty())
+    {
+        reply(session, handleCommand(command, session, *kvstore));
+        return;
+    }
+    const int origin = session->loop->id();
+    const CommandInfo* info = command.empty() ? nullptr : lookupCommand(command[0]);
+    if (!info || !info->arityOk(command.size()) || (session->transActive && !(info->flags & CMD_NOQUEUE)))
+    {
+        reply(session, handleCommand(command, session, shards[origin]->store())); //Errors and queueing need no other shard
+        return;
+    }
+
+    const Commands cmd = info->cmd;
+    const std::vector arguments(command.begin() + 1, command.end());
     switch (cmd)
     {
-        case Commands::PING: return handlePING(arguments);
-        case Commands::ECHO: return handleECHO(arguments);
-        case Commands::DEL: return handleDEL(kvstore, arguments);
-        case Commands::EXISTS: return handleEXISTS(kvstore, arguments);
-        case Commands::FLUSHALL: return handleFLUSHALL(kvstore, arguments);
-
-        case Commands::SET: return handleSET(kvstore, arguments);
-        case Commands::GET: return handleGET(kvstore, arguments);
-        case Commands::INCR: return handleINCR(kvstore, arguments);
-        case Commands::DCR: return handleDCR(kvstore, arguments);
-        case Commands::INCRBY: return handleINCRBY(kvstore, arguments);
-        case Commands::DCRBY: return handleDCRBY(kvstore, arguments);
-        case Commands::MGET: return handleMGET(kvstore, arguments);
-
-        case Commands::EXPIRE: return handleEXPIRE(kvstore, arguments);
-        case Commands::TTL: return handleTTL(kvstore, arguments);
-        case Commands::PERSIST: return handlePERSIST(kvstore, arguments);
-
-        case Commands::LPUSH: return handleLPUSH(kvstore, arguments);
-        case Commands::RPUSH: return handleRPUSH(kvstore, arguments);
-        case Commands::LPOP: return handleLPOP(kvstore, arguments);
-        case Commands::RPOP: return handleRPOP(kvstore, arguments);
-        case Commands::LRANGE: return handleLRANGE(kvstore, arguments);
-        case Commands::LLEN: return handleLLEN(kvstore, arguments);
-        case Commands::LINDEX: return handleLINDEX(kvstore, arguments);
-        case Commands::LSET: return handleLSET(kvstore, arguments);
-        case Commands::LREM: return handleLREM(kvstore, arguments);
-
-        case Commands::SADD: return handleSADD(kvstore, arguments);
-        case Commands::SREM: return handleSREM(kvstore, arguments);
-        case Commands::SISMEMBER: return handleSISMEMBER(kvstore, arguments);
-        case Commands::SMEMBERS: return handleSMEMBERS(kvstore, arguments);
-        case Commands::SCARD: return handleSCARD(kvstore, arguments);
-        case Commands::SPOP: return handleSPOP(kvstore, arguments);
-
-        case Commands::HSET: return handleHSET(kvstore, arguments);
-        case Commands::HGET: return handleHGET(kvstore, arguments);
-        case Commands::HDEL: return handleHDEL(kvstore, arguments);
-        case Commands::HEXISTS: return handleHEXISTS(kvstore, arguments);
-        case Commands::HLEN: return handleHLEN(kvstore, arguments);
-        case Commands::HKEYS: return handleHKEYS(kvstore, arguments);
-        case Commands::HVALS: return handleHVALS(kvstore, arguments);
-        case Commands::HMGET: return handleHMGET(kvstore, arguments);
-        case Commands::HGETALL: return handleHGETALL(kvstore, arguments);
-
-        case Commands::PUBLISH: return handlePUBLISH(pubsubManager, arguments);
-        case Commands::SUBSCRIBE: return handleSUBSCRIBE(pubsubManager, arguments, session->clientSock);
-        case Commands::UNSUBSCRIBE: return handleUNSUBSCRIBE(pubsubManager, arguments, session->clientSock);
-
-        case Commands::MULTI: return handleMULTI(session, arguments);
-        case Commands::DISCARD: return handleDISCARD(session, arguments);
-        case Commands::EXEC:
+        case Commands::DEL:
+        case Commands::EXISTS:
         {
-            //Done here because I would need to include server.cpp in commands.cpp for recursive calls to handleCommand
-            if (!session->transActive)
+            //Fan out per owning shard and sum the counts
+            std::vector<std::vector<std::string>> perShard(shards.size());
+            for (const auto& key : arguments) perShard[shardOf(key)].emplace_back(key); //Owned, the task may run after the read buffer moved on
+            struct Sum { int remaining = 0; int total = 0; };
+            auto sum = std::make_shared<Sum>();
+            for (const auto& keys : perShard) sum->remaining += !keys.empty();
+
+            auto slot = reserveReply(session);
+            for (int i = 0; i < static_cast<int>(shards.size()); ++i)
             {
-                return "-ERR EXEC without MULTI\r\n";
+                if (perShard[i].empty()) continue;
+                submitTo(origin, i, [cmd, keys = std::move(perShard[i])](KVStore& store)
+                {
+                    return cmd == Commands::DEL ? store.del(viewOf(keys)) : store.exists(viewOf(keys));
+                }, [this, slot, sum](const int count)
+                {
+                    sum->total += count;
+                    if (--sum->remaining == 0) completeReply(slot, ReplyWriter().integer(sum->total).take());
+                });
             }
+            return;
+        }
+        case Commands::MGET:
+        {
+            //Gather each shard's values back into argument order
+            std::vector<std::vector<std::string>> keysPerShard(shards.size());
+            std::vector<std::vector<size_t>> posPerShard(shards.size());
+            for (size_t i = 0; i < arguments.size(); ++i)
+            {
+                const int owner = shardOf(arguments[i]);
+                keysPerShard[owner].emplace_back(arguments[i]);
+                posPerShard[owner].push_back(i);
+            }
+            struct Gather { int remaining = 0; std::vector<std::optional<std::string>> values; };
+            auto gather = std::make_shared<Gather>();
+            gather->values.resize(arguments.size());
+            for (const auto& keys : keysPerShard) gather->remaining += !keys.empty();
+
+            auto slot = reserveReply(session);
+            for (int i = 0; i < static_cast<int>(shards.size()); ++i)
+            {
+                if (keysPerShard[i].empty()) continue;
+                submitTo(origin, i, [keys = std::move(keysPerShard[i])](KVStore& store)
+                {
+                    return store.mget(viewOf(keys));
+                }, [this, slot, gather, pos = std::move(posPerShard[i])](std::vector<std::optional<std::string>> values)
+                {
+                    for (size_t j = 0; j < pos.size(); ++j) gather->values[pos[j]] = std::move(values[j]);
+                    if (--gather->remaining > 0) return;
+
+                    completeReply(slot, ReplyWriter().array(gather->values).take());
+                });
+            }
+            return;
+        }
+        case Commands::FLUSHALL:
+        case Commands::SAVE:
+        {
+            auto remaining = std::make_shared<int>(static_cast<int>(shards.size()));
+            auto slot = reserveReply(session);
+            for (int i = 0; i < static_cast<int>(shards.size()); ++i)
+            {
+                submitTo(origin, i, [cmd](KVStore& store)
+                {
+                    if (cmd == Commands::FLUSHALL) store.flushall();
+                    else store.saveToDisk();
+                    return true;
+                }, [this, slot, remaining](bool)
+                {
+                    if (--*remaining == 0) completeReply(slot, std::string(RESP_OK));
+                });
+            }
+            return;
+        }
+        case Commands::CONFIG:
+        {
+            if (!iequals(command[1], "SET")) break; //GET is answered by the client's shard, every shard has the same settings
+
+            auto remaining = std::make_shared<int>(static_cast<int>(shards.size()));
+            auto slot = reserveReply(session);
+            for (int i = 0; i < static_cast<int>(shards.size()); ++i)
+            {
+                submitTo(origin, i, [this, command = materialize(command)](KVStore& store)
+                {
+                    return handleCommand(viewOf(command), nullptr, store);
+                }, [this, slot, remaining](OutputBuffer resp)
+                {
+                    if (--*remaining == 0) completeReply(slot, std::move(resp)); //Same reply from each
+                });
+            }
+            return;
+        }
+        case Commands::EXEC:
+        {
+            if (!session->transActive) break;
             const auto queue = std::move(session->transQueue);
 
             session->transActive = false;
             session->transQueue.clear();
 
-            std::string resp = "*" + std::to_string(queue.size()) + "\r\n";
-
+            //Each queued cmd runs on its owner in order, not atomic across shards
+            reply(session, ReplyWriter().arrayHeader(queue.size()).take());
             for (const auto& i : queue)
             {
                 assert(strToCmd(i[0]) != Commands::EXEC && "EXEC should never be in transaction queue!");
-                resp += handleCommand(i, session);
+                dispatch(viewOf(i), session);
             }
-            return resp;
+            return;
+        }
+        default: //Single key cmds go to the shard owning the key, keyless ones are answered by the shard the client is on
+        {
+            if (info->firstKey == 0) break;
+            const int owner = shardOf(command[info->firstKey]);
+            if (owner == origin) break;
+
+            auto slot = reserveReply(session);
+            submitTo(origin, owner, [this, command = materialize(command)](KVStore& store)
+            {
+                return handleCommand(viewOf(command), nullptr, store);
+            }, [this, slot](OutputBuffer resp)
+            {
+                completeReply(slot, std::move(resp));
+            });
+            return;
         }
+    }
+    reply(session, handleCommand(command, session, shards[origin]->store()));
+}
+
 
-        case Commands::CONFIG: return handleCONFIG(arguments);
-        case Commands::TYPE: return handleTYPE(kvstore, arguments);
-        case Commands::SAVE: return handleSAVE(kvstore, arguments);
-        default:
-            std::cerr << "Command not handled: " << command[0] << std::endl;
-            return std::format("-ERR unknown command '{}'", command[0]);
+OutputBuffer Server::handleCommand(const std::vector<std::string_view>& command, Session* session, KVStore& store)
+{
+    if (command.empty())
+    {
+        return "-ERR command line empty\r\n";
+    }
+
+    //Admission checks come from the registry, handlers only validate their own args
+    const CommandInfo* info = lookupCommand(command[0]);
+    if (!info)
+    {
+        std::cerr << "Command not handled: " << command[0] << std::endl;
+        return std::format("-ERR unknown command '{}'\r\n", command[0]);
+    }
+    if (!info->arityOk(command.size())) return std::format("-ERR wrong number of arguments for '{}' command\r\n", info->name);
+    if (session && session->transActive && !(info->flags & CMD_NOQUEUE))
+    {
+        session->transQueue.push_back(materialize(command));
+        return std::string(RESP_QUEUED);
     }
-}
\ No newline at end of file
+
+    const std::vector arguments(command.begin() + 1, command.end());
+    if (info->cmd == Commands::EXEC)
+    {
+        //Done here because I would need to include server.cpp in commands.cpp for recursive calls to handleCommand
+        if (!session->transActive)
+        {
+            return "-ERR EXEC without MULTI\r\n";
+        }
+        const auto queue = std::move(session->transQueue);
+
+        session->transActive = false;
+        session->transQueue.clear();
+
+        OutputBuffer resp(ReplyWriter().arrayHeader(queue.size()).take());
+
+        for (const auto& i : queue)
+        {
+            assert(strToCmd(i[0]) != Commands::EXEC && "EXEC should never be in transaction queue!");
+            resp.append(handleCommand(viewOf(i), session, store));
+        }
+        return resp;
+    }
+
+    if ((info->flags & CMD_DENYOOM) && !store.makeRoom()) return "-OOM command not allowed when used memory > 'maxmemory'.\r\n"; //Evicts first unless noeviction
+
+    CommandContext ctx{store, pubsubManager, session};
+    return info->handler(ctx, arguments);
+}
@@ -0,0 +1,119 @@
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <algorithm>
+#include <format>
+#include <iostream>
+
+#include "shard.hpp"
+#include "config.h"
+
+Shard::Shard(Server& server, const int id, const int shardCount, const IOBackend backend, const int listenSock)
+    : shardId(id), listenSock(listenSock),
+      kvstore(true, std::format("shard{}of{}-{}", id, shardCount, SAVEFILE_PATH), shardCount),
+      backlog(shardCount)
+{
+    for (int from = 0; from < shardCount; ++from)
+    {
+        inbox.push_back(from == id ? nullptr : std::make_unique<SPSCQueue<ShardTask>>(SHARD_QUEUE_SIZE));
+    }
+    loop = EventLoop::create(backend, server, listenSock, id);
+    loop->setWakeHandler([this] { drain(); });
+}
+
+Shard::~Shard()
+{
+    closeLoop();
+    close(listenSock);
+}
+
+void Shard::start(std::vector<std::unique_ptr<Shard>>& all)
+{
+    peers = &all;
+    thread = std::thread([this] { loop->run(); });
+
+    //One shard per core, keeps its keys and sessions in that core's cache
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(shardId % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) != 0) std::cerr << "Could not pin shard " << shardId << std::endl;
+}
+
+void Shard::stop()
+{
+    if (loop) loop->stop();
+}
+
+void Shard::join()
+{
+    if (thread.joinable()) thread.join();
+}
+
+void Shard::closeLoop()
+{
+    loop.reset();
+    dirty.clear();
+}
+
+void Shard::send(const int to, ShardTask task)
+{
+    Shard& target = *(*peers)[to];
+    if (!backlog[to].empty() || !target.inbox[shardId]->push(std::move(task)))
+    {
+        backlog[to].push_back(std::move(task)); //Order behind whatever is already waiting
+        hasBacklog.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst); //Pairs with the fence in drain() so either side sees the other
+        retryBacklog();
+        return;
+    }
+    if (!target.wakePending.exchange(true)) target.loop->wake();
+}
+
+void Shard::markDirty(Session* session)
+{
+    dirty.insert(session);
+}
+
+void Shard::forget(Session* session)
+{
+    dirty.erase(session);
+}
+
+void Shard::drain()
+{
+    wakePending.store(false); //Cleared first, a task pushed after this point wakes us again
+    for (size_t from = 0; from < inbox.size(); ++from)
+    {
+        if (!inbox[from]) continue;
+        while (auto task = inbox[from]->pop()) (*task)();
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Shard& sender = *(*peers)[from];
+        if (sender.hasBacklog.load()) sender.loop->wake(); //Room was just freed
+    }
+    if (hasBacklog.load()) retryBacklog();
+
+    //Replies that arrived from other shards go out once per drain, not once per task
+    std::vector<Session*> toFlush(dirty.begin(), dirty.end());
+    dirty.clear();
+    for (Session* session : toFlush) loop->flush(session); //Flushing one session never closes another
+}
+
+void Shard::retryBacklog()
+{
+    bool remaining = false;
+    for (size_t to = 0; to < backlog.size(); ++to)
+    {
+        if (backlog[to].empty()) continue;
+        Shard& target = *(*peers)[to];
+        bool moved = false;
+        while (!backlog[to].empty() && target.inbox[shardId]->push(std::move(backlog[to].front())))
+        {
+            backlog[to].pop_front();
+            moved = true;
+        }
+        if (!backlog[to].empty()) remaining = true;
+        if (moved && !target.wakePending.exchange(true)) target.loop->wake();
+    }
+    hasBacklog.store(remaining);
+}
@@ -9,7 +9,7 @@
 
 Snapshot::Snapshot(const std::string& fileName) : filePath((std::filesystem::path("data") / fileName).string()) {}
 
-void Snapshot::load(tbb::concurrent_hash_map<std::string, RESPValue>& dict) const
+void Snapshot::load(Dict<Object>& dict) const
 {
     try
     {
@@ -21,13 +21,13 @@ void Snapshot::load(tbb::concurrent_hash_map<std::string, RESPValue>& dict) cons
         std::cout << "Loading from: " << filePath << std::endl;
         binFile >> readMap;
 
-        dict = convertToConcurrentMap(readMap);
+        loadIntoDict(dict, readMap);
     }
     catch (std::exception& e) {
         std::cerr << "Fail in snapshot load(): " << e.what() << std::endl;
     }
 }
-void Snapshot::save(const tbb::concurrent_hash_map<std::string, RESPValue>& dict) const
+void Snapshot::save(const Dict<Object>& dict) const
 {
     try
     {
@@ -0,0 +1,404 @@
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "uringloop.hpp"
+#include "server.hpp"
+#include "config.h"
+
+namespace
+{
+    constexpr uint16_t BUF_GROUP = 0; //Single provided buffer group per ring
+
+    int uringSetup(const unsigned entries, io_uring_params* params)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+    int uringEnter(const int fd, const unsigned toSubmit, const unsigned minComplete, const unsigned flags)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+    int uringRegister(const int fd, const unsigned opcode, void* arg, const unsigned nrArgs)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+    }
+
+    template<class T> T loadAcquire(T* p) { return std::atomic_ref(*p).load(std::memory_order_acquire); }
+    template<class T> void storeRelease(T* p, T v) { std::atomic_ref(*p).store(v, std::memory_order_release); }
+}
+
+UringLoop::UringLoop(Server& server, const int listenSock, const int id) : EventLoop(id), server(server), listenSock(listenSock)
+{
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) throw std::runtime_error("UringLoop eventfd creation failed");
+    setupRing();
+    setupBufferRing();
+    probeMultishotRecv();
+}
+
+UringLoop::~UringLoop()
+{
+    for (const auto& [id, conn] : connections)
+    {
+        server.onDisconnect(conn.get());
+        close(conn->clientSock);
+    }
+    if (ringFd >= 0) close(ringFd); //Cancels whatever is still in flight before the memory below goes away
+    if (bufRing) munmap(bufRing, bufRingBytes);
+    if (sqes) munmap(sqes, sqesBytes);
+    if (cqRingPtr && cqRingPtr != sqRingPtr) munmap(cqRingPtr, cqRingBytes);
+    if (sqRingPtr) munmap(sqRingPtr, sqRingBytes);
+    if (wakeFd >= 0) close(wakeFd);
+}
+
+void UringLoop::setupRing()
+{
+    io_uring_params params{};
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    ringFd = uringSetup(URING_ENTRIES, &params);
+    if (ringFd < 0 && errno == EINVAL) //Older kernel without the optional flags
+    {
+        params = {};
+        ringFd = uringSetup(URING_ENTRIES, &params);
+    }
+    if (ringFd < 0) throw std::runtime_error("io_uring_setup failed");
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) throw std::runtime_error("io_uring too old (no single mmap)");
+
+    sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+
+    sqRingPtr = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRingPtr == MAP_FAILED) { sqRingPtr = nullptr; throw std::runtime_error("io_uring ring mmap failed"); }
+    cqRingPtr = sqRingPtr;
+
+    sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqesPtr = mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqesPtr == MAP_FAILED) throw std::runtime_error("io_uring sqe mmap failed");
+    sqes = static_cast<io_uring_sqe*>(sqesPtr);
+
+    auto* sqBase = static_cast<char*>(sqRingPtr);
+    sqHead = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+    sqEntries = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_entries);
+    auto* sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; ++i) sqArray[i] = i; //Slot i always points at sqe i
+    sqLocalTail = sqSubmitted = *sqTail;
+
+    auto* cqBase = static_cast<char*>(cqRingPtr);
+    cqHead = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+}
+
+void UringLoop::setupBufferRing()
+{
+    bufRingBytes = URING_BUF_COUNT * sizeof(io_uring_buf);
+    void* ringMem = mmap(nullptr, bufRingBytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ringMem == MAP_FAILED) throw std::runtime_error("Provided buffer ring mmap failed");
+    bufRing = static_cast<io_uring_buf_ring*>(ringMem);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing);
+    reg.ring_entries = URING_BUF_COUNT;
+    reg.bgid = BUF_GROUP;
+    if (uringRegister(ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) throw std::runtime_error("io_uring provided buffer ring not supported");
+
+    bufPool = std::make_unique<char[]>(static_cast<size_t>(URING_BUF_COUNT) * READ_CHUNK);
+    for (uint16_t bid = 0; bid < URING_BUF_COUNT; ++bid) returnBuffer(bid);
+    storeRelease(&bufRing->tail, bufTail);
+}
+
+void UringLoop::probeMultishotRecv()
+{
+    //Buffer rings are 5.19 but multishot recv is 6.0, and the opcode probe can't tell flags apart, so one is tried on a socket pair
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) throw std::runtime_error("io_uring probe socketpair failed");
+    constexpr char byte = 0;
+    [[maybe_unused]] auto written = write(pair[1], &byte, 1);
+
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = pair[0];
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->user_data = packData(Op::RECV, 0); //No connection has id 0
+    submit(0);
+
+    bool supported = false;
+    bool armed = true;
+    while (armed) //An old kernel rejects the flag at once, a new one keeps the recv armed until the peer's EOF ends it
+    {
+        if (uringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) break;
+        unsigned head = *cqHead;
+        for (const unsigned tail = loadAcquire(cqTail); head != tail; ++head)
+        {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            if (cqe.flags & IORING_CQE_F_BUFFER) returnBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            if (!(cqe.flags & IORING_CQE_F_MORE)) armed = false;
+            else if (cqe.res > 0)
+            {
+                supported = true;
+                shutdown(pair[1], SHUT_WR);
+            }
+        }
+        storeRelease(cqHead, head);
+        storeRelease(&bufRing->tail, bufTail);
+    }
+    close(pair[0]);
+    close(pair[1]);
+    if (armed || !supported) throw std::runtime_error("io_uring multishot recv not supported");
+}
+
+io_uring_sqe* UringLoop::getSqe()
+{
+    if (sqLocalTail - loadAcquire(sqHead) >= sqEntries) submit(0); //Full, hand what we have to the kernel first
+    io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sqLocalTail;
+    return sqe;
+}
+
+int UringLoop::submit(const unsigned waitNr)
+{
+    storeRelease(sqTail, sqLocalTail);
+    const unsigned toSubmit = sqLocalTail - sqSubmitted;
+    sqSubmitted = sqLocalTail;
+    return uringEnter(ringFd, toSubmit, waitNr, waitNr > 0 ? IORING_ENTER_GETEVENTS : 0);
+}
+
+void UringLoop::run()
+{
+    armAccept();
+    armWake();
+    while (running)
+    {
+        //One syscall both submits everything queued by the last batch and waits for the next completions
+        if (submit(1) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            std::cerr << "io_uring_enter failed: " << errno << std::endl;
+            break;
+        }
+        reapCompletions();
+    }
+}
+
+void UringLoop::stop()
+{
+    running = false;
+    wake();
+}
+
+void UringLoop::wake()
+{
+    constexpr uint64_t one = 1;
+    [[maybe_unused]] auto written = write(wakeFd, &one, sizeof(one));
+}
+
+void UringLoop::flush(Session* session)
+{
+    submitSends(*static_cast<Connection*>(session));
+}
+
+void UringLoop::reapCompletions()
+{
+    unsigned head = *cqHead;
+    const unsigned tail = loadAcquire(cqTail);
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        const auto op = static_cast<Op>(cqe.user_data >> 56);
+        const uint64_t id = cqe.user_data & ((1ULL << 56) - 1);
+
+        switch (op)
+        {
+            case Op::ACCEPT: onAccept(cqe.res, cqe.flags); break;
+            case Op::WAKE:
+            {
+                [[maybe_unused]] auto drained = read(wakeFd, &wakeValue, sizeof(wakeValue)); //Before the handler so no wake is lost
+                if (!running) break;
+                deliverPosted();
+                if (wakeHandler) wakeHandler();
+                armWake();
+                break;
+            }
+            case Op::RECV:
+            case Op::SEND:
+            {
+                const auto found = connections.find(id);
+                if (found == connections.end())
+                {
+                    if (cqe.flags & IORING_CQE_F_BUFFER) returnBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                    break;
+                }
+                Connection& conn = *found->second;
+                if (op == Op::RECV) onRecv(conn, cqe.res, cqe.flags);
+                else onSend(conn, cqe.res);
+                releaseIfDone(conn);
+                break;
+            }
+        }
+    }
+    storeRelease(cqHead, head);
+    storeRelease(&bufRing->tail, bufTail); //Publish every buffer handed back in this batch at once
+}
+
+void UringLoop::armAccept()
+{
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenSock;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC; //Every read and write goes through the ring, Pub/Sub included
+    sqe->user_data = packData(Op::ACCEPT, 0);
+}
+
+void UringLoop::armWake()
+{
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wakeFd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = packData(Op::WAKE, 0);
+}
+
+void UringLoop::armRecv(Connection& conn)
+{
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn.clientSock;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->user_data = packData(Op::RECV, conn.id);
+    conn.pendingOps++;
+}
+
+void UringLoop::submitSends(Connection& conn)
+{
+    if (conn.closing || conn.sendInFlight) return;
+    if (conn.sending.empty())
+    {
+        if (conn.writeBuffer.empty()) return;
+        std::swap(conn.sending, conn.writeBuffer);
+    }
+
+    //The kernel reads the iovecs and segments at completion time, both live in the connection until then
+    conn.sendMsg = msghdr{};
+    conn.sendMsg.msg_iov = conn.sendIov;
+    conn.sendMsg.msg_iovlen = conn.sending.fillIov(conn.sendIov, IOV_BATCH);
+
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn.clientSock;
+    sqe->addr = reinterpret_cast<uint64_t>(&conn.sendMsg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    sqe->user_data = packData(Op::SEND, conn.id);
+    conn.sendInFlight = true;
+    conn.pendingOps++;
+}
+
+void UringLoop::onAccept(const int res, const uint32_t flags)
+{
+    if (!(flags & IORING_CQE_F_MORE) && running) armAccept(); //Kernel dropped the multishot, re-arm
+    if (res < 0)
+    {
+        if (res != -EAGAIN && res != -EINTR) std::cerr << "io_uring accept failed: " << -res << std::endl;
+        return;
+    }
+
+    sockaddr_in connectionAddress{};
+    socklen_t addLen = sizeof(connectionAddress);
+    getpeername(res, reinterpret_cast<sockaddr*>(&connectionAddress), &addLen);
+
+    std::cout << "New connection from sock: " << res << std::endl;
+    auto conn = std::make_unique<Connection>(res, inet_ntoa(connectionAddress.sin_addr), this);
+    conn->id = nextId++;
+    armRecv(*conn);
+    connections.emplace(conn->id, std::move(conn));
+}
+
+void UringLoop::onRecv(Connection& conn, const int res, const uint32_t flags)
+{
+    const bool more = flags & IORING_CQE_F_MORE;
+    if (!more) conn.pendingOps--;
+
+    if (res > 0 && flags & IORING_CQE_F_BUFFER)
+    {
+        const auto bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        conn.readBuffer.append(bufPool.get() + static_cast<size_t>(bid) * READ_CHUNK, res);
+        returnBuffer(bid);
+        if (conn.closing) return;
+
+        try
+        {
+            server.processInput(&conn);
+        } catch (const std::exception& e) {
+            std::cerr << "Error during communication: " << e.what() << std::endl;
+            closeConnection(conn);
+            return;
+        }
+        submitSends(conn);
+    }
+    else if (res == 0 || (res < 0 && res != -ENOBUFS))
+    {
+        closeConnection(conn); //EOF or socket error
+        return;
+    }
+
+    if (!more && !conn.closing) armRecv(conn); //Ran out of provided buffers (or kernel stopped), buffers were just returned
+}
+
+void UringLoop::onSend(Connection& conn, const int res)
+{
+    conn.pendingOps--;
+    conn.sendInFlight = false;
+    if (res < 0 && res != -EAGAIN && res != -EINTR)
+    {
+        closeConnection(conn);
+        return;
+    }
+    if (res > 0) conn.sending.consume(res); //A short send leaves the tail queued for the next sendmsg
+    submitSends(conn);
+}
+
+void UringLoop::returnBuffer(const uint16_t bid)
+{
+    //Not bufRing->bufs, the flex array wrapper in the uapi header gets an extra 8 bytes of offset under C++
+    io_uring_buf& buf = reinterpret_cast<io_uring_buf*>(bufRing)[bufTail & (URING_BUF_COUNT - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(bufPool.get() + static_cast<size_t>(bid) * READ_CHUNK);
+    buf.len = READ_CHUNK;
+    buf.bid = bid;
+    ++bufTail; //Visible to the kernel once the tail is published
+}
+
+void UringLoop::closeConnection(Connection& conn)
+{
+    if (conn.closing) return;
+    conn.closing = true;
+    server.onDisconnect(&conn);
+    shutdown(conn.clientSock, SHUT_RDWR); //Completes the armed recv and any sends so the memory can be released
+}
+
+void UringLoop::releaseIfDone(Connection& conn)
+{
+    if (!conn.closing || conn.pendingOps > 0) return;
+    const int clientSock = conn.clientSock;
+    close(clientSock);
+    std::cout << "Closed connection from sock: " << clientSock << std::endl;
+    connections.erase(conn.id);
+}
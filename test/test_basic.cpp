@@ -49,7 +49,7 @@ TEST_CASE("DEL method", "[del][kvstore method][unit]")
     {
         REQUIRE(kv.del({"a"}) == 1);
         REQUIRE(kv.exists({"a"}) == 0);
-        REQUIRE(kv.get("a") == std::nullopt);
+        REQUIRE(kv.get("a").value == std::nullopt);
     }
 
     SECTION("Delete non-existing key")
@@ -146,8 +146,44 @@ TEST_CASE("FLUSHALL method", "[exists][kvstore method][unit]")
     SECTION("FLUSHALL expected")
     {
         kv.flushall();
-        REQUIRE(kv.get("a") == std::nullopt);
+        REQUIRE(kv.get("a").value == std::nullopt);
     }
 }
 
+TEST_CASE("Command registry", "[registry][unit]")
+{
+    SECTION("Lookup is case insensitive")
+    {
+        REQUIRE(lookupCommand("GET")->cmd == Commands::GET);
+        REQUIRE(lookupCommand("get")->cmd == Commands::GET);
+        REQUIRE(lookupCommand("hGeTaLl")->cmd == Commands::HGETALL);
+        REQUIRE(strToCmd("append") == Commands::APPEND);
+    }
+
+    SECTION("Unknown names")
+    {
+        REQUIRE(lookupCommand("") == nullptr);
+        REQUIRE(lookupCommand("GETT") == nullptr);
+        REQUIRE(lookupCommand("GE") == nullptr);
+        REQUIRE(lookupCommand(std::string(100, 'G')) == nullptr);
+        REQUIRE(strToCmd("nope") == Commands::UNKNOWN);
+    }
 
+    SECTION("Metadata")
+    {
+        const CommandInfo* set = lookupCommand("SET");
+        REQUIRE(set->arityOk(3));
+        REQUIRE(!set->arityOk(2));
+        REQUIRE((set->flags & CMD_WRITE));
+        REQUIRE(set->firstKey == 1);
+
+        const CommandInfo* del = lookupCommand("DEL");
+        REQUIRE(del->arityOk(5));
+        REQUIRE(!del->arityOk(1));
+        REQUIRE(del->lastKey == -1);
+
+        REQUIRE(lookupCommand("PING")->firstKey == 0);
+        REQUIRE((lookupCommand("EXEC")->flags & CMD_NOQUEUE));
+        REQUIRE((lookupCommand("HGETALL")->flags & CMD_SLOW));
+    }
+}
@@ -0,0 +1,191 @@
+#define CATCH_CONFIG_MAIN
+
+#include <chrono>
+#include <set>
+#include <thread>
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvstore.hpp"
+#include "dict.hpp"
+#include "slab.hpp"
+#include "config.h"
+
+TEST_CASE("Dict", "[dict][unit]")
+{
+    Dict<int> dict;
+
+    SECTION("Dict insert find and erase")
+    {
+        Dict<int>::accessor acc;
+        REQUIRE(dict.insert(acc, "a"));
+        acc->second = 1;
+        acc.release();
+        REQUIRE(!dict.insert("a", 2)); //Existing key is left alone
+        REQUIRE(dict.insert("b", 2));
+
+        Dict<int>::const_accessor read;
+        REQUIRE(dict.find(read, "a"));
+        REQUIRE(read->second == 1);
+        read.release();
+        REQUIRE(dict.size() == 2);
+
+        REQUIRE(dict.erase("a"));
+        REQUIRE(!dict.erase("a"));
+        REQUIRE(!dict.find(read, "a"));
+        REQUIRE(dict.find(acc, "b"));
+        dict.erase(acc);
+        REQUIRE(acc.empty());
+        REQUIRE(dict.size() == 0);
+    }
+
+    SECTION("Dict grows and reuses tombstones")
+    {
+        for (int i = 0; i < 20000; ++i) dict.insert(std::to_string(i), i);
+        for (int i = 0; i < 20000; i += 2) REQUIRE(dict.erase(std::to_string(i)));
+        for (int i = 0; i < 20000; i += 2) dict.insert(std::to_string(i), -i);
+        REQUIRE(dict.size() == 20000);
+
+        Dict<int>::const_accessor read;
+        for (int i = 0; i < 20000; ++i)
+        {
+            REQUIRE(dict.find(read, std::to_string(i)));
+            REQUIRE(read->second == (i % 2 ? i : -i));
+        }
+        read.release();
+
+        size_t seen = 0;
+        dict.forEach([&seen](const Dict<int>::Entry&) { ++seen; });
+        REQUIRE(seen == 20000);
+        dict.clear();
+        REQUIRE(dict.size() == 0);
+        REQUIRE(!dict.find(read, "1"));
+    }
+
+    SECTION("Dict samples distinct entries from a random spot")
+    {
+        REQUIRE(dict.sample(5, 42, [](const Dict<int>::Entry&) {}) == 0);
+        for (int i = 0; i < 1000; ++i) dict.insert(std::to_string(i), i);
+
+        std::set<int> seen;
+        REQUIRE(dict.sample(5, 7, [&seen](const Dict<int>::Entry& e) { seen.insert(e.second); }) == 5);
+        REQUIRE(seen.size() == 5);
+        seen.clear();
+        REQUIRE(dict.sample(2000, 99, [&seen](const Dict<int>::Entry& e) { seen.insert(e.second); }) == 1000); //Walks every stripe when asked for more
+        REQUIRE(seen.size() == 1000);
+    }
+
+    SECTION("Dict entries carry an inline deadline")
+    {
+        dict.insert("k", 7);
+        Dict<int>::accessor acc;
+        REQUIRE(dict.find(acc, "k"));
+        REQUIRE(!acc->hasDeadline());
+        dict.setDeadline(acc, 123456789);
+        dict.setDeadline(acc, 987654321); //Already has room, stays put
+        REQUIRE(acc->hasDeadline());
+        REQUIRE(acc->deadline() == 987654321);
+        REQUIRE(acc->key() == "k");
+        REQUIRE(acc->second == 7);
+        acc.release();
+
+        Dict<int>::const_accessor read;
+        REQUIRE(dict.find(read, "k"));
+        REQUIRE(read->deadline() == 987654321);
+        read.release();
+        REQUIRE(dict.find(acc, "k"));
+        dict.clearDeadline(acc);
+        REQUIRE(!acc->hasDeadline());
+        REQUIRE(acc->key() == "k");
+        REQUIRE(acc->second == 7);
+        REQUIRE(Dict<int>::entryBytes(1, true) > Dict<int>::entryBytes(1));
+    }
+
+    SECTION("Dict rehashes incrementally")
+    {
+        for (int i = 0; i < 5000; ++i) dict.insert(std::to_string(i), i);
+        REQUIRE(dict.rehashStats().started > 0);
+
+        Dict<int>::const_accessor read;
+        for (int i = 0; i < 5000; ++i) //Keys still in an old table are found too
+        {
+            REQUIRE(dict.find(read, std::to_string(i)));
+            REQUIRE(read->second == i);
+        }
+        read.release();
+        REQUIRE(dict.erase("0"));
+        REQUIRE(!dict.erase("0"));
+
+        while (dict.rehashFor(std::chrono::microseconds(1000))) {}
+        const auto stats = dict.rehashStats();
+        REQUIRE(stats.rehashing == 0);
+        REQUIRE(stats.slotsLeft == 0);
+        REQUIRE(stats.moved > 0);
+        REQUIRE(dict.size() == 4999);
+        REQUIRE(dict.find(read, "4999"));
+    }
+
+    SECTION("Dict concurrent writers")
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; ++t)
+        {
+            threads.emplace_back([&dict, t]
+            {
+                for (int i = 0; i < 2000; ++i)
+                {
+                    Dict<int>::accessor acc;
+                    dict.insert(acc, std::to_string(i % 500));
+                    ++acc->second; //Shared keys, increments only add up if the stripe lock holds
+                    acc.release();
+                    if (i % 7 == t) dict.insert("t" + std::to_string(t) + "_" + std::to_string(i), i);
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+
+        long long total = 0;
+        dict.forEach([&total](const Dict<int>::Entry& entry)
+        {
+            if (entry.key()[0] != 't') total += entry.second;
+        });
+        REQUIRE(total == 8 * 2000);
+    }
+}
+
+TEST_CASE("Slab", "[slab][unit]")
+{
+    Slab slab;
+    void* a = slab.allocate(40);
+    void* b = slab.allocate(36); //Same 40 byte class
+    REQUIRE(a != b);
+    REQUIRE(slab.bytesUsed() == 80);
+    REQUIRE(slab.bytesReserved() == SLAB_PAGE);
+
+    slab.deallocate(a, 40);
+    REQUIRE(slab.allocate(33) == a); //Freed chunk is reused first
+    void* large = slab.allocate(SLAB_MAX_CHUNK + 1);
+    REQUIRE(slab.bytesReserved() == SLAB_PAGE + SLAB_MAX_CHUNK + 1);
+    slab.deallocate(large, SLAB_MAX_CHUNK + 1);
+    slab.deallocate(a, 40);
+    slab.deallocate(b, 36);
+    REQUIRE(slab.bytesUsed() == 0);
+}
+
+TEST_CASE("Reads leave the keyspace alone", "[dict][unit]")
+{
+    KVStore kv(false);
+    int keys = 0;
+    while (keys < 5000 || kv.rehashStats().rehashing == 0) kv.set("key" + std::to_string(keys++), "v"); //Until a table is mid rehash, however many stripes
+    kv.lpush({"list", "a"});
+    kv.sadd({"set", "a"});
+    kv.hset({"hash", "f", "v"});
+    const auto before = kv.rehashStats();
+    REQUIRE(before.rehashing > 0);
+
+    for (int i = 0; i < keys; ++i) REQUIRE(kv.get("key" + std::to_string(i)).value == "v");
+    REQUIRE(kv.llen("list").value == 1);
+    REQUIRE(kv.sismember("set", "a").value);
+    REQUIRE(kv.hget("hash", "f").value == "v");
+    REQUIRE(kv.rehashStats().moved == before.moved); //Shared lock, no rehash step
+    REQUIRE(kv.rehashStats().slotsLeft == before.slotsLeft);
+}
@@ -0,0 +1,299 @@
+#define CATCH_CONFIG_MAIN
+
+#include <limits>
+#include <unordered_set>
+#include <catch2/catch_test_macros.hpp>
+
+#include "kvstore.hpp"
+#include "object.hpp"
+#include "intset.hpp"
+#include "listpack.hpp"
+#include "quicklist.hpp"
+#include "config.h"
+
+TEST_CASE("Object", "[object][unit]")
+{
+    SECTION("Object short strings stay inline")
+    {
+        Object obj = Object::str("short");
+        REQUIRE(obj.type() == storeType::STR);
+        REQUIRE(obj.encoding() == Encoding::EMBSTR);
+        REQUIRE(obj.str() == "short");
+        REQUIRE(obj.append("er") == 7);
+        REQUIRE(obj.encoding() == Encoding::EMBSTR);
+        REQUIRE(obj.append(" than twenty bytes") == 25); //Outgrows the inline space
+        REQUIRE(obj.encoding() == Encoding::BOXED);
+        REQUIRE(obj.str() == "shorter than twenty bytes");
+        REQUIRE(!obj.sharedStr()); //Too small to pin, replies copy it
+        std::string read;
+        obj.readStr([&read](const std::string_view v) { read = v; });
+        REQUIRE(read == "shorter than twenty bytes");
+    }
+
+    SECTION("Object keeps its access clock across re-encoding")
+    {
+        Object obj = Object::str("12");
+        obj.touch(LRU_CLOCK_MAX);
+        REQUIRE(obj.lruClock() == LRU_CLOCK_MAX);
+        REQUIRE(obj.encoding() == Encoding::INT);
+        obj.append("ab"); //INT to EMBSTR
+        REQUIRE(obj.type() == storeType::STR);
+        REQUIRE(obj.lruClock() == LRU_CLOCK_MAX);
+        REQUIRE(idleTicks(LRU_CLOCK_MAX, 4) == 5); //Across the wrap
+    }
+
+    SECTION("Object boxes containers and long strings")
+    {
+        Object set(RESPValue{storeType::SET, std::unordered_set<std::string>{"a", std::string(LISTPACK_MAX_VALUE + 1, 'b')}}); //Too long for a listpack
+        REQUIRE(set.type() == storeType::SET);
+        REQUIRE(set.encoding() == Encoding::BOXED);
+        REQUIRE(set.as<std::unordered_set<std::string>>().size() == 2);
+        REQUIRE(set.toValue().type == storeType::SET);
+
+        Object moved = std::move(set);
+        REQUIRE(moved.as<std::unordered_set<std::string>>().contains("a"));
+        REQUIRE(set.str().empty()); //Moved from is an empty string
+
+        const std::string large(ZERO_COPY_MIN, 'x');
+        Object big = Object::str(large);
+        REQUIRE(big.encoding() == Encoding::BOXED);
+        REQUIRE(big.sharedStr());
+        REQUIRE(big.sharedStr().get() == big.sharedStr().get()); //Shared, not copied
+    }
+
+    SECTION("Object integers are stored as int64")
+    {
+        Object num = Object::str("-9223372036854775808");
+        REQUIRE(num.type() == storeType::STR);
+        REQUIRE(num.encoding() == Encoding::INT);
+        REQUIRE(num.toInt() == std::numeric_limits<long long>::min());
+        REQUIRE(num.str() == "-9223372036854775808");
+        REQUIRE(num.toValue().getStr() == "-9223372036854775808");
+
+        for (const char* text : {"007", "-0", "+5", " 5", "5 ", "-", "", "9223372036854775808"})
+        {
+            REQUIRE(Object::str(text).encoding() != Encoding::INT); //Would not render back to the same bytes
+        }
+        REQUIRE(Object::str("007").toInt() == std::nullopt);
+        REQUIRE(Object(RESPValue{storeType::STR, std::string("42")}).encoding() == Encoding::INT);
+
+        Object appended = Object::str("12");
+        REQUIRE(appended.append("3") == 3);
+        REQUIRE(appended.encoding() == Encoding::EMBSTR);
+        REQUIRE(appended.toInt() == 123);
+        appended.setInt(124);
+        REQUIRE(appended.encoding() == Encoding::INT);
+        REQUIRE(appended.str() == "124");
+    }
+}
+
+TEST_CASE("Listpack", "[listpack][unit]")
+{
+    SECTION("Listpack entries")
+    {
+        Listpack lp;
+        const std::string longer(300, 'x'); //Two byte length prefix
+        lp.pushBack("b");
+        lp.pushFront("a");
+        lp.pushBack(longer);
+        lp.insert(2, "");
+        REQUIRE(lp.size() == 4);
+        REQUIRE(std::vector<std::string>(lp.begin(), lp.end()) == std::vector<std::string>{"a", "b", "", longer});
+        REQUIRE(lp.bytes() == 1 + 1 + 1 + 1 + 1 + 2 + 300);
+
+        REQUIRE(lp.find(longer) == 3);
+        REQUIRE(lp.find("b", 2) == std::nullopt); //Only even entries are fields
+        lp.replace(1, "bb");
+        lp.erase(2, 2);
+        REQUIRE(lp.size() == 2);
+        REQUIRE(lp.at(1) == "bb");
+        lp.erase(0, 2);
+        REQUIRE(lp.empty());
+        REQUIRE(lp.bytes() == 0);
+    }
+
+    SECTION("Listpack objects")
+    {
+        Object hash(RESPValue{storeType::HASH, std::unordered_map<std::string, std::string>{{"f", "v"}, {"g", "w"}}});
+        REQUIRE(hash.type() == storeType::HASH);
+        REQUIRE(hash.encoding() == Encoding::LISTPACK);
+        REQUIRE(hash.listpack().size() == 4);
+        REQUIRE(boost::get<std::unordered_map<std::string, std::string>>(hash.toValue().value).at("g") == "w");
+
+        Object moved = std::move(hash);
+        moved.unpack();
+        REQUIRE(moved.encoding() == Encoding::BOXED);
+        REQUIRE(moved.as<std::unordered_map<std::string, std::string>>().size() == 2);
+
+        Object set(RESPValue{storeType::SET, std::unordered_set<std::string>{"a"}});
+        REQUIRE(set.encoding() == Encoding::LISTPACK);
+        REQUIRE(set.toValue().type == storeType::SET);
+    }
+
+    SECTION("Listpack collections convert past the limits")
+    {
+        KVStore kv(false);
+        kv.hset({"h", "f", "v"});
+        kv.sadd({"s", "a", "a", "b"});
+        kv.rpush({"l", "a", "b"});
+        kv.lpush({"l", "y", "z"});
+        REQUIRE(kv.lrange("l", 0, -1).value == std::vector<std::optional<std::string>>{"z", "y", "a", "b"});
+
+        for (int i = 0; i <= static_cast<int>(LISTPACK_MAX_ENTRIES); ++i)
+        {
+            const std::string n = std::to_string(i);
+            kv.hset({"h", n, n});
+            kv.sadd({"s", n});
+            kv.rpush({"l", n});
+        }
+        REQUIRE(kv.hlen("h").value == LISTPACK_MAX_ENTRIES + 2);
+        REQUIRE(kv.hget("h", "f").value == "v");
+        REQUIRE(kv.hget("h", "128").value == "128");
+        REQUIRE(kv.scard("s").value == LISTPACK_MAX_ENTRIES + 3);
+        REQUIRE(kv.sismember("s", "a").value);
+        REQUIRE(kv.llen("l").value == LISTPACK_MAX_ENTRIES + 5);
+        REQUIRE(kv.lindex("l", 0).value == "z");
+
+        const std::string big(LISTPACK_MAX_VALUE + 1, 'v');
+        kv.hset({"h2", "f", "v"});
+        kv.hset({"h2", "f", big});
+        REQUIRE(kv.hget("h2", "f").value == big);
+        REQUIRE(kv.hset({"h2", "g", "w"}).value == 1);
+        REQUIRE(kv.hdel({"h2", "f", "g"}).value == 2);
+        REQUIRE(kv.exists({"h2"}) == 0);
+    }
+}
+
+TEST_CASE("Intset", "[intset][unit]")
+{
+    SECTION("Intset widths")
+    {
+        Intset set;
+        for (const long long n : {5, -3, 100, 5}) set.insert(n);
+        REQUIRE(set.size() == 3);
+        REQUIRE(set.entryWidth() == 2);
+        REQUIRE(set.contains(-3));
+        REQUIRE(!set.contains(4));
+        REQUIRE(!set.contains(1LL << 40)); //Wider than the set
+
+        REQUIRE(set.insert(70000)); //Upgrades to 4 bytes, goes at the end
+        REQUIRE(set.entryWidth() == 4);
+        REQUIRE(set.insert(std::numeric_limits<long long>::min())); //8 bytes, goes at the front
+        REQUIRE(set.entryWidth() == 8);
+        REQUIRE(set.bytes() == 5 * 8);
+        for (const long long n : {std::numeric_limits<long long>::min(), -3LL, 5LL, 100LL, 70000LL})
+        {
+            REQUIRE(set.contains(n));
+        }
+        REQUIRE(set.at(0) == std::numeric_limits<long long>::min());
+        REQUIRE(set.at(4) == 70000);
+
+        REQUIRE(set.erase(5));
+        REQUIRE(!set.erase(5));
+        REQUIRE(set.at(1) == -3);
+        REQUIRE(set.at(2) == 100);
+    }
+
+    SECTION("Intset scan and search agree")
+    {
+        Intset set;
+        for (long long n = 0; n < 300; n += 3) set.insert(n); //Past the SIMD scan size
+        for (long long n = -1; n < 300; ++n) REQUIRE(set.contains(n) == (n >= 0 && n % 3 == 0));
+        Intset small;
+        for (long long n = 0; n < 30; n += 3) small.insert(n * 1000); //4 byte entries
+        for (long long n = -1; n < 30; ++n) REQUIRE(small.contains(n * 1000) == (n >= 0 && n % 3 == 0));
+    }
+
+    SECTION("Intset sets convert on a string member or past the limit")
+    {
+        KVStore kv(false);
+        REQUIRE(kv.sadd({"s", "3", "1", "2", "1"}).value == 3);
+        REQUIRE(kv.smembers("s").value == std::vector<std::optional<std::string>>{"1", "2", "3"}); //Sorted
+        REQUIRE(!kv.sismember("s", "01").value);
+        REQUIRE(kv.sadd({"s", "x", "4"}).value == 2);
+        REQUIRE(kv.sismember("s", "x").value);
+        REQUIRE(kv.sismember("s", "2").value);
+        REQUIRE(kv.srem({"s", "2", "x"}).value == 2);
+        REQUIRE(kv.scard("s").value == 3);
+
+        for (int i = 0; i <= static_cast<int>(INTSET_MAX_ENTRIES); ++i) kv.sadd({"big", std::to_string(i)});
+        REQUIRE(kv.scard("big").value == INTSET_MAX_ENTRIES + 1);
+        REQUIRE(kv.sismember("big", "512").value);
+        REQUIRE(kv.spop("big", 1).value.size() == 1);
+
+        Object loaded(RESPValue{storeType::SET, std::unordered_set<std::string>{"-7", "9"}});
+        REQUIRE(loaded.encoding() == Encoding::INTSET);
+        REQUIRE(boost::get<std::unordered_set<std::string>>(loaded.toValue().value).contains("-7"));
+    }
+}
+
+TEST_CASE("Quicklist", "[quicklist][unit]")
+{
+    SECTION("Quicklist ends and lookups across nodes")
+    {
+        Quicklist list(64, 1); //Tiny nodes, everything but the first and last compressed
+        for (int i = 0; i < 100; ++i) list.pushBack("value-" + std::to_string(i));
+        for (int i = 1; i <= 20; ++i) list.pushFront("front-" + std::to_string(i));
+        REQUIRE(list.size() == 120);
+        REQUIRE(list.nodeCount() > 10);
+        REQUIRE(list.compressedNodes() > 0);
+        REQUIRE(list.compressedNodes() <= list.nodeCount() - 2);
+
+        REQUIRE(*list.at(0) == "front-20");
+        REQUIRE(*list.at(19) == "front-1");
+        REQUIRE(*list.at(20) == "value-0");
+        REQUIRE(*list.at(119) == "value-99");
+        REQUIRE(!list.at(120));
+
+        REQUIRE(list.set(70, "changed"));
+        REQUIRE(*list.at(70) == "changed");
+        REQUIRE(!list.set(120, "x"));
+
+        std::vector<std::string> range;
+        list.forRange(68, 72, [&range](std::string_view v) { range.emplace_back(v); });
+        REQUIRE(range == std::vector<std::string>{"value-48", "value-49", "changed", "value-51", "value-52"});
+
+        REQUIRE(*list.popFront() == "front-20");
+        REQUIRE(*list.popBack() == "value-99");
+        while (list.size() > 1) list.popBack();
+        REQUIRE(list.nodeCount() == 1);
+        REQUIRE(*list.popBack() == "front-19");
+        REQUIRE(!list.popFront());
+        REQUIRE(list.nodeCount() == 0);
+    }
+
+    SECTION("Quicklist remove from either end")
+    {
+        Quicklist list(48, 1);
+        for (int i = 0; i < 60; ++i) list.pushBack(i % 3 == 0 ? "x" : "entry-" + std::to_string(i));
+        REQUIRE(list.remove("x", 2) == 2); //From the head
+        REQUIRE(*list.at(0) == "entry-1");
+        REQUIRE(list.remove("x", -3) == 3); //From the tail
+        REQUIRE(*list.at(list.size() - 9) == "x"); //48, the last one left
+        REQUIRE(list.remove("x", 0) == 15); //The rest
+        REQUIRE(list.remove("x", 0) == 0);
+        REQUIRE(list.size() == 40);
+
+        size_t seen = 0;
+        list.forEach([&seen](std::string_view v) { seen += v != "x"; });
+        REQUIRE(seen == 40);
+    }
+
+    SECTION("Quicklist lists from a listpack past the limit")
+    {
+        KVStore kv(false);
+        for (int i = 0; i <= static_cast<int>(LISTPACK_MAX_ENTRIES); ++i) kv.rpush({"l", std::to_string(i)});
+        REQUIRE(kv.llen("l").value == LISTPACK_MAX_ENTRIES + 1);
+        REQUIRE(kv.lindex("l", 128).value == "128");
+        REQUIRE(kv.lrange("l", -2, -1).value == std::vector<std::optional<std::string>>{"127", "128"});
+        REQUIRE(kv.lset("l", 5, "five").value);
+        REQUIRE(kv.lrem("l", 0, "five").value == 1);
+        REQUIRE(kv.lpop("l").value == "0");
+        REQUIRE(kv.rpop("l").value == "128");
+        REQUIRE(kv.llen("l").value == LISTPACK_MAX_ENTRIES - 2);
+
+        Object loaded(RESPValue{storeType::LIST, std::deque<std::string>{"a", std::string(LISTPACK_MAX_VALUE + 1, 'b')}});
+        REQUIRE(loaded.encoding() == Encoding::QUICKLIST);
+        REQUIRE(boost::get<std::deque<std::string>>(loaded.toValue().value).front() == "a");
+    }
+}
@@ -1,5 +1,6 @@
 #define CATCH_CONFIG_MAIN
 
+#include <chrono>
 #include <thread>
 #include <catch2/catch_test_macros.hpp>
 
@@ -7,6 +8,8 @@
 #include "kvstore.hpp"
 #include "commands.hpp"
 #include "util.hpp"
+#include "clock.hpp"
+#include "timerwheel.hpp"
 
 
 TEST_CASE("EXPIRE method", "[expire][kvstore method][unit]")
@@ -31,7 +34,7 @@ TEST_CASE("EXPIRE method", "[expire][kvstore method][unit]")
     {
         kv.expire("b", 1);
         std::this_thread::sleep_for(std::chrono::seconds(1));
-        REQUIRE(kv.get("b") == std::nullopt);
+        REQUIRE(kv.get("b").value == std::nullopt);
         REQUIRE(kv.ttl("b") == -2);
     }
 
@@ -136,4 +139,98 @@ TEST_CASE("PERSIST command", "[persist][command handler][unit]")
         REQUIRE(handlePERSIST(kv, {}) == argumentError("1", 0));
         REQUIRE(handlePERSIST(kv, {"a", "b"}) == argumentError("1", 2));
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Millisecond ttl commands", "[expire][command handler][unit]")
+{
+    KVStore kv(false);
+    kv.set("a", "1");
+
+    SECTION("PEXPIRE and PTTL")
+    {
+        REQUIRE(handlePTTL(kv, {"a"}) == ":-1\r\n");
+        REQUIRE(handlePEXPIRE(kv, {"a", "1500"}) == ":1\r\n");
+        const long long left = kv.pttl("a");
+        REQUIRE(left > 1000);
+        REQUIRE(left <= 1500);
+        REQUIRE(kv.ttl("a") == 2); //Rounded
+        REQUIRE(handlePEXPIRE(kv, {"b", "100"}) == ":0\r\n");
+        REQUIRE(handlePTTL(kv, {"b"}) == ":-2\r\n");
+
+        REQUIRE(handlePEXPIRE(kv, {"a", "50"}) == ":1\r\n");
+        std::this_thread::sleep_for(std::chrono::milliseconds(80));
+        REQUIRE(kv.get("a").value == std::nullopt);
+    }
+
+    SECTION("EXPIREAT and PEXPIREAT take unix times")
+    {
+        const long long now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        REQUIRE(handleEXPIREAT(kv, {"a", std::to_string(now + 100)}) == ":1\r\n");
+        REQUIRE(kv.ttl("a") >= 99);
+        REQUIRE(kv.ttl("a") <= 101);
+        REQUIRE(handlePEXPIREAT(kv, {"a", std::to_string((now + 50) * 1000)}) == ":1\r\n");
+        REQUIRE(kv.ttl("a") >= 49);
+        REQUIRE(kv.ttl("a") <= 51);
+        REQUIRE(handleEXPIREAT(kv, {"a", std::to_string(now - 10)}) == ":1\r\n"); //Past, gone on the next touch
+        REQUIRE(handleTTL(kv, {"a"}) == ":-2\r\n");
+    }
+
+    SECTION("Bad times")
+    {
+        REQUIRE(handlePEXPIRE(kv, {"a", "soon"}) == "-ERR value is not an integer or out of range\r\n");
+        REQUIRE(handleEXPIRE(kv, {"a", "9223372036854775807"}) == "-ERR invalid expire time in 'expire' command\r\n");
+        REQUIRE(handlePEXPIREAT(kv, {"a"}) == argumentError("2", 1));
+        REQUIRE(handlePTTL(kv, {}) == argumentError("1", 0));
+        REQUIRE(kv.ttl("a") == -1);
+    }
+}
+
+TEST_CASE("Timer wheel", "[expire][unit]")
+{
+    TimerWheel wheel(1000);
+    std::vector<int64_t> fired;
+    const auto collect = [&fired](const TimerNode& node) { fired.push_back(node.deadline); };
+
+    SECTION("Timers fire in deadline order across levels")
+    {
+        const std::vector<int64_t> deadlines = {1005, 1070, 6000, 301000, 90000000, 1000 + TimerWheel::SPAN + 10, 990};
+        std::vector<TimerNode> nodes(deadlines.size());
+        for (size_t i = 0; i < nodes.size(); ++i) wheel.arm(nodes[i], deadlines[i]);
+        REQUIRE(wheel.size() == 7);
+
+        REQUIRE(wheel.advance(1004, 100, collect) == 1); //Overdue fires on the first call
+        REQUIRE(fired == std::vector<int64_t>{990});
+        TimerNode late;
+        wheel.arm(late, 1002); //Behind the wheel already
+        REQUIRE(wheel.advance(1004, 100, collect) == 1); //Same now, still due
+        REQUIRE(fired.back() == 1002);
+        wheel.disarm(nodes[2]);
+        wheel.arm(nodes[1], 5000); //Moved later
+        REQUIRE(wheel.advance(301000, 100, collect) == 3);
+        REQUIRE(fired == std::vector<int64_t>{990, 1002, 1005, 5000, 301000});
+        REQUIRE(wheel.advance(89999999, 100, collect) == 0);
+        REQUIRE(wheel.advance(2000 + TimerWheel::SPAN, 100, collect) == 2); //Parked past the span, placed again on the way
+        REQUIRE(fired.back() == 1000 + TimerWheel::SPAN + 10);
+        REQUIRE(wheel.size() == 0);
+        REQUIRE(!TimerWheel::armed(nodes[0]));
+    }
+
+    SECTION("A limit leaves the rest for the next call")
+    {
+        std::vector<TimerNode> nodes(10);
+        for (auto& node : nodes) wheel.arm(node, 1500);
+        REQUIRE(wheel.advance(2000, 3, collect) == 3);
+        REQUIRE(wheel.lag(2000) > 0);
+        REQUIRE(wheel.advance(2000, 100, collect) == 7);
+        REQUIRE(wheel.lag(2000) == 0);
+    }
+}
+
+TEST_CASE("Coarse clock", "[clock][unit]")
+{
+    const int64_t start = CoarseClock::nowMs();
+    REQUIRE(start <= CoarseClock::preciseMs());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(CoarseClock::nowMs() > start); //The ticker moved it
+    REQUIRE(CoarseClock::reached(CoarseClock::preciseMs())); //Even when the cached time is a tick behind
+    REQUIRE(!CoarseClock::reached(CoarseClock::preciseMs() + 60000));
+}
@@ -16,16 +16,16 @@ TEST_CASE("HSET and HGET methods", "[hset/hget][kvstore method][unit]")
 
     SECTION("Hset and Hget new elements expected and overwrite field")
     {
-        REQUIRE(kv.hset({"myhash", "f1", "v1"}) == 1);
-        REQUIRE(kv.hget("myhash", "f1") == "v1");
-        REQUIRE(kv.hset({"myhash", "f1", "v2"}) == 0);
-        REQUIRE(kv.hget("myhash", "f1") == "v2");
+        REQUIRE(kv.hset({"myhash", "f1", "v1"}).value == 1);
+        REQUIRE(kv.hget("myhash", "f1").value == "v1");
+        REQUIRE(kv.hset({"myhash", "f1", "v2"}).value == 0);
+        REQUIRE(kv.hget("myhash", "f1").value == "v2");
     }
 
     SECTION("Hset Hget empty key and empty field list")
     {
-        REQUIRE(kv.hget("otherhash", "f1") == std::nullopt);
-        REQUIRE(kv.hget("myhash", "otherfield") == std::nullopt);
+        REQUIRE(kv.hget("otherhash", "f1").value == std::nullopt);
+        REQUIRE(kv.hget("myhash", "otherfield").value == std::nullopt);
     }
 }
 TEST_CASE("HSET and HGET commands", "[hset/hget][command handler][unit]")
@@ -59,13 +59,13 @@ TEST_CASE("HDEL and HEXISTS methods", "[hdel/hexists][kvstore method][unit]")
 
     SECTION("Hdel and Hexists new elements expected")
     {
-        REQUIRE(kv.hdel({"myhash", "f1"}) == 1);
-        REQUIRE(kv.hexists("myhash", "f1") == false);
-        REQUIRE(kv.hexists("myhash", "f2") == true);
+        REQUIRE(kv.hdel({"myhash", "f1"}).value == 1);
+        REQUIRE(kv.hexists("myhash", "f1").value == false);
+        REQUIRE(kv.hexists("myhash", "f2").value == true);
     }
 
     SECTION("Hdel non-existing field") {
-        REQUIRE(kv.hdel({"myhash", "f3"}) == 0);
+        REQUIRE(kv.hdel({"myhash", "f3"}).value == 0);
     }
 }
 TEST_CASE("HDEL and HEXISTS commands", "[hdel/hexists][command handler][unit]")
@@ -100,11 +100,11 @@ TEST_CASE("HLEN, HKEYS, HVALS methods", "[hlen/hkeys/hvals][kvstore method][unit
 
     SECTION("Hlen expected")
     {
-        REQUIRE(kv.hlen("myhash") == 3);
+        REQUIRE(kv.hlen("myhash").value == 3);
     }
 
     SECTION("Hkeys returns all fields") {
-        auto keys = kv.hkeys("myhash");
+        auto keys = kv.hkeys("myhash").value;
         std::set<std::string> expected = {"f1", "f2", "f3"};
         std::set<std::string> actual;
         for (const auto& key : keys) {
@@ -116,7 +116,7 @@ TEST_CASE("HLEN, HKEYS, HVALS methods", "[hlen/hkeys/hvals][kvstore method][unit
     }
 
     SECTION("Hvals returns all values") {
-        auto vals = kv.hvals("myhash");
+        auto vals = kv.hvals("myhash").value;
         std::set<std::string> expected = {"v1", "v2", "v3"};
         std::set<std::string> actual;
         for (const auto& val : vals) {
@@ -154,20 +154,20 @@ TEST_CASE("HKEYS and HVALS commands", "[hkeys/hvals][command handler][unit]")
 
     SECTION("HKEYS and HVALS expected")
     {
-        REQUIRE(handleHKEYS(kv, {"myhash"}) == "*2\r\n$2\r\nf2\r\n$2\r\nf1\r\n");
-        REQUIRE(handleHKEYS(kv, {"otherhash"}) == "*0\r\n");
-        REQUIRE(handleHVALS(kv, {"myhash"}) == "*2\r\n$2\r\nv2\r\n$2\r\nv1\r\n");
-        REQUIRE(handleHVALS(kv, {"otherhash"}) == "*0\r\n");
+        REQUIRE(handleHKEYS(kv, {"myhash"}).str() == "*2\r\n$2\r\nf1\r\n$2\r\nf2\r\n"); //Small hashes are listpacks, insertion order
+        REQUIRE(handleHKEYS(kv, {"otherhash"}).str() == "*0\r\n");
+        REQUIRE(handleHVALS(kv, {"myhash"}).str() == "*2\r\n$2\r\nv1\r\n$2\r\nv2\r\n");
+        REQUIRE(handleHVALS(kv, {"otherhash"}).str() == "*0\r\n");
     }
 
     SECTION("HKEYS and HVALS bad args")
     {
-        REQUIRE(handleHKEYS(kv, {}) == argumentError("1", 0));
-        REQUIRE(handleHKEYS(kv, {"myhash", "more"}) == argumentError("1", 2));
-        REQUIRE(handleHKEYS(kv, {"listkey"}) == "-ERR wrong type\r\n");
-        REQUIRE(handleHVALS(kv, {}) == argumentError("1", 0));
-        REQUIRE(handleHVALS(kv, {"myhash", "more"}) == argumentError("1", 2));
-        REQUIRE(handleHVALS(kv, {"listkey"}) == "-ERR wrong type\r\n");
+        REQUIRE(handleHKEYS(kv, {}).str() == argumentError("1", 0));
+        REQUIRE(handleHKEYS(kv, {"myhash", "more"}).str() == argumentError("1", 2));
+        REQUIRE(handleHKEYS(kv, {"listkey"}).str() == "-ERR wrong type\r\n");
+        REQUIRE(handleHVALS(kv, {}).str() == argumentError("1", 0));
+        REQUIRE(handleHVALS(kv, {"myhash", "more"}).str() == argumentError("1", 2));
+        REQUIRE(handleHVALS(kv, {"listkey"}).str() == "-ERR wrong type\r\n");
     }
 }
 
@@ -178,7 +178,7 @@ TEST_CASE("HMGET methods", "[hmget][kvstore method][unit]")
 
     SECTION("Hmget expected")
     {
-        auto vals = kv.hmget({"myhash", "f1", "f2", "f3", "f4"});
+        auto vals = kv.hmget({"myhash", "f1", "f2", "f3", "f4"}).value;
         REQUIRE(vals.size() == 4);
         REQUIRE(vals[0] == "v1");
         REQUIRE(vals[1] == "v2");
@@ -188,7 +188,7 @@ TEST_CASE("HMGET methods", "[hmget][kvstore method][unit]")
 
     SECTION("Hmget on non-existing hash")
     {
-        auto vals = kv.hmget({"nohash", "f1", "f2"});
+        auto vals = kv.hmget({"nohash", "f1", "f2"}).value;
         REQUIRE(vals.size() == 2);
         REQUIRE(vals[0] == std::nullopt);
         REQUIRE(vals[1] == std::nullopt);
@@ -220,7 +220,7 @@ TEST_CASE("HGETALL method", "[hgetall][kvstore method][unit]")
 
     SECTION("Hgetall returns all field-value pairs")
     {
-        auto res = kv.hgetall("myhash");
+        auto res = kv.hgetall("myhash").value;
         REQUIRE(res.size() == 4);
         REQUIRE((res[0] == "f1" || res[0] == "f2"));
         REQUIRE((res[1] == "v1" || res[1] == "v2"));
@@ -230,7 +230,7 @@ TEST_CASE("HGETALL method", "[hgetall][kvstore method][unit]")
 
     SECTION("Hgetall on non-existing hash returns empty vector")
     {
-        auto res = kv.hgetall("nohash");
+        auto res = kv.hgetall("nohash").value;
         REQUIRE(res.empty());
     }
 }
@@ -243,19 +243,19 @@ TEST_CASE("HGETALL command", "[hgetall][command handler][unit]")
 
     SECTION("HGETALL returns all field-value pairs in RESP")
     {
-        std::string resp = handleHGETALL(kv, {"myhash"});
-        REQUIRE(resp == "*4\r\n$2\r\nf2\r\n$2\r\nv2\r\n$2\r\nf1\r\n$2\r\nv1\r\n");
+        std::string resp = handleHGETALL(kv, {"myhash"}).str();
+        REQUIRE(resp == "*4\r\n$2\r\nf1\r\n$2\r\nv1\r\n$2\r\nf2\r\n$2\r\nv2\r\n"); //Insertion order while it is a listpack
     }
 
     SECTION("HGETALL on non-existing hash returns empty RESP array")
     {
-        REQUIRE(handleHGETALL(kv, {"nohash"}) == "*0\r\n");
+        REQUIRE(handleHGETALL(kv, {"nohash"}).str() == "*0\r\n");
     }
 
     SECTION("HGETALL bad args")
     {
-        REQUIRE(handleHGETALL(kv, {}) == argumentError("1", 0));
-        REQUIRE(handleHGETALL(kv, {"k", "more"}) == argumentError("1", 2));
-        REQUIRE(handleHGETALL(kv, {"listkey"}) == "-ERR wrong type\r\n");
+        REQUIRE(handleHGETALL(kv, {}).str() == argumentError("1", 0));
+        REQUIRE(handleHGETALL(kv, {"k", "more"}).str() == argumentError("1", 2));
+        REQUIRE(handleHGETALL(kv, {"listkey"}).str() == "-ERR wrong type\r\n");
     }
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+#define CATCH_CONFIG_MAIN
+
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <catch2/catch_test_macros.hpp>
+
+#include "spscqueue.hpp"
+#include "outputbuffer.hpp"
+#include "recvbuffer.hpp"
+#include "config.h"
+
+TEST_CASE("SPSCQueue", "[spsc][shard][unit]")
+{
+    SPSCQueue<int> queue(3); //Rounded up to 4
+
+    SECTION("SPSCQueue fifo and full")
+    {
+        for (int i = 0; i < 4; ++i) REQUIRE(queue.push(int(i)));
+        REQUIRE(!queue.push(4));
+        for (int i = 0; i < 4; ++i) REQUIRE(queue.pop() == i);
+        REQUIRE(queue.pop() == std::nullopt);
+    }
+
+    SECTION("SPSCQueue across threads")
+    {
+        constexpr int count = 100000;
+        std::thread producer([&queue]
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                while (!queue.push(int(i))) std::this_thread::yield();
+            }
+        });
+        int expected = 0;
+        while (expected < count)
+        {
+            if (const auto item = queue.pop())
+            {
+                REQUIRE(*item == expected);
+                ++expected;
+            }
+        }
+        producer.join();
+        REQUIRE(queue.pop() == std::nullopt);
+    }
+}
+
+TEST_CASE("OutputBuffer", "[output][unit]")
+{
+    OutputBuffer out;
+    out.append(std::string_view("+OK\r\n"));
+    out.append(std::string(":1\r\n"));
+    auto pinned = std::make_shared<const std::string>(ZERO_COPY_MIN, 'x');
+    out.append(pinned);
+    out.append(std::string_view("\r\n"));
+
+    SECTION("OutputBuffer segments")
+    {
+        iovec iov[IOV_BATCH];
+        REQUIRE(out.size() == 9 + ZERO_COPY_MIN + 2);
+        REQUIRE(out.fillIov(iov, IOV_BATCH) == 3); //Small replies coalesce around the pinned value
+        REQUIRE(iov[1].iov_base == pinned->data()); //Not copied
+    }
+
+    SECTION("OutputBuffer short write")
+    {
+        const std::string all = out.str();
+        out.consume(7);
+        REQUIRE(out.str() == all.substr(7));
+        out.consume(ZERO_COPY_MIN);
+        REQUIRE(out.str() == all.substr(7 + ZERO_COPY_MIN));
+        out.consume(out.size());
+        REQUIRE(out.empty());
+    }
+}
+
+TEST_CASE("RecvBuffer", "[recv][unit]")
+{
+    RecvBuffer in;
+    in.append("*1\r\n$4\r\nPI", 10);
+
+    SECTION("RecvBuffer consume in place")
+    {
+        in.consume(4);
+        REQUIRE(in.readable() == "$4\r\nPI");
+        in.append("NG\r\n", 4);
+        REQUIRE(in.readable() == "$4\r\nPING\r\n");
+        in.consume(in.size());
+        REQUIRE(in.empty());
+    }
+
+    SECTION("RecvBuffer keeps unparsed tail when growing")
+    {
+        in.consume(4);
+        const std::string large(READ_CHUNK * 3, 'x');
+        std::memcpy(in.prepare(large.size()), large.data(), large.size());
+        REQUIRE(in.writable() >= large.size());
+        in.commit(large.size());
+        REQUIRE(in.readable() == "$4\r\nPI" + large);
+    }
+}
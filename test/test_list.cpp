@@ -15,18 +15,29 @@ TEST_CASE("LPUSH and RPUSH methods", "[lpush/rpush][kvstore method][unit]")
 
     SECTION("Lpush and Rpush expected")
     {
-        REQUIRE(kv.lpush({"mylist", "a"}) == 1);
-        REQUIRE(kv.lpush({"mylist", "b"}) == 2);
-        REQUIRE(kv.rpush({"mylist", "c"}) == 3);
-        REQUIRE(kv.rpush({"mylist", "d"}) == 4);
+        REQUIRE(kv.lpush({"mylist", "a"}).value == 1);
+        REQUIRE(kv.lpush({"mylist", "b"}).value == 2);
+        REQUIRE(kv.rpush({"mylist", "c"}).value == 3);
+        REQUIRE(kv.rpush({"mylist", "d"}).value == 4);
 
-        auto range = kv.lrange("mylist", 0, -1);
+        auto range = kv.lrange("mylist", 0, -1).value;
         REQUIRE(range.size() == 4);
         REQUIRE(range[0] == "b");
         REQUIRE(range[1] == "a");
         REQUIRE(range[2] == "c");
         REQUIRE(range[3] == "d");
     }
+
+    SECTION("Another type is refused under the same lookup, unchanged")
+    {
+        kv.sadd({"myset", "a", "b"});
+        kv.set("k", "v");
+        REQUIRE(kv.lpush({"myset", "x"}).wrongType);
+        REQUIRE(kv.rpush({"k", "x"}).wrongType);
+        REQUIRE(kv.scard("myset").value == 2);
+        REQUIRE(kv.get("k").value == "v");
+        REQUIRE(kv.lpop("myset").wrongType);
+    }
 }
 TEST_CASE("LPUSH and RPUSH commands", "[lpush/rpush][command handler][unit]")
 {
@@ -38,8 +49,8 @@ TEST_CASE("LPUSH and RPUSH commands", "[lpush/rpush][command handler][unit]")
     {
         REQUIRE(handleLPUSH(kv, {"mylist", "x"}) == ":3\r\n");
         REQUIRE(handleRPUSH(kv, {"mylist", "y"}) == ":4\r\n");
-        REQUIRE(kv.lindex("mylist", 0) == "x");
-        REQUIRE(kv.lindex("mylist", 3) == "y");
+        REQUIRE(kv.lindex("mylist", 0).value == "x");
+        REQUIRE(kv.lindex("mylist", 3).value == "y");
     }
 
     SECTION("LPUSH and RPUSH bad args")
@@ -60,14 +71,14 @@ TEST_CASE("LPOP and RPOP methods", "[lpop/rpop][kvstore method][unit]")
         kv.rpush({"mylist", "a"});
         kv.rpush({"mylist", "b"});
         kv.rpush({"mylist", "c"});
-        REQUIRE(kv.lpop("mylist").value() == "a");
-        REQUIRE(kv.rpop("mylist").value() == "c");
-        REQUIRE(kv.lpop("mylist").value() == "b");
+        REQUIRE(kv.lpop("mylist").value == "a");
+        REQUIRE(kv.rpop("mylist").value == "c");
+        REQUIRE(kv.lpop("mylist").value == "b");
     }
 
     SECTION("Pop empty list")
     {
-        REQUIRE(kv.lpop("mylist") == std::nullopt);
+        REQUIRE(kv.lpop("mylist").value == std::nullopt);
     }
 }
 TEST_CASE("LPOP and RPOP commands", "[lpop/rpop][command handler][unit]")
@@ -102,9 +113,9 @@ TEST_CASE("LRANGE method", "[lrange][kvstore method][unit]")
         kv.rpush({"mylist", "a"});
         kv.rpush({"mylist", "b"});
         kv.rpush({"mylist", "c"});
-        REQUIRE(kv.llen("mylist") == 3);
+        REQUIRE(kv.llen("mylist").value == 3);
         kv.lpop("mylist");
-        REQUIRE(kv.llen("mylist") == 2);
+        REQUIRE(kv.llen("mylist").value == 2);
 
     }
 
@@ -112,7 +123,7 @@ TEST_CASE("LRANGE method", "[lrange][kvstore method][unit]")
     {
         kv.lpop("mylist");
         kv.lpop("mylist");
-        REQUIRE(kv.llen("mylist") == 0);
+        REQUIRE(kv.llen("mylist").value == 0);
     }
 }
 TEST_CASE("LRANGE command", "[lrange][command handler][unit]")
@@ -121,17 +132,30 @@ TEST_CASE("LRANGE command", "[lrange][command handler][unit]")
     kv.rpush({"mylist", "a", "b", "c"});
     SECTION("LRANGE expected")
     {
-        REQUIRE(handleLRANGE(kv, {"mylist", "0", "-1"}) == "*3\r\n$1\r\na\r\n$1\r\nb\r\n$1\r\nc\r\n");
-        REQUIRE(handleLRANGE(kv, {"mylist", "1", "1"}) == "*1\r\n$1\r\nb\r\n");
-        REQUIRE(handleLRANGE(kv, {"mylist", "5", "10"}) == "*0\r\n");
+        REQUIRE(handleLRANGE(kv, {"mylist", "0", "-1"}).str() == "*3\r\n$1\r\na\r\n$1\r\nb\r\n$1\r\nc\r\n");
+        REQUIRE(handleLRANGE(kv, {"mylist", "1", "1"}).str() == "*1\r\n$1\r\nb\r\n");
+        REQUIRE(handleLRANGE(kv, {"mylist", "5", "10"}).str() == "*0\r\n");
+        REQUIRE(handleLRANGE(kv, {"nolist", "0", "-1"}).str() == "*0\r\n");
+    }
+
+    SECTION("LRANGE of a long list streams in chunks")
+    {
+        for (int i = 0; i < 20000; ++i) kv.rpush({"long", "element:" + std::to_string(i)});
+        const OutputBuffer reply = handleLRANGE(kv, {"long", "0", "-1"});
+        REQUIRE(reply.str() == ReplyWriter().array(kv.lrange("long", 0, -1).value).take());
+
+        iovec iov[64];
+        const int segments = reply.fillIov(iov, 64);
+        REQUIRE(segments > 1);
+        for (int i = 0; i < segments; ++i) REQUIRE(iov[i].iov_len < OUTPUT_CHUNK + 64); //One element past a chunk at most
     }
 
     SECTION("LRANGE bad args")
     {
-        REQUIRE(handleLRANGE(kv, {"mylist"}) == argumentError("3", 1));
-        REQUIRE(handleLRANGE(kv, {"mylist", "b", "1"}) == "-ERR value is not an integer or out of range\r\n");
+        REQUIRE(handleLRANGE(kv, {"mylist"}).str() == argumentError("3", 1));
+        REQUIRE(handleLRANGE(kv, {"mylist", "b", "1"}).str() == "-ERR value is not an integer or out of range\r\n");
         kv.set("k", "v");
-        REQUIRE(handleLRANGE(kv, {"k", "0", "1"}) == "-ERR wrong type\r\n");
+        REQUIRE(handleLRANGE(kv, {"k", "0", "1"}).str() == "-ERR wrong type\r\n");
     }
 }
 
@@ -144,9 +168,9 @@ TEST_CASE("LLEN method", "[llen][kvstore method][unit]")
         kv.rpush({"mylist", "a"});
         kv.rpush({"mylist", "b"});
         kv.rpush({"mylist", "c"});
-        REQUIRE(kv.llen("mylist") == 3);
+        REQUIRE(kv.llen("mylist").value == 3);
         kv.lpop("mylist");
-        REQUIRE(kv.llen("mylist") == 2);
+        REQUIRE(kv.llen("mylist").value == 2);
 
     }
 
@@ -154,7 +178,7 @@ TEST_CASE("LLEN method", "[llen][kvstore method][unit]")
     {
         kv.lpop("mylist");
         kv.lpop("mylist");
-        REQUIRE(kv.llen("mylist") == 0);
+        REQUIRE(kv.llen("mylist").value == 0);
     }
 }
 TEST_CASE("LLEN command", "[llen][command handler][unit]")
@@ -185,13 +209,13 @@ TEST_CASE("LINDEX method", "[lindex][kvstore method][unit]")
         kv.rpush({"mylist", "a"});
         kv.rpush({"mylist", "b"});
         kv.rpush({"mylist", "c"});
-        REQUIRE(kv.lindex("mylist", 0) == "a");
-        REQUIRE(kv.lindex("mylist", 2) == "c");
+        REQUIRE(kv.lindex("mylist", 0).value == "a");
+        REQUIRE(kv.lindex("mylist", 2).value == "c");
     }
 
     SECTION("Lindex non value empty in list")
     {
-        REQUIRE(kv.lindex("mylist", 3) == std::nullopt);
+        REQUIRE(kv.lindex("mylist", 3).value == std::nullopt);
     }
 }
 TEST_CASE("LINDEX command", "[lindex][command handler][unit]")
@@ -221,15 +245,15 @@ TEST_CASE("LSET method", "[lset][kvstore method][unit]")
         kv.rpush({"mylist", "a"});
         kv.rpush({"mylist", "b"});
         kv.rpush({"mylist", "c"});
-        REQUIRE(kv.lset("mylist", 1, "z"));
-        REQUIRE(kv.lindex("mylist", 1) == "z");
-        REQUIRE(kv.lset("mylist", 2, "x"));
-        REQUIRE(kv.lindex("mylist", 2) == "x");
+        REQUIRE(kv.lset("mylist", 1, "z").value);
+        REQUIRE(kv.lindex("mylist", 1).value == "z");
+        REQUIRE(kv.lset("mylist", 2, "x").value);
+        REQUIRE(kv.lindex("mylist", 2).value == "x");
     }
 
     SECTION("Lset non value in list")
     {
-        REQUIRE(!kv.lset("mylist", 5, "x"));
+        REQUIRE(!kv.lset("mylist", 5, "x").value);
     }
 }
 TEST_CASE("LSET command", "[lset][command handler][unit]")
@@ -240,7 +264,7 @@ TEST_CASE("LSET command", "[lset][command handler][unit]")
     {
 
         REQUIRE(handleLSET(kv, {"mylist", "1", "z"}) == "+OK\r\n");
-        REQUIRE(kv.rpop("mylist") == "z");
+        REQUIRE(kv.rpop("mylist").value == "z");
         REQUIRE(handleLSET(kv, {"mylist", "5", "x"}) == "-ERR no such key or value out of range\r\n");
     }
 
@@ -264,15 +288,15 @@ TEST_CASE("LREM method", "[lrem][kvstore method][unit]")
         kv.rpush({"mylist", "a"});
         kv.rpush({"mylist", "b"});
         kv.rpush({"mylist", "b"});
-        REQUIRE(kv.lrem("mylist", 1, "a") == 1);
-        REQUIRE(kv.lrem("mylist", 0, "a") == 2);
-        REQUIRE(kv.lindex("mylist", 0) == "b");
+        REQUIRE(kv.lrem("mylist", 1, "a").value == 1);
+        REQUIRE(kv.lrem("mylist", 0, "a").value == 2);
+        REQUIRE(kv.lindex("mylist", 0).value == "b");
     }
 
     SECTION("Lrem non value in list")
     {
-        REQUIRE(kv.lrem("mylist", 0, "c") == 0);
-        REQUIRE(kv.lrem("otherlist", 0, "c") == 0);
+        REQUIRE(kv.lrem("mylist", 0, "c").value == 0);
+        REQUIRE(kv.lrem("otherlist", 0, "c").value == 0);
     }
 }
 TEST_CASE("LREM command", "[lrem][command handler][unit]")
@@ -1,5 +1,6 @@
 #define CATCH_CONFIG_MAIN
 
+#include <chrono>
 #include <thread>
 #include <catch2/catch_test_macros.hpp>
 
@@ -7,6 +8,8 @@
 #include "kvstore.hpp"
 #include "commands.hpp"
 #include "util.hpp"
+#include "clock.hpp"
+#include "replywriter.hpp"
 
 TEST_CASE("TYPE command", "[type][command handler][unit]")
 {
@@ -35,4 +38,287 @@ TEST_CASE("TYPE command", "[type][command handler][unit]")
         REQUIRE(handleTYPE(kv, {}) == argumentError("1", 0));
         REQUIRE(handleTYPE(kv, {"string", "extra"}) == argumentError("1", 2));
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("INFO command", "[info][command handler][unit]")
+{
+    KVStore kv(false);
+    for (int i = 0; i < 100; ++i) kv.set("key" + std::to_string(i), "v");
+
+    const std::string info = handleINFO(kv, {});
+    REQUIRE(info.starts_with("$"));
+    REQUIRE(info.find("# Keyspace\r\n") != std::string::npos);
+    REQUIRE(info.find("keys:100\r\n") != std::string::npos);
+    REQUIRE(info.find("dict_rehash_progress:") != std::string::npos);
+    REQUIRE(handleINFO(kv, {"keyspace"}) == info);
+    REQUIRE(info.find("used_memory:" + std::to_string(kv.usedMemory()) + "\r\n") != std::string::npos);
+    REQUIRE(info.find("maxmemory_policy:allkeys-lru\r\n") != std::string::npos);
+}
+
+TEST_CASE("Memory accounting", "[memory][unit]")
+{
+    KVStore kv(false);
+    REQUIRE(kv.usedMemory() == 0);
+
+    SECTION("Every write is counted and deleting gives it all back")
+    {
+        kv.set("small", "v");
+        const size_t oneKey = kv.usedMemory();
+        kv.set("big", std::string(50000, 'x'));
+        REQUIRE(kv.usedMemory() > oneKey + 50000);
+        kv.append("small", std::string(100, 'y'));
+        kv.incr("n");
+        kv.set("n", std::string(40, 'z')); //INT to boxed string
+
+        for (int i = 0; i < 300; ++i) kv.rpush({"list", "item:" + std::to_string(i)}); //Listpack then quicklist
+        kv.lset("list", 5, std::string(100, 'l'));
+        kv.lrem("list", 0, "item:7");
+        kv.lpop("list");
+
+        for (int i = 0; i < 600; ++i) kv.sadd({"ints", std::to_string(i)}); //Intset then boxed
+        kv.srem({"ints", "1", "2"});
+        kv.spop("ints", 3);
+        for (int i = 0; i < 200; ++i) kv.sadd({"strs", "member:" + std::to_string(i) + std::string(i % 40, 'm')});
+        kv.srem({"strs", "member:3mmm"});
+
+        for (int i = 0; i < 200; ++i) kv.hset({"hash", "field:" + std::to_string(i), std::string(i % 50, 'h')});
+        kv.hset({"hash", "field:1", std::string(200, 'H')}); //Overwrite with a longer value
+        kv.hdel({"hash", "field:2", "field:3"});
+
+        const size_t before = kv.usedMemory();
+        REQUIRE(before > 300 * 6 + 600 * 2 + 200 * 30);
+        REQUIRE(kv.del({"list"}) == 1);
+        REQUIRE(kv.usedMemory() < before);
+        kv.del({"small", "big", "n", "ints", "strs", "hash"});
+        REQUIRE(kv.usedMemory() == 0); //Charges and credits agree
+    }
+
+    SECTION("A ttl is charged to its key and given back")
+    {
+        kv.set("a", "1");
+        const size_t plain = kv.usedMemory();
+        REQUIRE(kv.expire("a", 100));
+        REQUIRE(kv.usedMemory() > plain);
+        REQUIRE(kv.persist("a"));
+        REQUIRE(kv.usedMemory() == plain);
+        kv.expire("a", 100);
+        kv.set("a", "2"); //SET drops the ttl
+        REQUIRE(kv.ttl("a") == -1);
+        REQUIRE(kv.usedMemory() == plain);
+        kv.expire("a", 100);
+        kv.del({"a"});
+        REQUIRE(kv.usedMemory() == 0);
+        kv.set("b", "1");
+        kv.expire("b", 0); //Gone on the next read
+        REQUIRE(!kv.get("b").value);
+        REQUIRE(kv.usedMemory() == 0);
+    }
+
+    SECTION("Popping the last element or flushing frees the key")
+    {
+        kv.sadd({"s", "a", std::string(100, 'b')}); //Boxed
+        kv.spop("s", 2);
+        kv.rpush({"l", "x"});
+        kv.rpop("l");
+        REQUIRE(kv.usedMemory() == 0);
+        kv.hset({"h", "f", "v"});
+        kv.flushall();
+        REQUIRE(kv.usedMemory() == 0);
+    }
+
+    SECTION("Over maxmemory the least recently used keys go, unless noeviction")
+    {
+        for (int i = 0; i < 50; ++i) kv.set("key" + std::to_string(i), std::string(1000, 'v'));
+        REQUIRE(kv.makeRoom()); //No limit
+        std::this_thread::sleep_for(std::chrono::milliseconds(LRU_CLOCK_RESOLUTION_MS + 100));
+        for (int i = 0; i < 25; ++i) kv.get("key" + std::to_string(i)); //A clock tick newer than the rest
+
+        kv.setMaxMemorySamples(64); //Every key is sampled, so eviction is exact
+        kv.setMaxMemory(kv.usedMemory() * 6 / 10);
+        REQUIRE(kv.makeRoom());
+        REQUIRE(kv.usedMemory() <= kv.maxMemory());
+        REQUIRE(kv.keyCount() <= 30);
+        for (int i = 0; i < 25; ++i) REQUIRE(kv.get("key" + std::to_string(i)).value == std::string(1000, 'v'));
+
+        kv.setEvictionPolicy(EvictionPolicy::NOEVICTION);
+        kv.set("extra", std::string(kv.maxMemory(), 'e'));
+        REQUIRE(!kv.makeRoom());
+        REQUIRE(kv.get("extra").value);
+    }
+}
+
+TEST_CASE("Active expiry", "[expire][unit]")
+{
+    KVStore kv(false);
+    REQUIRE(kv.activeExpireCycle() == 0); //No ttl keys
+    for (int i = 0; i < 300; ++i) kv.set("key" + std::to_string(i), "v");
+    for (int i = 0; i < 200; ++i) kv.expire("key" + std::to_string(i), 100);
+    kv.persist("key0"); //Off the wheel
+    for (int i = 1; i < 100; ++i) kv.expire("key" + std::to_string(i), 0); //Moved on the wheel, already due, never read again
+
+    REQUIRE(kv.activeExpireCycle() == 99); //Exactly the due ones, in more than one batch
+    REQUIRE(kv.keyCount() == 201);
+    for (int i = 100; i < 300; ++i) REQUIRE(kv.ttl("key" + std::to_string(i)) != -2);
+    REQUIRE(kv.ttl("key0") == -1);
+
+    const auto stats = kv.expireStats();
+    REQUIRE(stats.expired == 99);
+    REQUIRE(stats.cycles == 2);
+    REQUIRE(stats.lagMs == 0);
+
+    kv.set("soon", "v");
+    REQUIRE(kv.expireAt("soon", CoarseClock::nowMs() + 30));
+    REQUIRE(kv.activeExpireCycle() == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(kv.activeExpireCycle() == 1); //Millisecond deadlines
+    REQUIRE(kv.expireStats().expired == stats.expired + 1);
+    const auto before = kv.expireStats();
+
+    kv.expire("key200", 0);
+    REQUIRE(!kv.get("key200").value); //Lazy expiry counts too
+    REQUIRE(kv.expireStats().expired == before.expired + 1);
+    const std::string info = handleINFO(kv, {});
+    REQUIRE(info.find("expired_keys:" + std::to_string(before.expired + 1) + "\r\n") != std::string::npos);
+    REQUIRE(info.find("expire_cycle_time_us:") != std::string::npos);
+}
+
+TEST_CASE("LFU eviction", "[memory][lfu][unit]")
+{
+    SECTION("Counter climbs logarithmically and decays")
+    {
+        REQUIRE((lfuTouched(lfuStamp(0)) & 0xFF) == 1); //Below LFU_INIT_VAL every hit counts
+        uint32_t stamp = lfuStamp(LFU_INIT_VAL);
+        for (int i = 0; i < 1000; ++i) stamp = lfuTouched(stamp);
+        const uint8_t counter = lfuCounter(stamp, lfuMinutes());
+        REQUIRE(counter > LFU_INIT_VAL + 2);
+        REQUIRE(counter < 40); //Nowhere near one per hit
+        REQUIRE(lfuCounter(stamp, (stamp >> 8) + 3 * LFU_DECAY_MINUTES) == counter - 3);
+        REQUIRE(lfuCounter(stamp, (stamp >> 8) + 1000 * LFU_DECAY_MINUTES) == 0);
+    }
+
+    SECTION("Hot keys survive a scan of one hit keys")
+    {
+        KVStore kv(false);
+        kv.setEvictionPolicy(EvictionPolicy::ALLKEYS_LFU);
+        for (int i = 0; i < 10; ++i) kv.set("hot" + std::to_string(i), std::string(1000, 'h'));
+        for (int n = 0; n < 50; ++n)
+        {
+            for (int i = 0; i < 10; ++i) kv.get("hot" + std::to_string(i));
+        }
+        for (int i = 0; i < 40; ++i) kv.set("scan" + std::to_string(i), std::string(1000, 's')); //Newer, so LRU would drop the hot ones first
+        REQUIRE(*kv.frequency("hot0") > LFU_INIT_VAL);
+        REQUIRE(kv.frequency("scan0") == LFU_INIT_VAL);
+        REQUIRE(!kv.frequency("missing"));
+
+        kv.setMaxMemorySamples(64);
+        kv.setMaxMemory(kv.usedMemory() / 2);
+        REQUIRE(kv.makeRoom());
+        for (int i = 0; i < 10; ++i) REQUIRE(kv.get("hot" + std::to_string(i)).value);
+        REQUIRE(kv.keyCount() <= 25);
+    }
+
+    SECTION("OBJECT FREQ and IDLETIME follow the policy")
+    {
+        KVStore kv(false);
+        kv.set("k", "v");
+        REQUIRE(handleOBJECT(kv, {"IDLETIME", "k"}) == ":0\r\n");
+        REQUIRE(handleOBJECT(kv, {"FREQ", "k"}).starts_with("-ERR"));
+        REQUIRE(handleCONFIG(kv, {"SET", "maxmemory-policy", "allkeys-lfu"}) == RESP_OK);
+        kv.set("k", "v"); //Overwrite, now counted
+        REQUIRE(handleOBJECT(kv, {"freq", "k"}).starts_with(":"));
+        REQUIRE(handleOBJECT(kv, {"FREQ", "missing"}) == RESP_NIL);
+        REQUIRE(handleOBJECT(kv, {"IDLETIME", "k"}).starts_with("-ERR"));
+        REQUIRE(handleOBJECT(kv, {"ENCODING", "k"}).starts_with("-ERR"));
+    }
+}
+
+TEST_CASE("Eviction policies", "[memory][eviction][unit]")
+{
+    KVStore kv(false);
+    kv.setMaxMemorySamples(64);
+    for (const auto& row : EVICTION_POLICIES) REQUIRE(policyFromName(policyName(row.policy)) == row.policy);
+    REQUIRE(!policyFromName("volatile-mru"));
+
+    const auto fill = [&kv]
+    {
+        for (int i = 0; i < 20; ++i) kv.set("plain" + std::to_string(i), std::string(1000, 'p'));
+        for (int i = 0; i < 20; ++i)
+        {
+            kv.set("ttl" + std::to_string(i), std::string(1000, 't'));
+            kv.expire("ttl" + std::to_string(i), 100 + i); //ttl0 expires first
+        }
+    };
+
+    SECTION("Volatile policies only take keys with a ttl")
+    {
+        for (const auto policy : {EvictionPolicy::VOLATILE_LRU, EvictionPolicy::VOLATILE_LFU, EvictionPolicy::VOLATILE_RANDOM})
+        {
+            kv.flushall();
+            kv.setMaxMemory(0);
+            fill();
+            kv.setEvictionPolicy(policy);
+            kv.setMaxMemory(kv.usedMemory() * 3 / 4);
+            REQUIRE(kv.makeRoom());
+            for (int i = 0; i < 20; ++i) REQUIRE(kv.get("plain" + std::to_string(i)).value);
+            REQUIRE(kv.evictedKeys(policy) >= 10);
+
+            kv.setMaxMemory(kv.usedMemory() / 4); //More than every ttl key
+            REQUIRE(!kv.makeRoom());
+            REQUIRE(kv.keyCount() == 20);
+        }
+    }
+
+    SECTION("volatile-ttl takes the soonest to expire first")
+    {
+        fill();
+        kv.setEvictionPolicy(EvictionPolicy::VOLATILE_TTL);
+        kv.setMaxMemory(kv.usedMemory() * 3 / 4);
+        REQUIRE(kv.makeRoom());
+        const size_t evicted = kv.evictedKeys(EvictionPolicy::VOLATILE_TTL);
+        REQUIRE(evicted > 0);
+        for (size_t i = 0; i < evicted; ++i) REQUIRE(!kv.get("ttl" + std::to_string(i)).value);
+        for (size_t i = evicted; i < 20; ++i) REQUIRE(kv.get("ttl" + std::to_string(i)).value);
+    }
+
+    SECTION("allkeys-random takes any key and INFO counts evictions by policy")
+    {
+        fill();
+        kv.setEvictionPolicy(EvictionPolicy::ALLKEYS_RANDOM);
+        kv.setMaxMemory(kv.usedMemory() / 2);
+        REQUIRE(kv.makeRoom());
+        REQUIRE(kv.usedMemory() <= kv.maxMemory());
+        const size_t evicted = kv.evictedKeys(EvictionPolicy::ALLKEYS_RANDOM);
+        REQUIRE(kv.keyCount() == 40 - evicted);
+
+        const std::string info = handleINFO(kv, {});
+        REQUIRE(info.find("evicted_keys:" + std::to_string(evicted) + "\r\n") != std::string::npos);
+        REQUIRE(info.find("evicted_keys_allkeys_random:" + std::to_string(evicted) + "\r\n") != std::string::npos);
+        REQUIRE(info.find("evicted_keys_volatile_ttl:0\r\n") != std::string::npos);
+    }
+}
+
+TEST_CASE("CONFIG command", "[config][command handler][unit]")
+{
+    KVStore kv(false);
+
+    REQUIRE(handleCONFIG(kv, {"GET", "maxmemory"}) == "*2\r\n$9\r\nmaxmemory\r\n$1\r\n0\r\n");
+    REQUIRE(handleCONFIG(kv, {"set", "maxmemory", "2mb"}) == RESP_OK);
+    REQUIRE(kv.maxMemory() == 2 * 1024 * 1024);
+    REQUIRE(handleCONFIG(kv, {"SET", "maxmemory", "100k"}) == RESP_OK);
+    REQUIRE(kv.maxMemory() == 100000);
+    REQUIRE(handleCONFIG(kv, {"SET", "maxmemory", "lots"}).starts_with("-ERR"));
+
+    REQUIRE(handleCONFIG(kv, {"SET", "maxmemory-policy", "NOEVICTION"}) == RESP_OK);
+    REQUIRE(kv.evictionPolicy() == EvictionPolicy::NOEVICTION);
+    REQUIRE(handleCONFIG(kv, {"SET", "maxmemory-policy", "sometimes"}).starts_with("-ERR"));
+    REQUIRE(handleCONFIG(kv, {"SET", "maxmemory-policy", "volatile-ttl"}) == RESP_OK);
+    REQUIRE(kv.evictionPolicy() == EvictionPolicy::VOLATILE_TTL);
+    REQUIRE(handleCONFIG(kv, {"SET", "maxmemory-policy", "noeviction"}) == RESP_OK);
+    REQUIRE(handleCONFIG(kv, {"GET", "maxmemory-policy"}) == "*2\r\n$16\r\nmaxmemory-policy\r\n$10\r\nnoeviction\r\n");
+    REQUIRE(handleCONFIG(kv, {"SET", "maxmemory-samples", "10"}) == RESP_OK);
+    REQUIRE(kv.maxMemorySamples() == 10);
+    REQUIRE(handleCONFIG(kv, {"SET", "maxmemory-samples", "0"}).starts_with("-ERR"));
+    REQUIRE(handleCONFIG(kv, {"GET", "*"}).starts_with("*14\r\n"));
+    REQUIRE(handleCONFIG(kv, {"GET", "save"}) == "*0\r\n");
+    REQUIRE(handleCONFIG(kv, {"SET", "port", "1"}).starts_with("-ERR"));
+}
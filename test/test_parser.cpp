@@ -0,0 +1,143 @@
+#define CATCH_CONFIG_MAIN
+
+#include <cstring>
+#include <catch2/catch_test_macros.hpp>
+
+#include "parser.hpp"
+#include "respscan.hpp"
+#include "replywriter.hpp"
+#include "config.h"
+
+TEST_CASE("RESP parser", "[parser][unit]")
+{
+    RESPParser parser;
+    std::vector<std::string_view> command;
+    size_t consumed = 0;
+
+    SECTION("Parse pipeline")
+    {
+        const std::string input = "*1\r\n$4\r\nPING\r\n*3\r\n$3\r\nSET\r\n$1\r\na\r\n$1\r\nb\r\n";
+        REQUIRE(parser.next(input, consumed, command) == RESPParser::Status::COMMAND);
+        REQUIRE(command == std::vector<std::string_view>{"PING"});
+        const size_t first = consumed;
+        REQUIRE(parser.next(std::string_view(input).substr(first), consumed, command) == RESPParser::Status::COMMAND);
+        REQUIRE(command == std::vector<std::string_view>{"SET", "a", "b"});
+        REQUIRE(first + consumed == input.size());
+    }
+
+    SECTION("Parse resumes byte by byte")
+    {
+        const std::string input = "*2\r\n$4\r\nECHO\r\n$11\r\nhello world\r\n";
+        size_t fed = 0;
+        std::string pending;
+        RESPParser::Status status = RESPParser::Status::NEED_MORE;
+        while (fed < input.size())
+        {
+            pending += input[fed++];
+            status = parser.next(pending, consumed, command);
+            pending.erase(0, consumed);
+            if (status != RESPParser::Status::NEED_MORE) break;
+        }
+        REQUIRE(status == RESPParser::Status::COMMAND);
+        REQUIRE(fed == input.size());
+        REQUIRE(command == std::vector<std::string_view>{"ECHO", "hello world"});
+    }
+
+    SECTION("Parse args as views into the input")
+    {
+        const std::string input = "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$5\r\nvalue\r\n";
+        REQUIRE(parser.next(std::string_view(input).substr(0, 20), consumed, command) == RESPParser::Status::NEED_MORE);
+        REQUIRE(consumed == 0);
+        REQUIRE(parser.next(input, consumed, command) == RESPParser::Status::COMMAND);
+        REQUIRE(consumed == input.size());
+        REQUIRE(command[2] == "value");
+        REQUIRE(command[2].data() == input.data() + input.find("value"));
+    }
+
+    SECTION("Parse binary safe bulk")
+    {
+        const std::string value("a\r\nb\0c", 6);
+        const std::string input = "*2\r\n$4\r\nECHO\r\n$6\r\n" + value + "\r\n";
+        REQUIRE(parser.next(input, consumed, command) == RESPParser::Status::COMMAND);
+        REQUIRE(command[1] == value);
+    }
+
+    SECTION("Parse large bulk in place")
+    {
+        const std::string value(ZERO_COPY_MIN * 2, 'x');
+        const std::string header = "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$" + std::to_string(value.size()) + "\r\n";
+        REQUIRE(parser.next(header + value.substr(0, 100), consumed, command) == RESPParser::Status::NEED_MORE);
+        REQUIRE(consumed == header.size() + 100);
+
+        const auto target = parser.directTarget();
+        REQUIRE(target.size() == value.size() - 100);
+        std::memcpy(target.data(), value.data() + 100, target.size());
+        parser.directFilled(target.size());
+        REQUIRE(parser.next("\r\n", consumed, command) == RESPParser::Status::COMMAND);
+        REQUIRE(command == std::vector<std::string_view>{"SET", "k", value});
+    }
+
+    SECTION("Parse malformed")
+    {
+        REQUIRE(parser.next("*1\r\n+PING\r\n", consumed, command) == RESPParser::Status::ERROR);
+        RESPParser other;
+        REQUIRE(other.next("*x\r\n", consumed, command) == RESPParser::Status::ERROR);
+        RESPParser bad;
+        REQUIRE(bad.next("*1\r\n$2\r\nabcd\r\n", consumed, command) == RESPParser::Status::ERROR);
+    }
+}
+
+TEST_CASE("RESP scanning helpers", "[parser][unit]")
+{
+    SECTION("Find CRLF at every offset")
+    {
+        for (size_t at = 0; at < 100; ++at)
+        {
+            std::string input(100, 'a');
+            input[at] = '\r';
+            if (at + 1 < input.size()) input[at + 1] = '\n';
+            input[at / 2] = at > 1 ? '\r' : input[at / 2]; //Lone CR ahead of the real one
+            const size_t expected = at + 1 < input.size() ? at : std::string_view::npos;
+            REQUIRE(respscan::findCRLF(input, 0) == expected);
+            REQUIRE(respscan::findCRLF(input, 0) == respscan::findCRLFScalar(input.data(), input.size(), 0));
+        }
+        REQUIRE(respscan::findCRLF("abc", 0) == std::string_view::npos);
+        REQUIRE(respscan::findCRLF("\r\nab\r\n", 1) == 4);
+    }
+
+    SECTION("Parse header numbers")
+    {
+        long long out = 0;
+        REQUIRE(respscan::parseInt("0", out));
+        REQUIRE(out == 0);
+        REQUIRE(respscan::parseInt("536870912", out));
+        REQUIRE(out == 536870912);
+        REQUIRE(respscan::parseInt("-1", out));
+        REQUIRE(out == -1);
+        REQUIRE(!respscan::parseInt("", out));
+        REQUIRE(!respscan::parseInt("-", out));
+        REQUIRE(!respscan::parseInt("12a", out));
+        REQUIRE(!respscan::parseInt("+5", out));
+        REQUIRE(!respscan::parseInt("1234567890123456789", out));
+    }
+}
+
+TEST_CASE("ReplyWriter", "[reply][unit]")
+{
+    SECTION("Scalars")
+    {
+        REQUIRE(ReplyWriter().integer(0).take() == ":0\r\n");
+        REQUIRE(ReplyWriter().integer(-42).take() == ":-42\r\n");
+        REQUIRE(ReplyWriter().simple("OK").take() == RESP_OK);
+        REQUIRE(ReplyWriter().bulk("hello").take() == "$5\r\nhello\r\n");
+        REQUIRE(ReplyWriter().bulkOrNil(std::nullopt).take() == RESP_NIL);
+    }
+
+    SECTION("Arrays")
+    {
+        const std::vector<std::optional<std::string>> values{"a", std::nullopt, "bcd"};
+        REQUIRE(ReplyWriter().array(values).take() == "*3\r\n$1\r\na\r\n$-1\r\n$3\r\nbcd\r\n");
+        REQUIRE(ReplyWriter().array({}).take() == "*0\r\n");
+        REQUIRE(ReplyWriter().arrayHeader(2).integer(1).bulk("x").take() == "*2\r\n:1\r\n$1\r\nx\r\n");
+    }
+}
@@ -18,12 +18,14 @@ TEST_CASE("Persistence", "[persistence][unit]")
         kv.set("a", "1");
         kv.lpush({"b", "1"});
         kv.hset({"c", "d", "1"});
+        kv.set("large", std::string(ZERO_COPY_MIN, 'x')); //Stored shareable
     }
     //moves to outer scope and destroys the kv
     {
         KVStore kv(true, filename);
-        REQUIRE(kv.get("a") == "1");
-        REQUIRE(kv.lpop("b") == "1");
-        REQUIRE(kv.hget("c", "d") == "1");
+        REQUIRE(kv.get("a").value == "1");
+        REQUIRE(kv.lpop("b").value == "1");
+        REQUIRE(kv.hget("c", "d").value == "1");
+        REQUIRE(kv.get("large").value == std::string(ZERO_COPY_MIN, 'x'));
     }
 }
\ No newline at end of file
@@ -16,9 +16,9 @@ TEST_CASE("SADD method", "[sadd][kvstore method][unit]")
 
     SECTION("Sadd expected and add existing")
     {
-        REQUIRE(kv.sadd({"myset", "a", "b", "c"}) == 3);
-        REQUIRE(kv.sadd({"myset", "b", "d"}) == 1);
-        REQUIRE(kv.sadd({"myset", "b", "d"}) == 0);
+        REQUIRE(kv.sadd({"myset", "a", "b", "c"}).value == 3);
+        REQUIRE(kv.sadd({"myset", "b", "d"}).value == 1);
+        REQUIRE(kv.sadd({"myset", "b", "d"}).value == 0);
     }
 }
 TEST_CASE("SADD command", "[sadd][command handler][unit]")
@@ -47,13 +47,13 @@ TEST_CASE("SREM method", "[srem][kvstore method][unit]")
 
     SECTION("Srem expected")
     {
-        REQUIRE(kv.srem({"myset", "b", "x"}) == 1);
-        REQUIRE(kv.sismember("myset", "b") == false);
+        REQUIRE(kv.srem({"myset", "b", "x"}).value == 1);
+        REQUIRE(kv.sismember("myset", "b").value == false);
     }
 
     SECTION("Srem non-existing set")
     {
-        REQUIRE(kv.srem({"otherset", "a", "c"}) == 0);
+        REQUIRE(kv.srem({"otherset", "a", "c"}).value == 0);
     }
 }
 TEST_CASE("SREM command", "[srem][command handler][unit]")
@@ -83,14 +83,14 @@ TEST_CASE("SISMEMBER method", "[sismember][kvstore method][unit]")
 
     SECTION("Sismember expected")
     {
-        REQUIRE(kv.sismember("myset", "b") == true);
-        REQUIRE(kv.sismember("myset", "x") == false);
+        REQUIRE(kv.sismember("myset", "b").value == true);
+        REQUIRE(kv.sismember("myset", "x").value == false);
 
     }
 
     SECTION("Sismember non-existing set")
     {
-        REQUIRE(kv.sismember("otherset", "a") == false);
+        REQUIRE(kv.sismember("otherset", "a").value == false);
     }
 }
 TEST_CASE("SISMEMBER command", "[sismember][command handler][unit]")
@@ -120,7 +120,7 @@ TEST_CASE("SMEMBERS method", "[Smembers][kvstore method][unit]")
 
     SECTION("Smembers expected")
     {
-        auto members = kv.smembers("myset");
+        auto members = kv.smembers("myset").value;
         std::set<std::string> res;
         for (auto i : members) if (i) res.insert(*i);
         REQUIRE(res == std::set<std::string>{"a", "b", "c"});
@@ -128,7 +128,7 @@ TEST_CASE("SMEMBERS method", "[Smembers][kvstore method][unit]")
 
     SECTION("Smembers non-existing set")
     {
-        REQUIRE(kv.smembers("otherset").empty());
+        REQUIRE(kv.smembers("otherset").value.empty());
     }
 }
 TEST_CASE("SMEMBERS command", "[smembers][command handler][unit]")
@@ -138,20 +138,20 @@ TEST_CASE("SMEMBERS command", "[smembers][command handler][unit]")
 
     SECTION("SMEMBERS expected")
     {
-        REQUIRE(handleSMEMBERS(kv, {"myset"}) == "*3\r\n$1\r\na\r\n$2\r\nbx\r\n$1\r\nc\r\n");
+        REQUIRE(handleSMEMBERS(kv, {"myset"}).str() == "*3\r\n$1\r\nc\r\n$2\r\nbx\r\n$1\r\na\r\n"); //Small sets are listpacks, insertion order
     }
 
     SECTION("SMEMBERS non-existing set")
     {
-        REQUIRE(handleSMEMBERS(kv, {"otherset"}) == "*0\r\n");
+        REQUIRE(handleSMEMBERS(kv, {"otherset"}).str() == "*0\r\n");
     }
 
     SECTION("SMEMBERS bad args")
     {
-        REQUIRE(handleSMEMBERS(kv, {}) == argumentError("1", 0));
-        REQUIRE(handleSMEMBERS(kv, {"myset", "more"}) == argumentError("1", 2));
+        REQUIRE(handleSMEMBERS(kv, {}).str() == argumentError("1", 0));
+        REQUIRE(handleSMEMBERS(kv, {"myset", "more"}).str() == argumentError("1", 2));
         kv.rpush({"k", "v"});
-        REQUIRE(handleSMEMBERS(kv, {"k"}) == "-ERR wrong type\r\n");
+        REQUIRE(handleSMEMBERS(kv, {"k"}).str() == "-ERR wrong type\r\n");
     }
 }
 
@@ -162,14 +162,14 @@ TEST_CASE("SCARD method", "[Scard][kvstore method][unit]")
 
     SECTION("Scard expected")
     {
-        REQUIRE(kv.scard("myset") == 3);
+        REQUIRE(kv.scard("myset").value == 3);
         kv.srem({"myset", "a"});
-        REQUIRE(kv.scard("myset") == 2);
+        REQUIRE(kv.scard("myset").value == 2);
     }
 
     SECTION("Scard non-existing set")
     {
-        REQUIRE(kv.scard("otherset") == 0);
+        REQUIRE(kv.scard("otherset").value == 0);
     }
 }
 TEST_CASE("SCARD command", "[scard][command handler][unit]")
@@ -205,16 +205,30 @@ TEST_CASE("SPOP method", "[spop][kvstore method][unit]")
 
     SECTION("Spop expected")
     {
-        auto popped = kv.spop("myset", 2);
+        auto popped = kv.spop("myset", 2).value;
         REQUIRE(popped.size() == 2);
-        REQUIRE(kv.scard("myset") == 1);
+        REQUIRE(kv.scard("myset").value == 1);
     }
 
     SECTION("Spop non-existing set")
     {
-        auto popped = kv.spop("otherset", 2);
+        auto popped = kv.spop("otherset", 2).value;
         REQUIRE(popped.empty());
     }
+
+    SECTION("Spop picks at random in packed sets")
+    {
+        std::set<std::string> fromInts, fromStrings;
+        for (int i = 0; i < 100; ++i)
+        {
+            kv.sadd({"ints", "1", "2", "3", "4", "5", "6", "7", "8"}); //Intset, sorted
+            kv.sadd({"strs", "a", "b", "c", "d", "e", "f", "g", "h"}); //Listpack
+            fromInts.insert(*kv.spop("ints", 1).value[0]);
+            fromStrings.insert(*kv.spop("strs", 1).value[0]);
+        }
+        REQUIRE(fromInts.size() > 1); //Not always the smallest
+        REQUIRE(fromStrings.size() > 1);
+    }
 }
 TEST_CASE("SPOP command", "[spop][command handler][unit]")
 {
@@ -227,7 +241,7 @@ TEST_CASE("SPOP command", "[spop][command handler][unit]")
         auto popped = handleSPOP(kv, {"myset"});
 
         REQUIRE((popped == "$1\r\na\r\n" || popped == "$1\r\nb\r\n"));
-        REQUIRE(kv.scard("myset") == 1);
+        REQUIRE(kv.scard("myset").value == 1);
     }
 
     SECTION("SPOP non-existing set")
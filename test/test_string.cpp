@@ -15,25 +15,25 @@ TEST_CASE("SET method", "[set][kvstore method][unit]")
     SECTION("Set new key")
     {
         kv.set("key", "value");
-        REQUIRE(kv.get("key") == "value");
+        REQUIRE(kv.get("key").value == "value");
 
         SECTION("Set existing key")
         {
             kv.set("key", "new value");
-            REQUIRE(kv.get("key") == "new value");
+            REQUIRE(kv.get("key").value == "new value");
         }
     }
 
     SECTION("Set empty key")
     {
         kv.set("", "empty value");
-        REQUIRE(kv.get("") == "empty value");
+        REQUIRE(kv.get("").value == "empty value");
     }
 
     SECTION("Set empty value")
     {
         kv.set("empty key", "");
-        REQUIRE(kv.get("empty key") == "");
+        REQUIRE(kv.get("empty key").value == "");
     }
 }
 TEST_CASE("SET command", "[set][command handler][unit]")
@@ -42,15 +42,41 @@ TEST_CASE("SET command", "[set][command handler][unit]")
     SECTION("SET expected")
     {
         REQUIRE(handleSET(kv, {"key","value"}) == "+OK\r\n");
-        REQUIRE(kv.get("key") == "value");
+        REQUIRE(kv.get("key").value == "value");
     }
     SECTION("SET bad args")
     {
-        REQUIRE(handleSET(kv, {"key2", "value2", "store"}) == argumentError("2", 3));
-        REQUIRE(kv.get("key2") == std::nullopt);
+        REQUIRE(handleSET(kv, {"key2", "value2", "store"}) == "-ERR syntax error\r\n");
+        REQUIRE(handleSET(kv, {"key2", "value2", "NX", "XX"}) == "-ERR syntax error\r\n");
+        REQUIRE(handleSET(kv, {"key2", "value2", "EX", "10", "KEEPTTL"}) == "-ERR syntax error\r\n");
+        REQUIRE(handleSET(kv, {"key2", "value2", "EX"}) == "-ERR syntax error\r\n");
+        REQUIRE(handleSET(kv, {"key2", "value2", "PX", "soon"}) == "-ERR value is not an integer or out of range\r\n");
+        REQUIRE(handleSET(kv, {"key2", "value2", "EX", "0"}) == "-ERR invalid expire time in 'set' command\r\n");
+        REQUIRE(kv.get("key2").value == std::nullopt);
         kv.rpush({"k", "v"});
         REQUIRE(handleSET(kv, {"k", "v"}) == "-ERR wrong type\r\n");
     }
+    SECTION("SET options")
+    {
+        REQUIRE(handleSET(kv, {"a", "1", "XX"}) == RESP_NIL);
+        REQUIRE(handleSET(kv, {"a", "1", "nx", "ex", "100"}) == "+OK\r\n");
+        REQUIRE(handleSET(kv, {"a", "2", "NX"}) == RESP_NIL);
+        REQUIRE(kv.get("a").value == "1");
+        REQUIRE(kv.ttl("a") == 100);
+
+        REQUIRE(handleSET(kv, {"a", "2", "XX", "KEEPTTL", "GET"}) == "$1\r\n1\r\n");
+        REQUIRE(kv.ttl("a") == 100);
+        REQUIRE(handleSET(kv, {"a", "3", "PX", "5000"}) == "+OK\r\n");
+        REQUIRE(kv.pttl("a") > 4000);
+        REQUIRE(kv.pttl("a") <= 5000);
+        REQUIRE(handleSET(kv, {"a", "4"}) == "+OK\r\n"); //Plain SET drops the ttl
+        REQUIRE(kv.ttl("a") == -1);
+
+        REQUIRE(handleSET(kv, {"b", "1", "GET"}) == RESP_NIL);
+        REQUIRE(kv.get("b").value == "1");
+        REQUIRE(handleSET(kv, {"b", "2", "NX", "GET"}) == "$1\r\n1\r\n"); //Old value even when not written
+        REQUIRE(kv.get("b").value == "1");
+    }
 }
 
 TEST_CASE("GET method", "[get][kvstore method][unit]")
@@ -61,13 +87,13 @@ TEST_CASE("GET method", "[get][kvstore method][unit]")
 
     SECTION("Get existing key")
     {
-        REQUIRE(kv.get("a") == "1");
-        REQUIRE(kv.get("b") == "2");
+        REQUIRE(kv.get("a").value == "1");
+        REQUIRE(kv.get("b").value == "2");
     }
 
     SECTION("Get a non-existing key")
     {
-        REQUIRE(kv.get("c") == std::nullopt);
+        REQUIRE(kv.get("c").value == std::nullopt);
     }
 }
 TEST_CASE("GET command", "[get][command handler][unit]")
@@ -93,6 +119,34 @@ TEST_CASE("GET command", "[get][command handler][unit]")
     }
 }
 
+TEST_CASE("GET pinned command", "[get][command handler][unit]")
+{
+    KVStore kv(false);
+    const std::string large(ZERO_COPY_MIN + 5, 'x');
+    SECTION("GET pinned matches GET")
+    {
+        kv.set("a", "value");
+        kv.set("large", large);
+        REQUIRE(handleGETPinned(kv, {"a"}).str() == handleGET(kv, {"a"}));
+        REQUIRE(handleGETPinned(kv, {"large"}).str() == handleGET(kv, {"large"}));
+        REQUIRE(handleGETPinned(kv, {"f"}).str() == "$-1\r\n");
+        REQUIRE(handleGETPinned(kv, {"b", "c"}).str() == argumentError("1", 2));
+        kv.set("n", "42");
+        REQUIRE(handleGETPinned(kv, {"n"}).str() == "$2\r\n42\r\n"); //INT written from the stack
+        kv.lpush({"list", "a"});
+        REQUIRE(handleGETPinned(kv, {"list"}).str() == "-ERR wrong type\r\n");
+    }
+
+    SECTION("GET pinned value survives overwrite")
+    {
+        kv.set("large", large);
+        const auto pinned = handleGETPinned(kv, {"large"});
+        kv.append("large", "y"); //Copy on write, the queued reply keeps the old bytes
+        REQUIRE(pinned.str() == std::format("${}\r\n{}\r\n", large.size(), large));
+        REQUIRE(kv.get("large").value == large + "y");
+    }
+}
+
 TEST_CASE("INCR method", "[incr][kvstore method][unit]")
 {
     KVStore kv(false);
@@ -101,18 +155,18 @@ TEST_CASE("INCR method", "[incr][kvstore method][unit]")
     kv.incr("a");
     SECTION("Make new key and incr")
     {
-        REQUIRE(kv.get({"a"}) == "1");
+        REQUIRE(kv.get({"a"}).value == "1");
     }
 
     kv.incr("a");
     SECTION("Incr existing key")
     {
-        REQUIRE(kv.get({"a"}) == "2");
+        REQUIRE(kv.get({"a"}).value == "2");
     }
 
     SECTION("Incr non-number")
     {
-        REQUIRE(kv.incr({"b"}) == std::nullopt);
+        REQUIRE(kv.incr({"b"}).value == std::nullopt);
     }
 }
 TEST_CASE("INCR command", "[incr][command handler][unit]")
@@ -144,18 +198,18 @@ TEST_CASE("DCR method", "[dcr][kvstore method][unit]")
     kv.dcr("a");
     SECTION("Make new key and dcr")
     {
-        REQUIRE(kv.get({"a"}) == "-1");
+        REQUIRE(kv.get({"a"}).value == "-1");
     }
 
     kv.dcr("a");
     SECTION("Dcr existing key")
     {
-        REQUIRE(kv.get({"a"}) == "-2");
+        REQUIRE(kv.get({"a"}).value == "-2");
     }
 
     SECTION("Dcr non-number")
     {
-        REQUIRE(kv.dcr({"b"}) == std::nullopt);
+        REQUIRE(kv.dcr({"b"}).value == std::nullopt);
     }
 }
 TEST_CASE("DCR command", "[dcr][command handler][unit]")
@@ -185,28 +239,28 @@ TEST_CASE("INCRBY method", "[incrby][kvstore method][unit]")
 
     SECTION("Incrby on new key")
     {
-        REQUIRE(kv.incrby("a", 5) == 5);
-        REQUIRE(kv.get("a") == "5");
+        REQUIRE(kv.incrby("a", 5).value == 5);
+        REQUIRE(kv.get("a").value == "5");
     }
 
     SECTION("Incrby on existing key")
     {
         kv.set("a", "2");
-        REQUIRE(kv.incrby("a", 3) == 5);
-        REQUIRE(kv.get("a") == "5");
+        REQUIRE(kv.incrby("a", 3).value == 5);
+        REQUIRE(kv.get("a").value == "5");
     }
 
     SECTION("Incrby on non-number")
     {
         kv.set("b", "string");
-        REQUIRE(kv.incrby("b", 2) == std::nullopt);
+        REQUIRE(kv.incrby("b", 2).value == std::nullopt);
     }
 
     SECTION("Incrby negative value")
     {
         kv.set("c", "10");
-        REQUIRE(kv.incrby("c", -4) == 6);
-        REQUIRE(kv.get("c") == "6");
+        REQUIRE(kv.incrby("c", -4).value == 6);
+        REQUIRE(kv.get("c").value == "6");
     }
 }
 TEST_CASE("INCRBY command", "[incrby][command handler][unit]")
@@ -237,6 +291,16 @@ TEST_CASE("INCRBY command", "[incrby][command handler][unit]")
     {
         REQUIRE(handleINCRBY(kv, {"a", "string"}) == "-ERR arg given not a number\r\n");
     }
+
+    SECTION("INCRBY 64-bit range")
+    {
+        REQUIRE(handleINCRBY(kv, {"a", "4294967296"}) == ":4294967296\r\n");
+        REQUIRE(kv.get("a").value == "4294967296");
+        kv.set("max", "9223372036854775807");
+        REQUIRE(handleINCRBY(kv, {"max", "1"}) == "-ERR value is not number or out of range\r\n");
+        REQUIRE(kv.get("max").value == "9223372036854775807"); //Untouched on overflow
+        REQUIRE(handleINCRBY(kv, {"a", "9223372036854775808"}) == "-ERR arg given not a number\r\n");
+    }
 }
 
 TEST_CASE("DCRBY method", "[dcrby][kvstore method][unit]")
@@ -245,28 +309,28 @@ TEST_CASE("DCRBY method", "[dcrby][kvstore method][unit]")
 
     SECTION("Dcrby on new key")
     {
-        REQUIRE(kv.dcrby("a", 4) == -4);
-        REQUIRE(kv.get("a") == "-4");
+        REQUIRE(kv.dcrby("a", 4).value == -4);
+        REQUIRE(kv.get("a").value == "-4");
     }
 
     SECTION("Dcrby on existing key")
     {
         kv.set("a", "10");
-        REQUIRE(kv.dcrby("a", 3) == 7);
-        REQUIRE(kv.get("a") == "7");
+        REQUIRE(kv.dcrby("a", 3).value == 7);
+        REQUIRE(kv.get("a").value == "7");
     }
 
     SECTION("Dcrby on non-number")
     {
         kv.set("b", "string");
-        REQUIRE(kv.dcrby("b", 2) == std::nullopt);
+        REQUIRE(kv.dcrby("b", 2).value == std::nullopt);
     }
 
     SECTION("Dcrby negative value")
     {
         kv.set("c", "5");
-        REQUIRE(kv.dcrby("c", -2) == 7);
-        REQUIRE(kv.get("c") == "7");
+        REQUIRE(kv.dcrby("c", -2).value == 7);
+        REQUIRE(kv.get("c").value == "7");
     }
 }
 TEST_CASE("DCRBY command", "[dcrby][command handler][unit]")
@@ -342,15 +406,15 @@ TEST_CASE("APPEND method", "[append][kvstore method][unit]")
 
     SECTION("Append to new key")
     {
-        REQUIRE(kv.append("a", "word") == 4);
-        REQUIRE(kv.get("a") == "word");
+        REQUIRE(kv.append("a", "word").value == 4);
+        REQUIRE(kv.get("a").value == "word");
     }
 
     SECTION("Append to existing key")
     {
         kv.set("a", "fizz");
-        REQUIRE(kv.append("a", "buzz") == 8);
-        REQUIRE(kv.get("a") == "fizzbuzz");
+        REQUIRE(kv.append("a", "buzz").value == 8);
+        REQUIRE(kv.get("a").value == "fizzbuzz");
     }
 }
 TEST_CASE("APPEND command", "[append][command handler][unit]")
@@ -361,7 +425,7 @@ TEST_CASE("APPEND command", "[append][command handler][unit]")
     {
         REQUIRE(handleAPPEND(kv, {"a", "foo"}) == ":3\r\n");
         REQUIRE(handleAPPEND(kv, {"a", "bar"}) == ":6\r\n");
-        REQUIRE(kv.get("a") == "foobar");
+        REQUIRE(kv.get("a").value == "foobar");
     }
 
     SECTION("APPEND bad args")